@@ -7,6 +7,12 @@
 #ifndef __CHEAP_MATRIX_H__
 #define __CHEAP_MATRIX_H__
 
+typedef struct __cmat_pool__ cmat_pool_t;
+typedef struct __cmat_ctx__ cmat_ctx_t;
+typedef struct __cmat_sched__ cmat_sched_t;
+typedef struct __cmat_future__ cmat_future_t;
+typedef struct __cmat_graph__ cmat_graph_t;
+
 typedef struct {
   float* tbl;
   float** row;
@@ -17,8 +23,24 @@ typedef struct {
 
   int capa;
   float coff;  // as cutoff
+
+  int flags;   // CMAT_FLAG_*
+  void* blk;   // memory block which holds row and tbl
+  int* ref;    // reference count of blk (NULL if not shared)
+  cmat_pool_t* pool;  // NULL if allocated by malloc()
 } cmat_t;
 
+typedef struct {
+  float* tbl;
+
+  int n;       // number of matrices
+  int rows;
+  int cols;
+  int stride;  // distance between element planes
+
+  float coff;  // as cutoff
+} cmat_batch_t;
+
 #define CMAT_ERR_NOMEM      -1    // NO MEMORY
 #define CMAT_ERR_BADDR      -2    // BAD ADDRESS
 #define CMAT_ERR_BSIZE      -3    // BAD SIZE
@@ -26,23 +48,61 @@ typedef struct {
 #define CMAT_ERR_SHAPE      -5    // MATRIX SHAPE ERROR
 #define CMAT_ERR_NREGL      -6    // NOT REGULAR MATRIX
 
+#define CMAT_SIMD_SCALAR    0     // PLAIN C
+#define CMAT_SIMD_SSE42     1     // x86 SSE4.2
+#define CMAT_SIMD_AVX2      2     // x86 AVX2 + FMA
+#define CMAT_SIMD_AVX512    3     // x86 AVX-512F
+#define CMAT_SIMD_NEON      4     // ARM NEON
+
+#define CMAT_BATCH_MAX_DIM  8     // MAX ROWS/COLS OF BATCHED MATRIX
+
+#define CMAT_NOTRANS        0     // USE OPERAND AS IS
+#define CMAT_TRANS          1     // USE TRANSPOSED OPERAND
+
+#define CMAT_FLAG_ALIGNED   0x0001  // ALL ROWS ARE SIMD WIDTH ALIGNED
+#define CMAT_FLAG_VIEW      0x0002  // ROWS REFER TO MEMORY NOT OWNED
+#define CMAT_FLAG_TRANS     0x0004  // ROWS HOLD COLUMNS (TRANSPOSED VIEW)
+#define CMAT_FLAG_SEGMENTED 0x0008  // ROWS ARE SPREAD OVER SEVERAL BLOCKS
+
+#define CMAT_NUMA_NONE        0   // NO PLACEMENT CONTROL (OS DEFAULT)
+#define CMAT_NUMA_FIRST_TOUCH 1   // PARALLEL FIRST-TOUCH INITIALIZATION
+#define CMAT_NUMA_INTERLEAVE  2   // PAGES INTERLEAVED OVER ALL NODES
+#define CMAT_NUMA_ROW_BLOCKS  3   // CONTIGUOUS ROW BLOCKS PER NODE
+
 #define CMAT_ROW(p,i)       ((p)->row[(i)])
 
 int cmat_new(float* src, int rows, int cols, cmat_t** dst);
 int cmat_clone(cmat_t* src, cmat_t** dst);
+int cmat_unshare(cmat_t* ptr);
+int cmat_view(cmat_t* ptr, int r0, int c0, int rows, int cols, cmat_t** dst);
+int cmat_wrap(float* data, int rows, int cols, int stride, cmat_t** dst);
+int cmat_transpose_view(cmat_t* ptr, cmat_t** dst);
 int cmat_destroy(cmat_t* ptr);
 int cmat_append(cmat_t* ptr, float* r);
+int cmat_append_rows(cmat_t* ptr, float* src, int n, int stride);
+int cmat_reserve(cmat_t* ptr, int rows);
+int cmat_shrink_to_fit(cmat_t* ptr);
+int cmat_compact(cmat_t* ptr);
 
 int cmat_add(cmat_t* ptr, cmat_t* op, cmat_t** dst);
 int cmat_sub(cmat_t* ptr, cmat_t* op, cmat_t** dst);
 int cmat_product(cmat_t* ptr, cmat_t* op, cmat_t** dst);
 int cmat_mul(cmat_t* ptr, float op, cmat_t** dst);
+int cmat_gemm(int ta, int tb, float alpha, cmat_t* a, cmat_t* b,
+              float beta, cmat_t* c);
 int cmat_transpose(cmat_t* ptr, cmat_t** dst);
 int cmat_det(cmat_t* ptr, float* dst);
 int cmat_dot(cmat_t* ptr, cmat_t* op, float* dst);
 int cmat_inverse(cmat_t* ptr, cmat_t** dst);
 int cmat_lu_decomp(cmat_t* ptr, cmat_t** dst, int* piv);
 
+int cmat_add_into(cmat_t* ptr, cmat_t* op, cmat_t* dst);
+int cmat_sub_into(cmat_t* ptr, cmat_t* op, cmat_t* dst);
+int cmat_product_into(cmat_t* ptr, cmat_t* op, cmat_t* dst);
+int cmat_mul_into(cmat_t* ptr, float op, cmat_t* dst);
+int cmat_transpose_into(cmat_t* ptr, cmat_t* dst);
+int cmat_inverse_into(cmat_t* ptr, cmat_t* dst);
+
 int cmat_abs_max(cmat_t*ptr, float* dst);
 int cmat_abs_min(cmat_t*ptr, float* dst);
 int cmat_permute_row(cmat_t* ptr, int* piv);
@@ -52,5 +112,83 @@ int cmat_print(cmat_t* ptr, char* label);
 int cmat_compare(cmat_t* ptr, cmat_t* op, int* dst);
 int cmat_check(cmat_t* ptr, float* val, int* dst);
 int cmat_set_cutoff_threshold(cmat_t* ptr, float val);
+int cmat_get_simd_level(int* dst);
+
+int cmat_pool_new(cmat_pool_t** dst);
+int cmat_pool_destroy(cmat_pool_t* ptr);
+int cmat_pool_reset(cmat_pool_t* ptr);
+int cmat_pool_alloc(cmat_pool_t* pool, float* src, int rows, int cols,
+                    cmat_t** dst);
+
+int cmat_batch_new(float* src, int n, int rows, int cols, cmat_batch_t** dst);
+int cmat_batch_destroy(cmat_batch_t* ptr);
+int cmat_batch_set(cmat_batch_t* ptr, int i, float* src);
+int cmat_batch_get(cmat_batch_t* ptr, int i, float* dst);
+int cmat_batch_product(cmat_batch_t* ptr, cmat_batch_t* op, cmat_batch_t** dst);
+int cmat_batch_transpose(cmat_batch_t* ptr, cmat_batch_t** dst);
+int cmat_batch_det(cmat_batch_t* ptr, float* dst);
+int cmat_batch_inverse(cmat_batch_t* ptr, cmat_batch_t** dst);
+
+int cmat_ctx_new(cmat_ctx_t** dst);
+int cmat_ctx_destroy(cmat_ctx_t* ptr);
+int cmat_ctx_set_threads(cmat_ctx_t* ptr, int n);
+int cmat_ctx_set_parallel_min(cmat_ctx_t* ptr, long n);
+int cmat_ctx_set_sched(cmat_ctx_t* ptr, cmat_sched_t* sched);
+int cmat_ctx_set_numa(cmat_ctx_t* ptr, int policy);
+
+int cmat_sched_new(int nthreads, cmat_sched_t** dst);
+int cmat_sched_new_external(int nworkers,
+                            void (*submit)(void (*job)(void*), void* arg,
+                                           void* user),
+                            void* user, cmat_sched_t** dst);
+int cmat_sched_destroy(cmat_sched_t* ptr);
+int cmat_sched_set_numa(cmat_sched_t* ptr, int policy);
+
+int cmat_product_async(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst,
+                       cmat_future_t** fut);
+int cmat_inverse_async(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst,
+                       cmat_future_t** fut);
+int cmat_lu_decomp_async(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst, int* piv,
+                         cmat_future_t** fut);
+int cmat_future_wait(cmat_future_t* ptr, int* res);
+int cmat_future_poll(cmat_future_t* ptr, int* done);
+int cmat_future_set_callback(cmat_future_t* ptr,
+                             void (*cb)(cmat_future_t* fut, int res,
+                                        void* user),
+                             void* user);
+int cmat_future_destroy(cmat_future_t* ptr);
+
+int cmat_graph_new(cmat_graph_t** dst);
+int cmat_graph_destroy(cmat_graph_t* ptr);
+int cmat_graph_input(cmat_graph_t* ptr, int rows, int cols, int* dst);
+int cmat_graph_add(cmat_graph_t* ptr, int a, int b, int* dst);
+int cmat_graph_sub(cmat_graph_t* ptr, int a, int b, int* dst);
+int cmat_graph_mul(cmat_graph_t* ptr, int a, float v, int* dst);
+int cmat_graph_product(cmat_graph_t* ptr, int a, int b, int* dst);
+int cmat_graph_transpose(cmat_graph_t* ptr, int a, int* dst);
+int cmat_graph_inverse(cmat_graph_t* ptr, int a, int* dst);
+int cmat_graph_bind(cmat_graph_t* ptr, int id, cmat_t* mat);
+int cmat_graph_execute(cmat_ctx_t* ctx, cmat_graph_t* ptr);
+
+int cmat_new_ctx(cmat_ctx_t* ctx, float* src, int rows, int cols,
+                 cmat_t** dst);
+int cmat_add_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst);
+int cmat_sub_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst);
+int cmat_product_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst);
+int cmat_mul_ctx(cmat_ctx_t* ctx, cmat_t* ptr, float op, cmat_t** dst);
+int cmat_gemm_ctx(cmat_ctx_t* ctx, int ta, int tb, float alpha,
+                  cmat_t* a, cmat_t* b, float beta, cmat_t* c);
+int cmat_transpose_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst);
+int cmat_det_ctx(cmat_ctx_t* ctx, cmat_t* ptr, float* dst);
+int cmat_dot_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, float* dst);
+int cmat_inverse_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst);
+int cmat_lu_decomp_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst, int* piv);
+int cmat_add_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t* dst);
+int cmat_sub_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t* dst);
+int cmat_product_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op,
+                          cmat_t* dst);
+int cmat_mul_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, float op, cmat_t* dst);
+int cmat_transpose_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* dst);
+int cmat_inverse_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* dst);
 
 #endif /* !defined(__CHEAP_MATRIX_H__) */
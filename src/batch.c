@@ -0,0 +1,739 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * 小行列のバッチ処理
+ *
+ *  同じ形状のn個の小行列を、要素ごとの平面に分けて格納する(SoA)。
+ *
+ *    tbl[((r * cols) + c) * stride + i] = i番目の行列の(r, c)要素
+ *
+ *  各演算はBATCH_BLOCK個の行列ごとに区切り、ブロック内の要素平面をカーネル
+ *  に渡して行列方向にベクトル化して処理する。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cmat.h"
+#include "kernel.h"
+#include "ctx.h"
+#include "parallel.h"
+
+#define DEFAULT_CUTOFF      1e-4
+
+#define ALIGN_BYTES         64
+#define ALIGN_LANES         (ALIGN_BYTES / sizeof(float))
+
+#define BATCH_BLOCK         256
+#define BATCH_PARALLEL_MIN  4096
+
+#define MIN(a,b)            (((a) < (b))? (a): (b))
+#define ROUND_UP(n,m)       ((((n) + (m) - 1) / (m)) * (m))
+
+static int
+alloc_batch(int n, int rows, int cols, cmat_batch_t* org, cmat_batch_t** dst)
+{
+  int ret;
+  cmat_batch_t* obj;
+  float* tbl;
+  int stride;
+
+  /*
+   * initialize
+   */
+  ret    = 0;
+  obj    = NULL;
+  tbl    = NULL;
+  stride = ROUND_UP(n, ALIGN_LANES);
+
+  do {
+    /*
+     * alloc memory
+     */
+    obj = (cmat_batch_t*)malloc(sizeof(cmat_batch_t));
+    if (obj == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+
+    if (stride > 0) {
+      if (posix_memalign((void**)&tbl, ALIGN_BYTES,
+                         sizeof(float) * rows * cols * stride)) {
+        tbl = NULL;
+        ret = CMAT_ERR_NOMEM;
+        break;
+      }
+    }
+
+    obj->tbl    = tbl;
+    obj->n      = n;
+    obj->rows   = rows;
+    obj->cols   = cols;
+    obj->stride = stride;
+    obj->coff   = (org)? org->coff: DEFAULT_CUTOFF;
+
+    *dst = obj;
+  } while (0);
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj) free(obj);
+  }
+
+  return ret;
+}
+
+static void
+free_batch(cmat_batch_t* ptr)
+{
+  if (ptr->tbl) free(ptr->tbl);
+  free(ptr);
+}
+
+static void
+replace_batch(cmat_batch_t* ptr, cmat_batch_t** src)
+{
+  if (ptr->tbl) free(ptr->tbl);
+  memcpy(ptr, *src, sizeof(cmat_batch_t));
+  free(*src);
+
+  *src = NULL;
+}
+
+/*
+ * ブロック先頭(i0番目の行列)からの各要素平面のアドレスを取得
+ */
+static void
+get_planes(cmat_batch_t* ptr, int i0, float** dst)
+{
+  int i;
+
+  for (i = 0; i < ptr->rows * ptr->cols; i++) {
+    dst[i] = ptr->tbl + ((long)i * ptr->stride) + i0;
+  }
+}
+
+/**
+ * バッチ行列オブジェクトの生成
+ *
+ * @param src   初期値(n個の行列を行優先で並べた配列, NULLの場合は0で初期化)
+ * @param n     行列の数
+ * @param rows  各行列の行数
+ * @param cols  各行列の列数
+ * @param dst   生成したオブジェクトの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 行数・列数はCMAT_BATCH_MAX_DIM以下である必要がある。
+ */
+int
+cmat_batch_new(float* src, int n, int rows, int cols, cmat_batch_t** dst)
+{
+  int ret;
+  cmat_batch_t* obj;
+  int sz;
+  int i;
+  int j;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (n < 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (rows <= 0 || rows > CMAT_BATCH_MAX_DIM) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (cols <= 0 || cols > CMAT_BATCH_MAX_DIM) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ret = alloc_batch(n, rows, cols, NULL, &obj);
+  }
+
+  /*
+   * set initial values
+   */
+  if (!ret && obj->tbl) {
+    sz = rows * cols;
+
+    if (src) {
+      for (i = 0; i < n; i++) {
+        for (j = 0; j < sz; j++) {
+          obj->tbl[((long)j * obj->stride) + i] = *src++;
+        }
+      }
+
+    } else {
+      memset(obj->tbl, 0, sizeof(float) * sz * obj->stride);
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * バッチ行列オブジェクトの削除
+ *
+ * @param ptr   削除するオブジェクトのポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_batch_destroy(cmat_batch_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    free_batch(ptr);
+  }
+
+  return ret;
+}
+
+/**
+ * バッチ内の行列の設定
+ *
+ * @param ptr   対象のバッチ行列オブジェクト
+ * @param i     設定する行列の番号
+ * @param src   設定する値(行優先で並べた配列)
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_batch_set(cmat_batch_t* ptr, int i, float* src)
+{
+  int ret;
+  int j;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (src == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (i < 0 || i >= ptr->n) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update values
+   */
+  if (!ret) {
+    for (j = 0; j < ptr->rows * ptr->cols; j++) {
+      ptr->tbl[((long)j * ptr->stride) + i] = src[j];
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * バッチ内の行列の取得
+ *
+ * @param ptr   対象のバッチ行列オブジェクト
+ * @param i     取得する行列の番号
+ * @param dst   取得した値の格納先(行優先で格納する)
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_batch_get(cmat_batch_t* ptr, int i, float* dst)
+{
+  int ret;
+  int j;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (i < 0 || i >= ptr->n) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put values
+   */
+  if (!ret) {
+    for (j = 0; j < ptr->rows * ptr->cols; j++) {
+      dst[j] = ptr->tbl[((long)j * ptr->stride) + i];
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * ブロック単位の演算の引数
+ *  i番目の範囲はBATCH_BLOCK * i番目の行列からの最大BATCH_BLOCK個の行列。
+ */
+typedef struct {
+  cmat_batch_t* ptr;
+  cmat_batch_t* op;
+  cmat_batch_t* obj;
+  float* det;
+} block_arg_t;
+
+static void
+product_range(void* arg, long i0, long i1)
+{
+  block_arg_t* a;
+  float* ap[CMAT_BATCH_MAX_DIM * CMAT_BATCH_MAX_DIM];
+  float* bp[CMAT_BATCH_MAX_DIM * CMAT_BATCH_MAX_DIM];
+  float* dp[CMAT_BATCH_MAX_DIM * CMAT_BATCH_MAX_DIM];
+  long b;
+  int i;
+
+  a = (block_arg_t*)arg;
+
+  for (b = i0; b < i1; b++) {
+    i = (int)b * BATCH_BLOCK;
+
+    get_planes(a->ptr, i, ap);
+    get_planes(a->op, i, bp);
+    get_planes(a->obj, i, dp);
+
+    cmat_kernel->batch_product(dp, ap, bp,
+                               a->ptr->rows, a->ptr->cols, a->op->cols,
+                               MIN(BATCH_BLOCK, a->ptr->n - i));
+  }
+}
+
+static void
+det_range(void* arg, long i0, long i1)
+{
+  block_arg_t* a;
+  float* sp[16];
+  long b;
+  int i;
+
+  a = (block_arg_t*)arg;
+
+  for (b = i0; b < i1; b++) {
+    i = (int)b * BATCH_BLOCK;
+
+    get_planes(a->ptr, i, sp);
+
+    cmat_kernel->batch_det(sp, a->det + i, a->ptr->rows,
+                           MIN(BATCH_BLOCK, a->ptr->n - i));
+  }
+}
+
+static void
+inverse_range(void* arg, long i0, long i1)
+{
+  block_arg_t* a;
+  float* sp[16];
+  float* dp[16];
+  long b;
+  int i;
+
+  a = (block_arg_t*)arg;
+
+  for (b = i0; b < i1; b++) {
+    i = (int)b * BATCH_BLOCK;
+
+    get_planes(a->ptr, i, sp);
+    get_planes(a->obj, i, dp);
+
+    cmat_kernel->batch_inverse(sp, dp, a->det + i, a->ptr->rows,
+                               MIN(BATCH_BLOCK, a->ptr->n - i));
+  }
+}
+
+/**
+ * バッチ行列の積
+ *  ptr[i] * op[i] → dst[i]       (dst != NULL)
+ *  ptr[i] * op[i] → ptr[i]       (dst == NULL)
+ *
+ * @param ptr   対象のバッチ行列オブジェクト
+ * @param op    積行列のバッチ
+ * @param dst   演算結果の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_batch_product(cmat_batch_t* ptr, cmat_batch_t* op, cmat_batch_t** dst)
+{
+  int ret;
+  cmat_batch_t* obj;
+  block_arg_t arg;
+  int nt;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (ptr->n != op->n || ptr->cols != op->rows) ret = CMAT_ERR_SHAPE;
+  }
+
+  /*
+   * alloc result object
+   */
+  if (!ret) {
+    ret = alloc_batch(ptr->n, ptr->rows, op->cols, ptr, &obj);
+  }
+
+  /*
+   * do multiple operation
+   */
+  if (!ret) {
+    arg.ptr = ptr;
+    arg.op  = op;
+    arg.obj = obj;
+
+    nt = cmat_ctx_threads(ptr->n, BATCH_PARALLEL_MIN);
+    cmat_parallel_for((ptr->n + BATCH_BLOCK - 1) / BATCH_BLOCK, nt,
+                      product_range, &arg);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dst) {
+      *dst = obj;
+    } else {
+      replace_batch(ptr, &obj);
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * バッチ行列の転置
+ *  transpose(ptr[i]) → dst[i]       (dst != NULL)
+ *  transpose(ptr[i]) → ptr[i]       (dst == NULL)
+ *
+ * @param ptr   対象のバッチ行列オブジェクト
+ * @param dst   転置結果の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note SoA形式では転置は要素平面の並べ替えのみとなる。
+ */
+int
+cmat_batch_transpose(cmat_batch_t* ptr, cmat_batch_t** dst)
+{
+  int ret;
+  cmat_batch_t* obj;
+  int r;
+  int c;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * alloc result object
+   */
+  if (!ret) {
+    ret = alloc_batch(ptr->n, ptr->cols, ptr->rows, ptr, &obj);
+  }
+
+  /*
+   * do transpose operation
+   */
+  if (!ret && obj->tbl) {
+    for (r = 0; r < ptr->rows; r++) {
+      for (c = 0; c < ptr->cols; c++) {
+        memcpy(obj->tbl + ((long)((c * ptr->rows) + r) * obj->stride),
+               ptr->tbl + ((long)((r * ptr->cols) + c) * ptr->stride),
+               sizeof(float) * ptr->n);
+      }
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dst) {
+      *dst = obj;
+    } else {
+      replace_batch(ptr, &obj);
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * バッチ行列の行列式の計算
+ *  det(ptr[i]) → dst[i]
+ *
+ * @param ptr   対象のバッチ行列オブジェクト
+ * @param dst   算出結果の格納先(ptr->n個分の領域が必要)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 1x1から4x4の正方行列のみ対応する。
+ */
+int
+cmat_batch_det(cmat_batch_t* ptr, float* dst)
+{
+  int ret;
+  block_arg_t arg;
+  int nt;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (ptr->rows != ptr->cols) {
+      ret = CMAT_ERR_SHAPE;
+    } else if (ptr->rows > 4) {
+      ret = CMAT_ERR_BSIZE;
+    }
+  }
+
+  /*
+   * calc determinant
+   */
+  if (!ret) {
+    arg.ptr = ptr;
+    arg.det = dst;
+
+    nt = cmat_ctx_threads(ptr->n, BATCH_PARALLEL_MIN);
+    cmat_parallel_for((ptr->n + BATCH_BLOCK - 1) / BATCH_BLOCK, nt,
+                      det_range, &arg);
+  }
+
+  return ret;
+}
+
+/**
+ * バッチ行列の逆行列の算出
+ *  inverse(ptr[i]) → dst[i]       (dst != NULL)
+ *  inverse(ptr[i]) → ptr[i]       (dst == NULL)
+ *
+ * @param ptr   対象のバッチ行列オブジェクト
+ * @param dst   逆行列の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 1x1から4x4の正方行列のみ対応する。いずれかの行列が正則でない場合
+ *       はCMAT_ERR_NREGLを返し、ptrは変更しない。
+ */
+int
+cmat_batch_inverse(cmat_batch_t* ptr, cmat_batch_t** dst)
+{
+  int ret;
+  cmat_batch_t* obj;
+  float* det;
+  block_arg_t arg;
+  int nt;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+  det = NULL;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (ptr->rows != ptr->cols) {
+      ret = CMAT_ERR_SHAPE;
+    } else if (ptr->rows > 4) {
+      ret = CMAT_ERR_BSIZE;
+    }
+  }
+
+  /*
+   * alloc result object and work memory
+   */
+  if (!ret) {
+    ret = alloc_batch(ptr->n, ptr->rows, ptr->cols, ptr, &obj);
+  }
+
+  if (!ret) {
+    det = (float*)malloc(sizeof(float) * (ptr->n + 1));
+    if (det == NULL) ret = CMAT_ERR_NOMEM;
+  }
+
+  /*
+   * calculate inverse matrix
+   */
+  if (!ret) {
+    arg.ptr = ptr;
+    arg.obj = obj;
+    arg.det = det;
+
+    nt = cmat_ctx_threads(ptr->n, BATCH_PARALLEL_MIN);
+    cmat_parallel_for((ptr->n + BATCH_BLOCK - 1) / BATCH_BLOCK, nt,
+                      inverse_range, &arg);
+  }
+
+  /*
+   * check if these are regular matrices
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->n; i++) {
+      if (fabsf(det[i]) < ptr->coff) {
+        ret = CMAT_ERR_NREGL;
+        break;
+      }
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dst) {
+      *dst = obj;
+    } else {
+      replace_batch(ptr, &obj);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj) free_batch(obj);
+  }
+
+  if (det) free(det);
+
+  return ret;
+}
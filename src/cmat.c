@@ -6,19 +6,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <math.h>
 #include <float.h>
 
 #include "cmat.h"
-
-#if defined(ENABLE_NEON) && (!defined(__ARM_NEON) && !defined(__ARM_NEON__))
-#error "ARM NEON instruction set is not available."
-#endif
-
-#ifdef ENABLE_NEON
-#include <arm_neon.h>
-#endif /* defined(ENABLE_NEON) */
+#include "kernel.h"
+#include "gemm.h"
+#include "pool.h"
+#include "ctx.h"
+#include "parallel.h"
+#include "numa.h"
 
 #define DEFAULT_ERROR       __LINE__
 #define DEFAULT_CUTOFF      1e-4
@@ -27,525 +26,3244 @@
 #define SHRINK(n)           ((n * 10) / 13)
 #define SWAP(a,b,t)         do {t c; c = (a); (a) = (b); (b) = c;} while(0)
 
-#ifdef ENABLE_NEON
-#define ALIGN_ROWS(n)       ((n) + (4 - ((n) % 4)))
-#define ALIGN_COLS(n)       ((n) + (4 - ((n) % 4)))
-#else /* defined(ENABLE_NEON) */
+/*
+ * パッキングのコストに見合う大きさの行列積はGEMMエンジンで処理する
+ */
+#define IS_LARGE_PRODUCT(m,n,k) \
+                            (((long)(m) * (n) * (k)) >= (32L * 32 * 32))
+
+/*
+ * GEMMエンジンを通らない行列積を並列化する最小の積和の回数
+ */
+#define PRODUCT_PARALLEL_MIN (64L * 64 * 64)
+
+/*
+ * 2x2, 3x3, 4x4の正方行列同士の積は展開済みの専用関数で処理する
+ */
+#define IS_FIXED_PRODUCT(a,b) \
+                            ((a)->rows == (a)->cols && \
+                             (b)->rows == (b)->cols && \
+                             (a)->rows >= 2 && (a)->rows <= 4)
+
+/*
+ * LU分解のブロッキングパラメータ
+ */
+#define LU_BLOCKED_MIN      256
+#define LU_BLOCK            128
+#define LU_LEAF_COLS        32
+#define LU_TRSM_COLS        256
+#define LU_GEMM_MIN         (64L * 64 * 64)
+#define LU_PARALLEL_MIN     (64L * 64 * 64)
+
+/*
+ * 逆行列算出時にU^-1を並列に求める列ブロックの幅
+ */
+#define INV_COLS            64
+
+/*
+ * ドット積の並列化の単位(要素数)と並列化を行う最小の要素数
+ */
+#define DOT_BLOCK           (64L * 1024)
+#define DOT_PARALLEL_MIN    (256L * 1024)
+
+/*
+ * 転置のタイルの一辺(L1に収まる大きさ)と並列化を行う最小の要素数
+ */
+#define TRANSPOSE_TILE      64
+#define TRANSPOSE_PAR_MIN   (256L * 1024)
+
+/*
+ * 要素ごとの演算(和・差・スカラー積)を並列化する最小の要素数
+ *  スレッドチームの起動はμ秒単位のコストがかかるので、L2に収まる大きさ
+ *  までは逐次に処理する。
+ */
+#define ELEM_PARALLEL_MIN   (64L * 1024)
+
+/*
+ * 複数行の追加(cmat_append_rows())で並列化を行う最小の要素数
+ */
+#define APPEND_PARALLEL_MIN (256L * 1024)
+
+/*
+ * NUMAの配置方針(cmat_ctx_set_numa())を適用する最小の要素数
+ *  これより小さな行列は数ページにしかならないので配置を行わず、初期化も
+ *  逐次に行う。
+ */
+#define NUMA_MIN            (256L * 1024)
+
+/*
+ * 行列の格納領域のレイアウト
+ *
+ *  ヘッダ(cmat_t)、行テーブル、値テーブルを一つのキャッシュライン境界に揃
+ *  った領域に続けて配置する。ストライドは列数をカーネルごとのパディング単
+ *  位(cmat_pad_width)の倍数に切り上げたもので、列数が既に倍数であれば余分
+ *  なパディングは付かない。ストライドがベクトル幅の倍数であれば全ての行が
+ *  ベクトル幅の境界から始まる(CMAT_FLAG_ALIGNED)。
+ */
+#define LINE_BYTES          64
+#define ROUND_UP(n,m)       ((((n) + (m) - 1) / (m)) * (m))
+
+#define HEAD_SIZE           ROUND_UP(sizeof(cmat_t), LINE_BYTES)
+#define ROWS_SIZE(n)        ROUND_UP(sizeof(float*) * (n), LINE_BYTES)
+
 #define ALIGN_ROWS(n)       (n)
-#define ALIGN_COLS(n)       (n)
-#endif /* defined(ENABLE_NEON) */
+#define ALIGN_COLS(n)       ROUND_UP((n), cmat_pad_width)
 
-#ifdef ENABLE_NEON
-static void
-memcpy128(void* dst, void* src, size_t size)
-{
-  int i;
+/*
+ * 非テンポラルストアを使用する最小の要素数
+ *  結果が最終レベルキャッシュに収まる大きさの場合は、直後の演算で再利用さ
+ *  れる可能性が高いので通常のストアを使う。
+ */
+#define STREAM_MIN          (8L * 1024 * 1024)
 
-  for (i = 0; i < size; i += 16) {
-    vst1q_u8(dst + i, vld1q_u8(src + i));
-  }
-}
+/*
+ * 転置ビュー(CMAT_FLAG_TRANS)の扱い
+ *  rows, colsは転置後の形状を表し、行テーブルは元の行列の行(転置後の列)
+ *  を指す。STORE_ROWS, STORE_COLSは行テーブルの形状、ELEMは転置後の形状
+ *  での(i, j)要素を表す。
+ */
+#define IS_TRANS(p)         ((p)->flags & CMAT_FLAG_TRANS)
+#define STORE_ROWS(p)       (IS_TRANS(p)? (p)->cols: (p)->rows)
+#define STORE_COLS(p)       (IS_TRANS(p)? (p)->rows: (p)->cols)
+#define ELEM(p,i,j)         (*(IS_TRANS(p)? &(p)->row[(j)][(i)]: \
+                                            &(p)->row[(i)][(j)]))
+
+/*
+ * 転置の有無が混在する要素ごとの演算(calc_elem())のタイルの大きさと種別
+ */
+#define TRANS_TILE          32
+
+#define ELEM_COPY           0
+#define ELEM_ADD            1
+#define ELEM_SUB            2
+#define ELEM_MUL            3
+
+/*
+ * 格納領域の共有(cmat_clone()によるコピーオンライト)
+ *
+ *  複製したオブジェクトは元のオブジェクトと行テーブル・値テーブルを含む
+ *  領域(blk)を共有し、refで参照数を数える。書き込みを行う演算は事前に
+ *  unshare_object()で領域を複製する。
+ *
+ *  FLAG_VIEWED : ビューが作られた(ビュー経由の書き込みを検出できないので
+ *                以降の複製は値をコピーする)
+ *  FLAG_PINNED : ヘッダが共有中の領域に埋め込まれている(自身は別の領域に
+ *                移ったが、refは埋め込まれている領域の参照数を指す)
+ */
+#define FLAG_VIEWED         0x0100
+#define FLAG_PINNED         0x0200
 
+#define IS_SHARED(p)        ((p)->ref && !((p)->flags & FLAG_PINNED))
+
+/*
+ * 行の追加による拡張(CMAT_FLAG_SEGMENTED)
+ *
+ *  値テーブルがSEG_BYTES以上の行列をcmat_append()で拡張する場合は、既存の
+ *  値テーブルをそのまま残して固定サイズのセグメントを継ぎ足す。行テーブル
+ *  はセグメントとは別の領域に確保して伸ばす(コピーするのはポインタのみ)。
+ *  blkは最新のセグメントを指し、各セグメントの先頭(seg_t)から一つ前のセ
+ *  グメントとセグメント化する前の領域を辿る。cmat_compact()で一つの領域に
+ *  まとめ直す。
+ */
+#define SEG_BYTES           (256L * 1024)
+#define SEG_HEAD            ROUND_UP(sizeof(seg_t), LINE_BYTES)
+#define SEG_ROWS(stride)    ((SEG_BYTES - SEG_HEAD) / \
+                             (sizeof(float) * (stride)))
+
+#define IS_SEGMENTED(p)     ((p)->flags & CMAT_FLAG_SEGMENTED)
+#define USE_SEGMENT(p)      (!((p)->flags & CMAT_FLAG_VIEW) && \
+                             (IS_SEGMENTED(p) || \
+                              (sizeof(float) * (p)->capa * (p)->stride) >= \
+                              SEG_BYTES))
+
+typedef struct {
+  void* prev;     // 一つ前のセグメント(NULLで終端)
+  void* base;     // セグメント化する前の領域(ヘッダと同じ場合はNULL)
+  int rcapa;      // 行テーブルの容量
+} seg_t;
+
+#define IS_STREAMABLE(d,s,o) \
+                            (((d)->flags & (s)->flags & (o)->flags & \
+                              CMAT_FLAG_ALIGNED) && \
+                             ((long)(d)->rows * (d)->cols) >= STREAM_MIN)
+
+/*
+ * 行テーブルと値テーブルの配置
+ */
 static void
-bzero128(void* dst, size_t size)
+layout_storage(void* blk, int capa, int stride, float*** row, float** tbl)
 {
+  float** r;
+  float* t;
   int i;
-  uint8x16_t zero;
 
-  zero = vmovq_n_u8(0);
+  if (capa > 0) {
+    r = (float**)blk;
+    t = (float*)((char*)blk + ROWS_SIZE(capa));
+
+    for (i = 0; i < capa; i++) {
+      r[i] = t + (i * stride);
+    }
 
-  for (i = 0; i < size; i += 16) {
-    vst1q_u8(dst + i, zero);
+  } else {
+    r = NULL;
+    t = NULL;
   }
+
+  *row = r;
+  *tbl = t;
 }
-#endif /* defined(ENABLE_NEON) */
 
 static int
-alloc_object(int rows, int cols, cmat_t* org, cmat_t** dst)
+create_object(cmat_pool_t* pool, int rows, int cols, float coff,
+              cmat_t** dst)
 {
   int ret;
-  float* tbl;
-  float** row;
   cmat_t* obj;
   int stride;
   int capa;
-  int i;
-#ifdef ENABLE_NEON
-  int j;
-#endif /* defined(ENABLE_NEON) */
+  size_t size;
 
   /*
    * initialize
    */
   ret    = 0;
-  tbl    = NULL;
-  row    = NULL;
   obj    = NULL;
 
   stride = ALIGN_COLS(cols);
   capa   = ALIGN_ROWS(rows);
+  size   = HEAD_SIZE + ROWS_SIZE(capa) + (sizeof(float) * capa * stride);
 
-  do {
-    /*
-     * alloc memory
-     */
-    obj = (cmat_t*)malloc(sizeof(cmat_t));
-    if (obj == NULL) {
-      ret = CMAT_ERR_NOMEM;
-      break;
-    }
-
-    if (capa > 0) {
-      tbl = (float*)malloc(sizeof(float) * capa * stride);
-      if (tbl == NULL) {
-        ret = CMAT_ERR_NOMEM;
-        break;
-      }
+  /*
+   * alloc memory
+   */
+  obj = (cmat_t*)cmat_mem_alloc(pool, size);
+  if (obj == NULL) ret = CMAT_ERR_NOMEM;
 
-      row = (float**)malloc(sizeof(float*) * capa);
-      if (row == NULL) {
-        ret = CMAT_ERR_NOMEM;
-        break;
-      }
+  /*
+   * setup object
+   */
+  if (!ret) {
+    layout_storage((char*)obj + HEAD_SIZE, capa, stride, &obj->row, &obj->tbl);
 
-      for (i = 0; i < capa; i++) {
-        row[i] = tbl + (i * stride);
-      }
+    if (pool == NULL && ((long)capa * stride) >= NUMA_MIN) {
+      cmat_numa_place(obj->tbl, sizeof(float) * capa * stride,
+                      cmat_ctx_numa());
     }
 
-    obj->tbl    = tbl;
-    obj->row    = row;
     obj->rows   = rows;
     obj->cols   = cols;
     obj->stride = stride;
     obj->capa   = capa;
-
-    if (org) {
-      obj->coff = org->coff;
-    } else {
-      obj->coff = DEFAULT_CUTOFF;
-    }
+    obj->coff   = coff;
+    obj->flags  = (stride % cmat_kernel->width == 0)? CMAT_FLAG_ALIGNED: 0;
+    obj->blk    = obj;
+    obj->ref    = NULL;
+    obj->pool   = pool;
 
     *dst = obj;
-  } while (0);
-
-  /*
-   * post process
-   */
-  if (ret) {
-    if (obj) free(obj);
-    if (tbl) free(tbl);
-    if (row) free(row);
   }
 
   return ret;
 }
 
-static void
-free_object(cmat_t* ptr)
+/*
+ * 演算結果用のオブジェクトの確保
+ *  orgを指定した場合はorgと同じプールから確保し、カットオフ値を引き継ぐ。
+ */
+static int
+alloc_object(int rows, int cols, cmat_t* org, cmat_t** dst)
 {
-  if (ptr->tbl) free(ptr->tbl);
-  if (ptr->row) free(ptr->row);
-  free(ptr);
-}
+  int ret;
 
-static void
-replace_object(cmat_t* ptr, cmat_t** src)
-{
-  free(ptr->tbl);
-  free(ptr->row);
-  memcpy(ptr, *src, sizeof(cmat_t));
-  free(*src);
+  if (org) {
+    ret = create_object(org->pool, rows, cols, org->coff, dst);
+  } else {
+    ret = create_object(NULL, rows, cols, DEFAULT_CUTOFF, dst);
+  }
 
-  *src = NULL;
+  return ret;
 }
 
+/*
+ * ビュー用のオブジェクトの確保
+ *  ヘッダと行テーブルのみを確保する(行テーブルの内容は呼び出し側で設定
+ *  すること)。
+ */
 static int
-alloc_table(float** src, int rows, int cols, float** dt, float*** dr)
+alloc_view(cmat_pool_t* pool, int rows, int cols, int stride, float coff,
+           cmat_t** dst)
 {
   int ret;
-  float* tbl;
-  float** row;
-  int stride;
-  int i;
-#ifdef ENABLE_NEON
-  int j;
-#endif /* defined(ENABLE_NEON) */
-
-
-  ret    = 0;
-  tbl    = NULL;
-  row    = NULL;
-  stride = ALIGN_COLS(cols);
-
-  do {
-    tbl = (float*)malloc(sizeof(float) * rows * stride);
-    if (tbl == NULL) {
-      ret = CMAT_ERR_NOMEM;
-      break;
-    }
-
-    row = (float**)malloc(sizeof(float*) * rows);
-    if (row == NULL) {
-      ret = CMAT_ERR_NOMEM;
-      break;
-    }
-  } while (0);
+  cmat_t* obj;
 
-  if (!ret) {
-    for (i = 0; i < rows; i++) {
-      row[i] = tbl + (i * cols);
+  ret = 0;
+  obj = (cmat_t*)cmat_mem_alloc(pool, HEAD_SIZE + ROWS_SIZE(rows));
 
-      if (src) memcpy(row[i], src[i], sizeof(float) * cols);
-#ifdef ENABLE_NEON
-      for (j = cols; j < stride; j++) row[i][j] = 0.0f;
-#endif /* defined(ENABLE_NEON) */
-    }
+  if (obj == NULL) {
+    ret = CMAT_ERR_NOMEM;
 
-    *dt = tbl;
-    *dr = row;
-  }
+  } else {
+    obj->row    = (float**)((char*)obj + HEAD_SIZE);
+    obj->tbl    = NULL;
+    obj->rows   = rows;
+    obj->cols   = cols;
+    obj->stride = stride;
+    obj->capa   = rows;
+    obj->coff   = coff;
+    obj->flags  = CMAT_FLAG_VIEW;
+    obj->blk    = obj;
+    obj->ref    = NULL;
+    obj->pool   = pool;
 
-  if(ret) {
-    if (tbl) free(tbl);
-    if (row) free(row);
+    *dst = obj;
   }
 
   return ret;
 }
 
+/*
+ * 参照数の減算 (0になった場合は!0を返す)
+ */
 static int
-format(float val, char* dst, float thr)
+unref(int* ref)
 {
-  int ret;
-  int i;
-
-  if (fabsf(val) > thr) {
-    sprintf(dst, "% f", val);
+  return (__atomic_sub_fetch(ref, 1, __ATOMIC_ACQ_REL) == 0);
+}
 
-    for (i = strlen(dst) - 1; i > 0; i--) {
-      switch (dst[i]) {
-      case '0':
-        break;
+/*
+ * 値テーブルの領域の解放
+ *  セグメント化されている場合は全てのセグメントと行テーブルを解放する。
+ */
+static void
+free_blocks(cmat_t* ptr)
+{
+  seg_t* seg;
+  void* prev;
+  void* base;
 
-      case '.':
-        dst[i + 0] = '\0';
-        ret = i;
-        goto loop_out;
+  if (IS_SEGMENTED(ptr)) {
+    base = ((seg_t*)ptr->blk)->base;
 
-      default:
-        dst[i + 1] = '\0';
-        ret = i + 1;
-        goto loop_out;
-      }
+    for (seg = (seg_t*)ptr->blk; seg != NULL; seg = (seg_t*)prev) {
+      prev = seg->prev;
+      cmat_mem_free(ptr->pool, seg);
     }
 
-  } else {
-    strcpy(dst, " 0");
-    ret = 1;
-  }
-  loop_out:
+    if (base) cmat_mem_free(ptr->pool, base);
+    cmat_mem_free(ptr->pool, ptr->row);
 
-  return ret;
+  } else if (ptr->blk != ptr) {
+    cmat_mem_free(ptr->pool, ptr->blk);
+  }
 }
 
-static inline int
-fcmp(float f1, float f2, float coff)
+/*
+ * 格納領域の解放
+ *  ヘッダは残す。値テーブルがヘッダとは別の領域にある場合(replace_object()
+ *  で他のオブジェクトの領域を引き継いだ場合や、cmat_append()で拡張した場合)
+ *  はそれを解放する。共有中の領域は参照数を減らし、最後の参照であれば解放
+ *  する。ヘッダが埋め込まれた領域が共有中の場合はFLAG_PINNEDを立てて参照
+ *  を残す(free_object()で解放する)。
+ */
+static void
+release_storage(cmat_t* ptr)
 {
-  /*
-   * 絶対的な誤差ではなく、有効桁を意識した比較を行うために
-   * 若干複雑な比較を行っているので注意。
-   *
-   * 例えば、非常に大きな値同士の比較などの場合
-   * この場合差が大きくとも誤差が有効桁に収まっている場合は、
-   * 同値として扱うことが妥当となる。単純に差分を基準値と比
-   * 較するだけでは対応できない。
-   *
-   * なお、現在の実装でも完全ではないのでいずれ修正すること。
-   */
+  if (ptr->flags & FLAG_PINNED) {
+    free_blocks(ptr);
 
-  float v1;
-  int e1;
+  } else if (ptr->ref && ptr->blk == ptr) {
+    ptr->flags |= FLAG_PINNED;
 
-  float v2;
-  int e2;
+  } else if (ptr->ref) {
+    if (unref(ptr->ref)) {
+      cmat_mem_free(ptr->pool, ptr->ref);
+      free_blocks(ptr);
+    }
 
-  v1 = frexpf(f1, &e1);
-  v2 = frexpf(f2, &e2);
+    ptr->ref = NULL;
 
-  if (e1 == e2) {
-    f1 = v1;
-    f2 = v2;
+  } else {
+    free_blocks(ptr);
   }
+}
 
-#if 0
-  if (fabsf(f1 - f2) > coff) {
-    printf("%.20f %.20f %.20g\n", f1, f2, fabsf(f1 - f2));
-  }
-#endif
+/*
+ * オブジェクトの解放
+ */
+static void
+free_object(cmat_t* ptr)
+{
+  release_storage(ptr);
 
-  return fabsf(f1 - f2) > coff;
+  if (!(ptr->flags & FLAG_PINNED)) {
+    cmat_mem_free(ptr->pool, ptr);
+
+  } else if (unref(ptr->ref)) {
+    cmat_mem_free(ptr->pool, ptr->ref);
+    cmat_mem_free(ptr->pool, ptr);
+  }
 }
 
 /*
- * http://hooktail.org/computer/index.php?LU%CA%AC%B2%F2
+ * 格納領域の移し替え
+ *  capa行分の行テーブル・値テーブルを一つの領域に確保し直し、既存の領域を
+ *  解放する。copyが0の場合は値をコピーしない。行の並びは論理的な順序に並
+ *  べ直す。
  */
 static int
-lu_decomp(float** row, int sz, float thr, int* piv)
+relocate_object(cmat_t* ptr, int capa, int copy)
 {
   int ret;
+  void* blk;
+  float* tbl;
+  float** row;
   int i;
-  int j;
-  int k;
-  float max;
-  float tmp;
-
-  float* pi;
-  float* pj;
 
   ret = 0;
+  blk = cmat_mem_alloc(ptr->pool, ROWS_SIZE(capa) +
+                                  (sizeof(float) * capa * ptr->stride));
 
-  if (piv) {
-    for (i = 0; i < sz; i++) piv[i] = i;
-  }
+  if (blk == NULL) {
+    ret = CMAT_ERR_NOMEM;
 
-  for (i = 0; i < sz; i++) {
-    pi  = row[i];
-    max = fabsf(pi[i]);
-    k   = i;
+  } else {
+    layout_storage(blk, capa, ptr->stride, &row, &tbl);
 
-    /* 注目行以降で最大の値（絶対値）の存在する行を探す */
-    for (j = i + 1; j < sz; j++) {
-      tmp = fabsf(row[j][i]);
+    for (i = 0; copy && i < ptr->rows; i++) {
+      memcpy(row[i], ptr->row[i], sizeof(float) * ptr->stride);
+    }
 
-      /*
-       * 浮動小数点数の丸め誤差の蓄積のため、極小差の場合に大小比較がうまくい
-       * かないことがある。これを避けるために差の閾値比較で大小比較を行ってい
-       * る。以下のif文は tmp > max を評価している。
-       */
-      if (tmp - max > thr) {
-        max = tmp;
-        k   = j;
-      }
-    }
+    release_storage(ptr);
 
-    /* 注目行と最大値のあった行を入れ替える */
-    if (k != i) {
-      SWAP(row[i], row[k], float*);
-      if (piv) SWAP(piv[i], piv[k], int);
+    ptr->tbl    = tbl;
+    ptr->row    = row;
+    ptr->capa   = capa;
+    ptr->blk    = blk;
+    ptr->flags &= ~CMAT_FLAG_SEGMENTED;
+  }
 
-      pi = row[i];
-      ret++;
-    }
+  return ret;
+}
 
-    /* この時点で対角成分が0の場合は注目行に対する分解は終わってると
-       考えてよいので次の行に移動する */
-    if (pi[i] == 0.0) continue;
+/*
+ * 共有中の格納領域の複製(コピーオンライト)
+ *  ptrが他のオブジェクトと領域を共有している場合、新たに確保した領域に移
+ *  して共有を解く。copyが0の場合(全体を上書きする演算の出力先)は値をコピー
+ *  しない。
+ */
+static int
+unshare_object(cmat_t* ptr, int copy)
+{
+  int ret;
 
-    /* forwarding erase */
-#pragma omp parallel for private(k,pj,tmp)
-    for (j = i + 1; j < sz; j++) {
-      pj  = row[j];
-      tmp = (pj[i] /= pi[i]);
+  ret = 0;
 
-      for (k = i + 1; k < sz; k++) {
-        pj[k] -= tmp * pi[k];
-      }
-    }
+  if (!IS_SHARED(ptr)) {
+    /* nothing */
+
+  } else if (__atomic_load_n(ptr->ref, __ATOMIC_ACQUIRE) == 1) {
+    /* 他の参照は全て解放済み */
+    cmat_mem_free(ptr->pool, ptr->ref);
+    ptr->ref = NULL;
+
+  } else {
+    ret = relocate_object(ptr, ptr->capa, copy);
   }
 
   return ret;
 }
 
-static float
-det(float a, float b, float c, float d)
+/*
+ * 転置ビューを含む要素ごとの演算 (obj = ptr (+|-) op, obj = ptr * v)
+ *  行テーブルの向きが揃わないので、転置側のアクセスがキャッシュライン内に
+ *  収まるようにTRANS_TILE四方のタイル単位で処理する。ELEM_COPYとELEM_MUL
+ *  ではopは参照しない。
+ */
+typedef struct {
+  cmat_t* ptr;
+  cmat_t* op;
+  float v;
+  cmat_t* obj;
+  int type;
+} elem_arg_t;
+
+static void
+elem_range(void* arg, long i0, long i1)
 {
-  return (a * d) - (b * c);
+  elem_arg_t* a;
+  cmat_t* ptr;
+  cmat_t* op;
+  cmat_t* obj;
+  long t;
+  int r0;
+  int c0;
+  int r1;
+  int c1;
+  int r;
+  int c;
+  float x;
+
+  a   = (elem_arg_t*)arg;
+  ptr = a->ptr;
+  op  = a->op;
+  obj = a->obj;
+
+  for (t = i0; t < i1; t++) {
+    r0 = (int)t * TRANS_TILE;
+    r1 = (r0 + TRANS_TILE < obj->rows)? r0 + TRANS_TILE: obj->rows;
+
+    for (c0 = 0; c0 < obj->cols; c0 += TRANS_TILE) {
+      c1 = (c0 + TRANS_TILE < obj->cols)? c0 + TRANS_TILE: obj->cols;
+
+      for (r = r0; r < r1; r++) {
+        for (c = c0; c < c1; c++) {
+          x = ELEM(ptr, r, c);
+
+          switch (a->type) {
+          case ELEM_ADD:
+            x += ELEM(op, r, c);
+            break;
+
+          case ELEM_SUB:
+            x -= ELEM(op, r, c);
+            break;
+
+          case ELEM_MUL:
+            x *= a->v;
+            break;
+          }
+
+          ELEM(obj, r, c) = x;
+        }
+      }
+    }
+  }
 }
 
-static float
-calc_det_dim2(float* r1, float* r2)
+static void
+calc_elem(cmat_t* ptr, cmat_t* op, float v, cmat_t* obj, int type)
 {
-  return det(r1[0], r1[1], r2[0], r2[1]);
+  elem_arg_t arg;
+  int nt;
+
+  arg.ptr  = ptr;
+  arg.op   = op;
+  arg.v    = v;
+  arg.obj  = obj;
+  arg.type = type;
+
+  nt = cmat_ctx_threads((long)obj->rows * obj->cols, ELEM_PARALLEL_MIN);
+
+  cmat_parallel_for((obj->rows + TRANS_TILE - 1) / TRANS_TILE, nt,
+                    elem_range, &arg);
 }
 
-static float
-calc_det_dim3(float* r1, float* r2, float* r3)
+/*
+ * オブジェクトの内容の置き換え
+ *  ptrのハンドルはそのままで、内容を*srcのものに置き換えて*srcを解放する。
+ *  形状が同じ場合は値をptrの領域にコピーし、異なる場合(およびptrが領域を
+ *  共有している場合)は*srcの領域を引き継ぐ(ptrがビューの場合は元の行列
+ *  から切り離される)。
+ */
+static void
+replace_object(cmat_t* ptr, cmat_t** src)
 {
-  float ret;
+  cmat_t* s;
+  int* pin;
+  int i;
 
-  ret = (r1[0] * det(r2[1], r2[2], r3[1], r3[2])) -
-        (r2[0] * det(r1[1], r1[2], r3[1], r3[2])) +
-        (r3[0] * det(r1[1], r1[2], r2[1], r2[2]));
+  s = *src;
 
-  return ret;
+  if (IS_TRANS(ptr) && ptr->rows == s->rows && ptr->cols == s->cols) {
+    calc_elem(s, NULL, 0.0f, ptr, ELEM_COPY);
+    free_object(s);
+
+  } else if ((ptr->flags & CMAT_FLAG_VIEW) &&
+             ptr->rows == s->rows && ptr->cols == s->cols) {
+    for (i = 0; i < s->rows; i++) {
+      memcpy(ptr->row[i], s->row[i], sizeof(float) * s->cols);
+    }
+
+    free_object(s);
+
+  } else if (!(ptr->flags & (CMAT_FLAG_VIEW | CMAT_FLAG_SEGMENTED)) &&
+             !IS_SHARED(ptr) &&
+             ptr->rows == s->rows && ptr->stride == s->stride) {
+    memcpy(ptr->tbl, s->tbl, sizeof(float) * s->rows * s->stride);
+
+    for (i = 0; i < s->rows; i++) {
+      ptr->row[i] = ptr->tbl + (s->row[i] - s->tbl);
+    }
+
+    ptr->cols = s->cols;
+    free_object(s);
+
+  } else {
+    release_storage(ptr);
+
+    /* ヘッダが共有中の領域に埋め込まれている場合はその参照を引き継ぐ */
+    pin = (ptr->flags & FLAG_PINNED)? ptr->ref: NULL;
+
+    memcpy(ptr, s, sizeof(cmat_t));
+
+    if (pin) {
+      ptr->flags |= FLAG_PINNED;
+      ptr->ref    = pin;
+    }
+
+    /* *srcのヘッダ部分は値テーブルと同じ領域の場合は残す */
+    if (ptr->blk != s) cmat_mem_free(ptr->pool, s);
+  }
+
+  *src = NULL;
 }
 
 static int
-calc_det(float** row, int sz, float thr, float* dst)
+alloc_table(float** src, int rows, int cols, float** dt, float*** dr)
 {
   int ret;
-  float* wt;   // as "Work Table"
-  float** wr;   // as "Work Rows"
-  float det;
+  float* tbl;
+  float** row;
+  int stride;
   int i;
   int j;
-  int n;
+
+  ret    = 0;
+  tbl    = NULL;
+  row    = NULL;
+  stride = ALIGN_COLS(cols);
 
   do {
-    ret = 0;
-    wt  = NULL;
-    wr  = NULL;
+    tbl = (float*)malloc(sizeof(float) * rows * stride);
+    if (tbl == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
 
-    /* alloc work buffer */
-    ret = alloc_table(row, sz, sz, &wt, &wr);
-    if (ret) break;
+    row = (float**)malloc(sizeof(float*) * rows);
+    if (row == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+  } while (0);
 
-    /* do LU decomposition */
-    n   = lu_decomp(wr, sz, thr, NULL);
+  if (!ret) {
+    for (i = 0; i < rows; i++) {
+      row[i] = tbl + (i * stride);
 
-    /* calc diagonal multiplier */
-    det = (n & 1)? -1.0: 1.0;
+      if (src) memcpy(row[i], src[i], sizeof(float) * cols);
+      for (j = cols; j < stride; j++) row[i][j] = 0.0f;
+    }
+
+    *dt = tbl;
+    *dr = row;
+  }
+
+  if(ret) {
+    if (tbl) free(tbl);
+    if (row) free(row);
+  }
+
+  return ret;
+}
+
+static int
+format(float val, char* dst, float thr)
+{
+  int ret;
+  int i;
+
+  if (fabsf(val) > thr) {
+    sprintf(dst, "% f", val);
+
+    for (i = strlen(dst) - 1; i > 0; i--) {
+      switch (dst[i]) {
+      case '0':
+        break;
+
+      case '.':
+        dst[i + 0] = '\0';
+        ret = i;
+        goto loop_out;
+
+      default:
+        dst[i + 1] = '\0';
+        ret = i + 1;
+        goto loop_out;
+      }
+    }
+
+  } else {
+    strcpy(dst, " 0");
+    ret = 1;
+  }
+  loop_out:
+
+  return ret;
+}
+
+static inline int
+fcmp(float f1, float f2, float coff)
+{
+  /*
+   * 絶対的な誤差ではなく、有効桁を意識した比較を行うために
+   * 若干複雑な比較を行っているので注意。
+   *
+   * 例えば、非常に大きな値同士の比較などの場合
+   * この場合差が大きくとも誤差が有効桁に収まっている場合は、
+   * 同値として扱うことが妥当となる。単純に差分を基準値と比
+   * 較するだけでは対応できない。
+   *
+   * なお、現在の実装でも完全ではないのでいずれ修正すること。
+   */
+
+  float v1;
+  int e1;
+
+  float v2;
+  int e2;
+
+  v1 = frexpf(f1, &e1);
+  v2 = frexpf(f2, &e2);
+
+  if (e1 == e2) {
+    f1 = v1;
+    f2 = v2;
+  }
+
+#if 0
+  if (fabsf(f1 - f2) > coff) {
+    printf("%.20f %.20f %.20g\n", f1, f2, fabsf(f1 - f2));
+  }
+#endif
+
+  return fabsf(f1 - f2) > coff;
+}
+
+/*
+ * 0ピボット列の退避情報
+ *
+ * ブロック化LU分解ではL成分を後からまとめて更新に用いるため、対角成分が0
+ * だった列(非ブロック版では消去を行わない列)の下三角成分を一旦0にして更新
+ * に影響しないようにし、分解終了後に元の値に戻す。行の入れ替えは行ポインタ
+ * の交換で行われるので、要素のアドレスは分解中に変化しない。
+ */
+typedef struct {
+  float** addr;
+  float* val;
+  int n;
+  int capa;
+} zpiv_t;
+
+static int
+zpiv_push(zpiv_t* zp, float* addr)
+{
+  int ret;
+  int capa;
+  float** a;
+  float* v;
+
+  ret = 0;
+
+  if (zp->n == zp->capa) do {
+    capa = (zp->capa < 16)? 16: GROW(zp->capa);
+
+    a = (float**)realloc(zp->addr, sizeof(float*) * capa);
+    if (a == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+
+    zp->addr = a;
+
+    v = (float*)realloc(zp->val, sizeof(float) * capa);
+    if (v == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+
+    zp->val  = v;
+    zp->capa = capa;
+  } while (0);
+
+  if (!ret) {
+    zp->addr[zp->n] = addr;
+    zp->val[zp->n]  = *addr;
+    zp->n++;
+
+    *addr = 0.0f;
+  }
+
+  return ret;
+}
+
+static void
+zpiv_restore(zpiv_t* zp)
+{
+  int i;
+
+  for (i = 0; i < zp->n; i++) {
+    *zp->addr[i] = zp->val[i];
+  }
+
+  if (zp->addr) free(zp->addr);
+  if (zp->val) free(zp->val);
+}
+
+/*
+ * http://hooktail.org/computer/index.php?LU%CA%AC%B2%F2
+ *
+ * m行 x w列のパネル(列c0から)に対する非ブロック版LU分解。消去はパネル内の
+ * 列に対してのみ行う。行の入れ替えは行ポインタの交換で行うので、パネル外の
+ * 列も合わせて入れ替わる。
+ */
+static int
+lu_leaf(float** row, int m, int c0, int w, float thr, int* piv, zpiv_t* zp,
+        int* swp)
+{
+  int ret;
+  int i;
+  int j;
+  int k;
+  int c;
+  float max;
+  float tmp;
+
+  float* pi;
+  float* pj;
+
+  ret = 0;
+
+  for (i = 0; i < w && !ret; i++) {
+    c   = c0 + i;
+    pi  = row[i];
+    max = fabsf(pi[c]);
+    k   = i;
+
+    /* 注目行以降で最大の値（絶対値）の存在する行を探す */
+    for (j = i + 1; j < m; j++) {
+      tmp = fabsf(row[j][c]);
+
+      /*
+       * 浮動小数点数の丸め誤差の蓄積のため、極小差の場合に大小比較がうまくい
+       * かないことがある。これを避けるために差の閾値比較で大小比較を行ってい
+       * る。以下のif文は tmp > max を評価している。
+       */
+      if (tmp - max > thr) {
+        max = tmp;
+        k   = j;
+      }
+    }
+
+    /* 注目行と最大値のあった行を入れ替える */
+    if (k != i) {
+      SWAP(row[i], row[k], float*);
+      if (piv) SWAP(piv[i], piv[k], int);
+
+      pi = row[i];
+      (*swp)++;
+    }
+
+    /* この時点で対角成分が0の場合は注目行に対する分解は終わってると
+       考えてよいので次の行に移動する */
+    if (pi[c] == 0.0) {
+      if (zp) {
+        for (j = i + 1; j < m && !ret; j++) {
+          if (row[j][c] != 0.0f) ret = zpiv_push(zp, row[j] + c);
+        }
+      }
+
+      continue;
+    }
+
+    /* forwarding erase */
+    for (j = i + 1; j < m; j++) {
+      pj  = row[j];
+      tmp = (pj[c] /= pi[c]);
+
+      cmat_kernel->nmadd(pj + (c + 1), pi + (c + 1), tmp, w - (i + 1));
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * 前進代入 (単位下三角行列による左からの求解)
+ *  row[0..w)の列c1からのn列を L11^-1 * A12 で置き換える。L11はrow[0..w)の
+ *  列c0からのw列の狭義下三角部分。
+ */
+typedef struct {
+  float** row;
+  int c0;
+  int w;
+  int c1;
+  int n;
+} trsm_arg_t;
+
+static void
+trsm_range(void* arg, long i0, long i1)
+{
+  trsm_arg_t* a;
+  long b;
+  int c;
+  int r;
+  int i;
+  int nb;
+  int e;
+
+  a = (trsm_arg_t*)arg;
+  e = a->c1 + a->n;
+
+  for (b = i0; b < i1; b++) {
+    c  = a->c1 + (int)b * LU_TRSM_COLS;
+    nb = (e - c < LU_TRSM_COLS)? e - c: LU_TRSM_COLS;
+
+    for (r = 1; r < a->w; r++) {
+      for (i = 0; i < r; i++) {
+        cmat_kernel->nmadd(a->row[r] + c, a->row[i] + c,
+                           a->row[r][a->c0 + i], nb);
+      }
+    }
+  }
+}
+
+static void
+lu_trsm(float** row, int c0, int w, int c1, int n)
+{
+  trsm_arg_t arg;
+  int nt;
+
+  arg.row = row;
+  arg.c0  = c0;
+  arg.w   = w;
+  arg.c1  = c1;
+  arg.n   = n;
+
+  nt = cmat_ctx_threads((long)w * w * n, LU_PARALLEL_MIN);
+
+  cmat_parallel_for((n + LU_TRSM_COLS - 1) / LU_TRSM_COLS, nt,
+                    trsm_range, &arg);
+}
+
+/*
+ * 後続行列の更新
+ *  c[0..m)の列ccからのn列から a[0..m)の列acからのk列 と b[0..k)の列bcから
+ *  のn列 の積を引く (A22 -= A21 * A12)
+ */
+static void
+lu_update(float** a, int ac, float** b, int bc, float** c, int cc,
+          int m, int n, int k)
+{
+  float** ap;
+  float** bp;
+  float** cp;
+  int err;
+  int i;
+  int p;
+
+  ap  = NULL;
+  bp  = NULL;
+  cp  = NULL;
+  err = !0;
+
+  if (m <= 0 || n <= 0 || k <= 0) return;
+
+  if ((long)m * n * k >= LU_GEMM_MIN) do {
+    /* GEMMエンジンは列オフセットを持たないので行ポインタを作り直す */
+    ap = (float**)malloc(sizeof(float*) * m);
+    bp = (float**)malloc(sizeof(float*) * k);
+    cp = (float**)malloc(sizeof(float*) * m);
+    if (ap == NULL || bp == NULL || cp == NULL) break;
+
+    for (i = 0; i < m; i++) {
+      ap[i] = a[i] + ac;
+      cp[i] = c[i] + cc;
+    }
+
+    for (i = 0; i < k; i++) {
+      bp[i] = b[i] + bc;
+    }
+
+    err = cmat_gemm_driver(m, n, k, -1.0f, ap, 0, bp, 0, 1.0f, cp);
+  } while (0);
+
+  /* 小さな更新(またはGEMM用のメモリが確保できなかった場合) */
+  if (err) {
+    for (i = 0; i < m; i++) {
+      for (p = 0; p < k; p++) {
+        cmat_kernel->nmadd(c[i] + cc, b[p] + bc, a[i][ac + p], n);
+      }
+    }
+  }
+
+  if (ap) free(ap);
+  if (bp) free(bp);
+  if (cp) free(cp);
+}
+
+/*
+ * パネル分解 (再帰版)
+ *  パネルを左右に分割し、左半分の分解 → 右上の前進代入 → 右下の更新 →
+ *  右下の分解 の順で処理する。
+ */
+static int
+lu_panel(float** row, int m, int c0, int w, float thr, int* piv, zpiv_t* zp,
+         int* swp)
+{
+  int ret;
+  int w1;
+
+  if (w <= LU_LEAF_COLS) {
+    ret = lu_leaf(row, m, c0, w, thr, piv, zp, swp);
+
+  } else do {
+    w1  = w / 2;
+
+    ret = lu_panel(row, m, c0, w1, thr, piv, zp, swp);
+    if (ret) break;
+
+    lu_trsm(row, c0, w1, c0 + w1, w - w1);
+    lu_update(row + w1, c0, row, c0 + w1, row + w1, c0 + w1,
+              m - w1, w - w1, w1);
+
+    ret = lu_panel(row + w1, m - w1, c0 + w1, w - w1, thr,
+                   (piv)? piv + w1: NULL, zp, swp);
+  } while (0);
+
+  return ret;
+}
+
+/*
+ * LU分解 (ブロック化right-looking版)
+ *
+ *  for j in [0, sz) step LU_BLOCK
+ *    列jからのパネルを再帰的に分解(行の入れ替えを含む)
+ *    U12 = L11^-1 * A12
+ *    A22 = A22 - L21 * U12   (GEMMエンジンで処理)
+ *
+ * @return エラーコード(0で正常終了)。行の入れ替え回数はswpに返す。
+ */
+static int
+lu_decomp(float** row, int sz, float thr, int* piv, int* swp)
+{
+  int ret;
+  zpiv_t zp;
+  int i;
+  int j;
+  int jb;
+  int r;
+
+  ret  = 0;
+  *swp = 0;
+
+  memset(&zp, 0, sizeof(zp));
+
+  if (piv) {
+    for (i = 0; i < sz; i++) piv[i] = i;
+  }
+
+  if (sz < LU_BLOCKED_MIN) {
+    /* 小さな行列は非ブロック版で処理する */
+    ret = lu_leaf(row, sz, 0, sz, thr, piv, NULL, swp);
+
+  } else {
+    for (j = 0; j < sz && !ret; j += LU_BLOCK) {
+      jb  = (sz - j < LU_BLOCK)? sz - j: LU_BLOCK;
+      r   = j + jb;
+
+      ret = lu_panel(row + j, sz - j, j, jb, thr, (piv)? piv + j: NULL, &zp,
+                     swp);
+
+      if (!ret && r < sz) {
+        lu_trsm(row + j, j, jb, r, sz - r);
+        lu_update(row + r, j, row + j, r, row + r, r, sz - r, sz - r, jb);
+      }
+    }
+
+    zpiv_restore(&zp);
+  }
+
+  return ret;
+}
+
+static float
+det(float a, float b, float c, float d)
+{
+  return (a * d) - (b * c);
+}
+
+static float
+calc_det_dim2(float* r1, float* r2)
+{
+  return det(r1[0], r1[1], r2[0], r2[1]);
+}
+
+static float
+calc_det_dim3(float* r1, float* r2, float* r3)
+{
+  float ret;
+
+  ret = (r1[0] * det(r2[1], r2[2], r3[1], r3[2])) -
+        (r2[0] * det(r1[1], r1[2], r3[1], r3[2])) +
+        (r3[0] * det(r1[1], r1[2], r2[1], r2[2]));
+
+  return ret;
+}
+
+static float
+calc_det_dim4(float* r1, float* r2, float* r3, float* r4)
+{
+  float s0, s1, s2, s3, s4, s5;
+  float c0, c1, c2, c3, c4, c5;
+
+  /* 上2行と下2行の2x2小行列式によるラプラス展開 */
+  s0 = det(r1[0], r1[1], r2[0], r2[1]);
+  s1 = det(r1[0], r1[2], r2[0], r2[2]);
+  s2 = det(r1[0], r1[3], r2[0], r2[3]);
+  s3 = det(r1[1], r1[2], r2[1], r2[2]);
+  s4 = det(r1[1], r1[3], r2[1], r2[3]);
+  s5 = det(r1[2], r1[3], r2[2], r2[3]);
+
+  c0 = det(r3[0], r3[1], r4[0], r4[1]);
+  c1 = det(r3[0], r3[2], r4[0], r4[2]);
+  c2 = det(r3[0], r3[3], r4[0], r4[3]);
+  c3 = det(r3[1], r3[2], r4[1], r4[2]);
+  c4 = det(r3[1], r3[3], r4[1], r4[3]);
+  c5 = det(r3[2], r3[3], r4[2], r4[3]);
+
+  return (s0 * c5) - (s1 * c4) + (s2 * c3) + (s3 * c2) - (s4 * c1) + (s5 * c0);
+}
+
+/*
+ * 余因子行列による小行列の逆行列の算出
+ *  結果はdに行優先で格納し、行列式を返す(行列式が0の場合のdの内容は不定)。
+ */
+static float
+calc_inverse_dim2(float** s, float* d)
+{
+  float ret;
+  float v;
+
+  ret  = calc_det_dim2(s[0], s[1]);
+  v    = 1.0f / ret;
+
+  d[0] =  s[1][1] * v;
+  d[1] = -s[0][1] * v;
+  d[2] = -s[1][0] * v;
+  d[3] =  s[0][0] * v;
+
+  return ret;
+}
+
+static float
+calc_inverse_dim3(float** s, float* d)
+{
+  float ret;
+  float v;
+  float* r1;
+  float* r2;
+  float* r3;
+
+  r1   = s[0];
+  r2   = s[1];
+  r3   = s[2];
+
+  d[0] = det(r2[1], r2[2], r3[1], r3[2]);
+  d[3] = det(r2[2], r2[0], r3[2], r3[0]);
+  d[6] = det(r2[0], r2[1], r3[0], r3[1]);
+
+  ret  = (r1[0] * d[0]) + (r1[1] * d[3]) + (r1[2] * d[6]);
+  v    = 1.0f / ret;
+
+  d[0] *= v;
+  d[1] = det(r1[2], r1[1], r3[2], r3[1]) * v;
+  d[2] = det(r1[1], r1[2], r2[1], r2[2]) * v;
+  d[3] *= v;
+  d[4] = det(r1[0], r1[2], r3[0], r3[2]) * v;
+  d[5] = det(r1[2], r1[0], r2[2], r2[0]) * v;
+  d[6] *= v;
+  d[7] = det(r1[1], r1[0], r3[1], r3[0]) * v;
+  d[8] = det(r1[0], r1[1], r2[0], r2[1]) * v;
+
+  return ret;
+}
+
+static float
+calc_inverse_dim4(float** s, float* d)
+{
+  float ret;
+  float v;
+  float* r1;
+  float* r2;
+  float* r3;
+  float* r4;
+  float s0, s1, s2, s3, s4, s5;
+  float c0, c1, c2, c3, c4, c5;
+
+  r1  = s[0];
+  r2  = s[1];
+  r3  = s[2];
+  r4  = s[3];
+
+  s0  = det(r1[0], r1[1], r2[0], r2[1]);
+  s1  = det(r1[0], r1[2], r2[0], r2[2]);
+  s2  = det(r1[0], r1[3], r2[0], r2[3]);
+  s3  = det(r1[1], r1[2], r2[1], r2[2]);
+  s4  = det(r1[1], r1[3], r2[1], r2[3]);
+  s5  = det(r1[2], r1[3], r2[2], r2[3]);
+
+  c0  = det(r3[0], r3[1], r4[0], r4[1]);
+  c1  = det(r3[0], r3[2], r4[0], r4[2]);
+  c2  = det(r3[0], r3[3], r4[0], r4[3]);
+  c3  = det(r3[1], r3[2], r4[1], r4[2]);
+  c4  = det(r3[1], r3[3], r4[1], r4[3]);
+  c5  = det(r3[2], r3[3], r4[2], r4[3]);
+
+  ret = (s0 * c5) - (s1 * c4) + (s2 * c3) + (s3 * c2) - (s4 * c1) + (s5 * c0);
+  v   = 1.0f / ret;
+
+  d[0]  = ( (r2[1] * c5) - (r2[2] * c4) + (r2[3] * c3)) * v;
+  d[1]  = (-(r1[1] * c5) + (r1[2] * c4) - (r1[3] * c3)) * v;
+  d[2]  = ( (r4[1] * s5) - (r4[2] * s4) + (r4[3] * s3)) * v;
+  d[3]  = (-(r3[1] * s5) + (r3[2] * s4) - (r3[3] * s3)) * v;
+
+  d[4]  = (-(r2[0] * c5) + (r2[2] * c2) - (r2[3] * c1)) * v;
+  d[5]  = ( (r1[0] * c5) - (r1[2] * c2) + (r1[3] * c1)) * v;
+  d[6]  = (-(r4[0] * s5) + (r4[2] * s2) - (r4[3] * s1)) * v;
+  d[7]  = ( (r3[0] * s5) - (r3[2] * s2) + (r3[3] * s1)) * v;
+
+  d[8]  = ( (r2[0] * c4) - (r2[1] * c2) + (r2[3] * c0)) * v;
+  d[9]  = (-(r1[0] * c4) + (r1[1] * c2) - (r1[3] * c0)) * v;
+  d[10] = ( (r4[0] * s4) - (r4[1] * s2) + (r4[3] * s0)) * v;
+  d[11] = (-(r3[0] * s4) + (r3[1] * s2) - (r3[3] * s0)) * v;
+
+  d[12] = (-(r2[0] * c3) + (r2[1] * c1) - (r2[2] * c0)) * v;
+  d[13] = ( (r1[0] * c3) - (r1[1] * c1) + (r1[2] * c0)) * v;
+  d[14] = (-(r4[0] * s3) + (r4[1] * s1) - (r4[2] * s0)) * v;
+  d[15] = ( (r3[0] * s3) - (r3[1] * s1) + (r3[2] * s0)) * v;
+
+  return ret;
+}
+
+/*
+ * 小行列(2x2, 3x3, 4x4)同士の積
+ *  各行の計算は列方向に展開してあるので、コンパイラによって行単位でベク
+ *  トル化される。
+ */
+static void
+calc_product_dim2(float** a, float** b, float** d)
+{
+  int r;
+  float* s;
+  float* t;
+
+  for (r = 0; r < 2; r++) {
+    s    = a[r];
+    t    = d[r];
+
+    t[0] = (s[0] * b[0][0]) + (s[1] * b[1][0]);
+    t[1] = (s[0] * b[0][1]) + (s[1] * b[1][1]);
+  }
+}
+
+static void
+calc_product_dim3(float** a, float** b, float** d)
+{
+  int r;
+  float* s;
+  float* t;
+
+  for (r = 0; r < 3; r++) {
+    s    = a[r];
+    t    = d[r];
+
+    t[0] = (s[0] * b[0][0]) + (s[1] * b[1][0]) + (s[2] * b[2][0]);
+    t[1] = (s[0] * b[0][1]) + (s[1] * b[1][1]) + (s[2] * b[2][1]);
+    t[2] = (s[0] * b[0][2]) + (s[1] * b[1][2]) + (s[2] * b[2][2]);
+  }
+}
+
+static void
+calc_product_dim4(float** a, float** b, float** d)
+{
+  int r;
+  float* s;
+  float* t;
+
+  for (r = 0; r < 4; r++) {
+    s    = a[r];
+    t    = d[r];
+
+    t[0] = (s[0] * b[0][0]) + (s[1] * b[1][0]) +
+           (s[2] * b[2][0]) + (s[3] * b[3][0]);
+    t[1] = (s[0] * b[0][1]) + (s[1] * b[1][1]) +
+           (s[2] * b[2][1]) + (s[3] * b[3][1]);
+    t[2] = (s[0] * b[0][2]) + (s[1] * b[1][2]) +
+           (s[2] * b[2][2]) + (s[3] * b[3][2]);
+    t[3] = (s[0] * b[0][3]) + (s[1] * b[1][3]) +
+           (s[2] * b[2][3]) + (s[3] * b[3][3]);
+  }
+}
+
+/*
+ * 小行列(1x1〜4x4)の逆行列の算出
+ *  結果はdに行優先で格納し、行列式を返す。
+ */
+static float
+calc_inverse_fixed(float** row, int sz, float* d)
+{
+  float ret;
+
+  switch (sz) {
+  case 1:
+    ret  = row[0][0];
+    d[0] = 1.0f / ret;
+    break;
+
+  case 2:
+    ret = calc_inverse_dim2(row, d);
+    break;
+
+  case 3:
+    ret = calc_inverse_dim3(row, d);
+    break;
+
+  default:
+    ret = calc_inverse_dim4(row, d);
+    break;
+  }
+
+  return ret;
+}
+
+static int
+calc_det(float** row, int sz, float thr, float* dst)
+{
+  int ret;
+  float* wt;   // as "Work Table"
+  float** wr;   // as "Work Rows"
+  float det;
+  int i;
+  int j;
+  int n;
+
+  do {
+    ret = 0;
+    wt  = NULL;
+    wr  = NULL;
+
+    /* alloc work buffer */
+    ret = alloc_table(row, sz, sz, &wt, &wr);
+    if (ret) break;
+
+    /* do LU decomposition */
+    ret = lu_decomp(wr, sz, thr, NULL, &n);
+    if (ret) break;
+
+    /* calc diagonal multiplier */
+    det = (n & 1)? -1.0: 1.0;
+
+    for (i = 0; i < sz; i++) {
+      det *= wr[i][i];
+    }
+  } while (0);
+
+  if (wr) free(wr);
+  if (wt) free(wt);
+  if (!ret) *dst = det;
+
+  return ret;
+}
+
+typedef struct {
+  float** lu;
+  int n;
+  int* piv;
+  char* fl;   // 巡回置換の先頭以外の列を示すフラグ
+  float** dst;
+} inv_arg_t;
+
+/*
+ * U^-1の列ブロック[i0, i1)の算出
+ *  各ブロック内では下の行から順に求める。
+ */
+static void
+inv_upper_range(void* arg, long i0, long i1)
+{
+  inv_arg_t* a;
+  float* d;
+  float inv;
+  long b;
+  int c;
+  int e;
+  int i;
+  int k;
+  int s;
+
+  a = (inv_arg_t*)arg;
+
+  for (b = i0; b < i1; b++) {
+    c = (int)b * INV_COLS;
+    e = (a->n - c < INV_COLS)? a->n: c + INV_COLS;
+
+    for (i = a->n - 1; i >= 0; i--) {
+      d = a->dst[i];
+      memset(d + c, 0, sizeof(float) * (e - c));
+
+      if (i >= e) continue;
+
+      for (k = i + 1; k < e; k++) {
+        s = (k > c)? k: c;
+        cmat_kernel->nmadd(d + s, a->dst[k] + s, a->lu[i][k], e - s);
+      }
+
+      inv = 1.0f / a->lu[i][i];
+      s   = (i + 1 > c)? i + 1: c;
+
+      if (s < e) cmat_kernel->mul(d + s, d + s, inv, e - s);
+      if (i >= c) d[i] = inv;
+    }
+  }
+}
+
+/*
+ * 行[i0, i1)についての X * L = U^-1 の求解と列の並べ替え
+ */
+static void
+inv_solve_range(void* arg, long i0, long i1)
+{
+  inv_arg_t* a;
+  float* w;
+  float inv;
+  float tmp;
+  long i;
+  int k;
+  int s;
+  int r;
+
+  a = (inv_arg_t*)arg;
+
+  for (i = i0; i < i1; i++) {
+    w = a->dst[i];
+
+    for (k = a->n - 1; k > 0; k--) {
+      if (w[k] != 0.0f) cmat_kernel->nmadd(w, a->lu[k], w[k], k);
+    }
+
+    for (s = 0; s < a->n; s++) {
+      if (a->fl[s] || a->piv[s] == s) continue;
+
+      inv = w[s];
+      for (r = a->piv[s]; r != s; r = a->piv[r]) {
+        tmp  = w[r];
+        w[r] = inv;
+        inv  = tmp;
+      }
+      w[s] = inv;
+    }
+  }
+}
+
+/*
+ * LU分解の結果からの逆行列の算出
+ *  luはlu_decomp()で分解済みの行列、pivはその際のピボット情報。
+ *  U^-1を求めた後に X * L = U^-1 を解き、最後にXの列をpivに従って並べ替
+ *  える (A^-1 = U^-1 * L^-1 * P)。結果はdstに格納する。
+ */
+static int
+calc_inverse(float** lu, int n, int* piv, float** dst)
+{
+  int ret;
+  inv_arg_t arg;
+  char* fl;
+  int s;
+  int r;
+  int nt;
+
+  ret = 0;
+  nt  = cmat_ctx_threads((long)n * n * n, LU_PARALLEL_MIN);
+  fl  = (char*)malloc(sizeof(char) * n);
+
+  if (fl == NULL) ret = CMAT_ERR_NOMEM;
+
+  arg.lu  = lu;
+  arg.n   = n;
+  arg.piv = piv;
+  arg.fl  = fl;
+  arg.dst = dst;
+
+  /*
+   * U^-1の算出
+   *  列ブロック同士は独立しているので列ブロック単位で並列化する。
+   */
+  if (!ret) {
+    cmat_parallel_for((n + INV_COLS - 1) / INV_COLS, nt,
+                      inv_upper_range, &arg);
+  }
+
+  /*
+   * 巡回置換の先頭の算出
+   */
+  if (!ret) {
+    memset(fl, 0, sizeof(char) * n);
+
+    for (s = 0; s < n; s++) {
+      if (fl[s]) continue;
+      for (r = piv[s]; r != s; r = piv[r]) fl[r] = !0;
+    }
+  }
+
+  /*
+   * X * L = U^-1 の求解と列の並べ替え
+   *  各行は独立しているので行単位で並列化する。
+   */
+  if (!ret) {
+    cmat_parallel_for(n, nt, inv_solve_range, &arg);
+  }
+
+  if (fl) free(fl);
+
+  return ret;
+}
+
+/*
+ * ドット積の部分和の算出
+ *  二つの行列を行優先で一次元に展開した時の[i0, i1)の範囲の要素について
+ *  積和を求める。両行列の行の切れ目で区切った連続領域ごとにカーネルを呼び
+ *  出すので、形状が異なっていても要素単位の処理にはならない。
+ */
+static float
+calc_dot(float** ptr, int pc, float** op, int oc, long i0, long i1)
+{
+  float ret;
+  float* s;
+  float* o;
+  long i;
+  int r1;
+  int c1;
+  int r2;
+  int c2;
+  int n;
+
+  ret = 0.0f;
+  r1  = i0 / pc;
+  c1  = i0 % pc;
+  r2  = i0 / oc;
+  c2  = i0 % oc;
+
+  for (i = i0; i < i1; i += n) {
+    s = ptr[r1] + c1;
+    o = op[r2] + c2;
+
+    n = pc - c1;
+    if (n > oc - c2) n = oc - c2;
+    if (n > i1 - i) n = i1 - i;
+
+    ret += cmat_kernel->dot(s, o, n);
+
+    if ((c1 += n) == pc) {
+      r1++;
+      c1 = 0;
+    }
+
+    if ((c2 += n) == oc) {
+      r2++;
+      c2 = 0;
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * ドット積の部分和の算出(転置ビューの混在時)
+ *  転置後の形状で行優先に展開した[i0, i1)の範囲を要素単位で処理する。
+ */
+static float
+calc_dot_elem(cmat_t* ptr, cmat_t* op, long i0, long i1)
+{
+  float ret;
+  long i;
+
+  ret = 0.0f;
+
+  for (i = i0; i < i1; i++) {
+    ret += ELEM(ptr, i / ptr->cols, i % ptr->cols) *
+           ELEM(op, i / op->cols, i % op->cols);
+  }
+
+  return ret;
+}
+
+static void
+sort(int* a, size_t n)
+{
+  int h;
+  int f;
+  int i;
+
+  /*
+   * sort by ascending order
+   */
+
+  h = n;
+
+  do {
+    if (h > 1) {
+      h = SHRINK(h);
+    } else if (!f) {
+      break;
+    }
+
+    f = 0;
+
+    if (h == 9 || h == 10) h = 11;
+
+    for (i = 0; i < ((int)n - h); i++) {
+      if (a[i] > a[i + h]) {
+        SWAP(a[i], a[i + h], int);
+        f = !0;
+      }
+    }
+  } while (1);
+}
+
+typedef struct {
+  cmat_t* obj;
+  float* src;
+} fill_arg_t;
+
+static void
+fill_range(void* arg, long i0, long i1)
+{
+  fill_arg_t* a;
+  cmat_t* obj;
+  long i;
+
+  a   = (fill_arg_t*)arg;
+  obj = a->obj;
+
+  for (i = i0; i < i1; i++) {
+    if (a->src) {
+      memcpy(obj->row[i], a->src + (i * obj->cols), sizeof(float) * obj->cols);
+    } else {
+      memset(obj->row[i], 0, sizeof(float) * obj->stride);
+    }
+  }
+}
+
+static int
+new_object(cmat_pool_t* pool, float* src, int rows, int cols,
+           cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+  fill_arg_t arg;
+  int nt;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (rows < 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (cols <= 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while(0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ret = create_object(pool, rows, cols, DEFAULT_CUTOFF, &obj);
+  }
+
+  /*
+   * set initial values
+   *  NUMAの配置方針が指定されている場合は、演算と同じ行の分割で並列に書き
+   *  込む(CMAT_NUMA_FIRST_TOUCHでは書き込んだスレッドのノードに置かれる)。
+   */
+  if (!ret && pool == NULL && cmat_ctx_numa() != CMAT_NUMA_NONE) {
+    arg.obj = obj;
+    arg.src = src;
+
+    nt = cmat_ctx_threads((long)rows * obj->stride, NUMA_MIN);
+    cmat_parallel_for(rows, nt, fill_range, &arg);
+
+  } else if (!ret) {
+    if (src) {
+      for (i = 0; i < rows; i++) {
+        memcpy(obj->row[i], src, sizeof(float) * cols);
+        src += cols;
+      }
+    } else {
+      memset(obj->tbl, 0, sizeof(float) * rows * obj->stride);
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj) free_object(obj);
+  }
+
+  return ret;
+}
+
+/**
+ * 行列オブジェクトの生成
+ *
+ * @param src   初期値(行優先で rows * cols 個、NULLの場合はゼロで初期化)
+ * @param rows  行数の指定
+ * @param cols  列数の指定
+ * @param dst   生成したオブジェクトの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_new(float* src, int rows, int cols, cmat_t** dst)
+{
+  return new_object(NULL, src, rows, cols, dst);
+}
+
+/**
+ * メモリプールからの行列オブジェクトの生成
+ *
+ * @param pool  領域を確保するメモリプール
+ * @param src   初期値(行優先で rows * cols 個、NULLの場合はゼロで初期化)
+ * @param rows  行数の指定
+ * @param cols  列数の指定
+ * @param dst   生成したオブジェクトの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 生成したオブジェクトを元にした演算結果のオブジェクト(dstに新規に
+ *       生成されるもの)も同じプールから確保される。
+ */
+int
+cmat_pool_alloc(cmat_pool_t* pool, float* src, int rows, int cols,
+                cmat_t** dst)
+{
+  int ret;
+
+  if (pool == NULL) {
+    ret = CMAT_ERR_BADDR;
+  } else {
+    ret = new_object(pool, src, rows, cols, dst);
+  }
+
+  return ret;
+}
+
+/*
+ * 格納領域を共有するオブジェクトの生成
+ *  ヘッダのみを確保し、ptrと行テーブル・値テーブルを共有する。
+ */
+static int
+share_object(cmat_t* ptr, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+  int* ref;
+
+  ret = 0;
+  ref = ptr->ref;
+  obj = (cmat_t*)cmat_mem_alloc(ptr->pool, HEAD_SIZE);
+
+  if (obj == NULL) ret = CMAT_ERR_NOMEM;
+
+  if (!ret && ref == NULL) {
+    ref = (int*)cmat_mem_alloc(ptr->pool, sizeof(int));
+
+    if (ref == NULL) {
+      ret = CMAT_ERR_NOMEM;
+    } else {
+      *ref = 1;
+    }
+  }
+
+  if (!ret) {
+    __atomic_add_fetch(ref, 1, __ATOMIC_RELAXED);
+    ptr->ref = ref;
+
+    memcpy(obj, ptr, sizeof(cmat_t));
+    *dst = obj;
+  }
+
+  if (ret) {
+    if (obj) cmat_mem_free(ptr->pool, obj);
+  }
+
+  return ret;
+}
+
+/**
+ * 行列オブジェクトの複製
+ *
+ * @param ptr   複製元になる行列オブジェクト
+ * @param dst   生成したオブジェクトの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 値はコピーせずにptrと格納領域を共有し(コピーオンライト)、どちら
+ *       かに書き込む演算を行った時点で領域を複製する。CMAT_ROW()経由で直
+ *       接書き込む場合は、事前にcmat_unshare()を呼び出すこと。
+ * @note ビュー、およびビューを作成したことのある行列の複製は値をコピーす
+ *       る(ビュー経由の書き込みを検出できないため)。
+ */
+int
+cmat_clone(cmat_t* ptr, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while(0);
+
+  /*
+   * share storage
+   */
+  if (!ret) {
+    if (!(ptr->flags & (CMAT_FLAG_VIEW | FLAG_VIEWED | FLAG_PINNED))) {
+      ret = share_object(ptr, &obj);
+    }
+  }
+
+  /*
+   * alloc memory
+   */
+  if (!ret && !obj) {
+    ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+
+    /*
+     * copy values
+     */
+    if (!ret) {
+      if (IS_TRANS(ptr)) {
+        calc_elem(ptr, NULL, 0.0f, obj, ELEM_COPY);
+
+      } else if (ptr->flags & (CMAT_FLAG_VIEW | CMAT_FLAG_SEGMENTED)) {
+        for (i = 0; i < ptr->rows; i++) {
+          memcpy(obj->row[i], ptr->row[i], sizeof(float) * ptr->cols);
+        }
+
+      } else {
+        memcpy(obj->tbl, ptr->tbl, sizeof(float) * ptr->rows * ptr->stride);
+
+        for (i = 0; i < ptr->rows; i ++) {
+          obj->row[i] = obj->tbl + (ptr->row[i] - ptr->tbl);
+        }
+      }
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * 格納領域の共有の解除
+ *
+ * @param ptr   対象の行列オブジェクト
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note cmat_clone()で他のオブジェクトと格納領域を共有している場合、値を
+ *       新たな領域にコピーして共有を解く。共有していない場合は何もしない。
+ *       ライブラリの演算は必要に応じて自動的に共有を解くので、本関数は
+ *       CMAT_ROW()経由で直接書き込む前にのみ使用すればよい。
+ */
+int
+cmat_unshare(cmat_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * copy shared storage
+   */
+  if (!ret) {
+    ret = unshare_object(ptr, !0);
+  }
+
+  return ret;
+}
+
+/**
+ * 部分行列のビューの生成
+ *
+ * @param ptr   元になる行列オブジェクト
+ * @param r0    部分行列の先頭行
+ * @param c0    部分行列の先頭列
+ * @param rows  部分行列の行数
+ * @param cols  部分行列の列数
+ * @param dst   生成したビューの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note ビューは値をコピーせずにptrの領域を参照する。ビューへの書き込み
+ *       はptrに反映され、ビューは他の行列オブジェクトと同様に全ての演算
+ *       の入力・出力に使用できる。cmat_destroy()はビュー自身の行テーブル
+ *       のみを解放する。
+ * @note ptrを削除した場合や、ptrの形状を変える演算(dstにNULLを指定した
+ *       cmat_product()など)やcmat_append()を行った場合、ビューは無効に
+ *       なる。逆にビューに対してそれらを行った場合、ビューは値をコピーし
+ *       てptrから切り離される。
+ * @note 同じ領域を参照するビュー同士の重なりは検出しない。積などの出力
+ *       先に入力と重なるビューを指定しないこと。
+ */
+int
+cmat_view(cmat_t* ptr, int r0, int c0, int rows, int cols, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    if (rows <= 0 || cols <= 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (r0 < 0 || c0 < 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (r0 + rows > ptr->rows || c0 + cols > ptr->cols) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * copy shared storage (writes through the view must not reach clones)
+   */
+  if (!ret && !(ptr->flags & CMAT_FLAG_VIEW)) {
+    ret = unshare_object(ptr, !0);
+    if (!ret) ptr->flags |= FLAG_VIEWED;
+  }
+
+  /*
+   * alloc memory (header and row table only)
+   */
+  if (!ret) {
+    ret = alloc_view(ptr->pool, rows, cols, ptr->stride, ptr->coff, &obj);
+  }
+
+  /*
+   * setup row table
+   */
+  if (!ret) {
+    for (i = 0; i < rows; i++) {
+      obj->row[i] = ptr->row[r0 + i] + c0;
+    }
+
+    obj->tbl = obj->row[0];
+
+    if ((ptr->flags & CMAT_FLAG_ALIGNED) && (c0 % cmat_kernel->width) == 0) {
+      obj->flags |= CMAT_FLAG_ALIGNED;
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * 外部バッファを参照する行列オブジェクトの生成
+ *
+ * @param data    行列の値が格納されたバッファ(行優先)
+ * @param rows    行数の指定
+ * @param cols    列数の指定
+ * @param stride  行の間隔(float数, cols以上)
+ * @param dst     生成したオブジェクトの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 値はコピーせずにdataを直接参照する(ビューと同じ扱いになる)。
+ *       cmat_destroy()はオブジェクト自身のみを解放し、dataは解放しない。
+ *       dataはオブジェクトを削除するまで有効でなければならない。
+ * @note パディング部分(stride - cols列)には書き込まない。
+ */
+int
+cmat_wrap(float* data, int rows, int cols, int stride, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (data == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (rows <= 0 || cols <= 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+
+    if (stride < cols) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory (header and row table only)
+   */
+  if (!ret) {
+    ret = alloc_view(NULL, rows, cols, stride, DEFAULT_CUTOFF, &obj);
+  }
+
+  /*
+   * setup row table
+   */
+  if (!ret) {
+    for (i = 0; i < rows; i++) {
+      obj->row[i] = data + ((size_t)i * stride);
+    }
+
+    obj->tbl = data;
+
+    if (((uintptr_t)data % (sizeof(float) * cmat_kernel->width)) == 0 &&
+        (stride % cmat_kernel->width) == 0) {
+      obj->flags |= CMAT_FLAG_ALIGNED;
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * 転置ビューの生成
+ *
+ * @param ptr   元になる行列オブジェクト
+ * @param dst   生成したビューの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note ビューは値を並べ替えずにptrの領域を参照し、ptr->cols x ptr->rows
+ *       の行列(ptrの転置)として振る舞う。cmat_product()やcmat_gemm()では
+ *       GEMMエンジンのパッキング時に転置して読み込むので、A^T * Bや
+ *       A * B^Tの算出で転置行列の生成は発生しない。
+ * @note 和・差・スカラー積・ドット積・転置・複製・比較でも使用できる。
+ *       cmat_append(), cmat_view(), cmat_inverse(), cmat_lu_decomp(),
+ *       cmat_permute_row(), cmat_permute_column()はCMAT_ERR_INVALを返す。
+ * @note CMAT_ROW()で得られるのはptrの行(ビューの列)である。
+ * @note ビューの有効期間はcmat_view()と同じ。
+ */
+int
+cmat_transpose_view(cmat_t* ptr, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * copy shared storage (writes through the view must not reach clones)
+   */
+  if (!ret && !(ptr->flags & CMAT_FLAG_VIEW)) {
+    ret = unshare_object(ptr, !0);
+    if (!ret) ptr->flags |= FLAG_VIEWED;
+  }
+
+  /*
+   * alloc memory (header and row table only)
+   */
+  if (!ret) {
+    ret = alloc_view(ptr->pool, STORE_ROWS(ptr), STORE_COLS(ptr),
+                     ptr->stride, ptr->coff, &obj);
+  }
+
+  /*
+   * setup row table
+   */
+  if (!ret) {
+    for (i = 0; i < obj->rows; i++) {
+      obj->row[i] = ptr->row[i];
+    }
+
+    obj->tbl    = (obj->rows > 0)? obj->row[0]: NULL;
+    obj->flags |= (ptr->flags & CMAT_FLAG_ALIGNED);
+
+    /* 転置ビューの転置は通常のビューになる */
+    if (!IS_TRANS(ptr)) {
+      obj->rows   = ptr->cols;
+      obj->cols   = ptr->rows;
+      obj->flags |= CMAT_FLAG_TRANS;
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * 行列オブジェクトの削除
+ *
+ * @param dst   削除するオブジェクトのポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_destroy(cmat_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    free_object(ptr);
+  }
+
+  return ret;
+}
+
+/**
+ * 行列オブジェクトの内容表示
+ *
+ * @param ptr   対象の行列オブジェクト
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_print(cmat_t* ptr, char* label)
+{
+  int ret;
+  int r;
+  int c;
+
+  char fmt[32];
+  char str[32];
+  int len;
+  int max;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * make format string
+   */
+  if (!ret) {
+    max = 0;
+
+    for (r = 0; r < ptr->rows; r++) {
+      for (c = 0; c < ptr->cols; c++) {
+        len = format(ELEM(ptr, r, c), str, ptr->coff);
+        if (len > max) max = len;
+      }
+    }
+
+    sprintf(fmt, "%%%ds", max);
+  }
+
+  /*
+   * show content
+   */
+  if (!ret) {
+    if (label != NULL) printf("%s:\n", label);
+
+    for (r = 0; r < ptr->rows; r++) {
+      if (label != NULL) printf("  ");
+      printf("[");
+
+      for (c = 0; c < ptr->cols; c++) {
+        format(ELEM(ptr, r, c), str, ptr->coff);
+        printf(fmt, str);
+        if (c < (ptr->cols - 1)) printf(" ");
+      }
+
+      printf(" ]\n");
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * セグメントの継ぎ足し
+ *  既存の値テーブルはそのまま残し、n行分(最低SEG_ROWS行)の領域を追加する。
+ *  行テーブルが足りない場合は別の領域に確保し直す(コピーはポインタのみ)。
+ */
+static int
+append_segment(cmat_t* ptr, int n)
+{
+  int ret;
+  seg_t* seg;
+  seg_t* last;
+  float** row;
+  float* tbl;
+  int rcapa;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  row   = NULL;
+  last  = IS_SEGMENTED(ptr)? (seg_t*)ptr->blk: NULL;
+  rcapa = (last)? last->rcapa: 0;
+
+  if (n < (int)SEG_ROWS(ptr->stride)) n = SEG_ROWS(ptr->stride);
+  if (n < 1) n = 1;
+
+  /*
+   * alloc memory
+   */
+  seg = (seg_t*)cmat_mem_alloc(ptr->pool, SEG_HEAD +
+                                          (sizeof(float) * n * ptr->stride));
+  if (seg == NULL) ret = CMAT_ERR_NOMEM;
+
+  if (!ret && rcapa < (ptr->capa + n)) {
+    rcapa = ptr->capa + n;
+    rcapa = GROW(rcapa);
+    row   = (float**)cmat_mem_alloc(ptr->pool, ROWS_SIZE(rcapa));
+
+    if (row == NULL) {
+      ret = CMAT_ERR_NOMEM;
+    } else {
+      memcpy(row, ptr->row, sizeof(float*) * ptr->capa);
+    }
+  }
+
+  /*
+   * update context
+   */
+  if (!ret) {
+    if (row) {
+      /* セグメント化する前の行テーブルは元の領域の一部なので残す */
+      if (last) cmat_mem_free(ptr->pool, ptr->row);
+      ptr->row = row;
+    }
+
+    tbl = (float*)((char*)seg + SEG_HEAD);
+
+    for (i = 0; i < n; i++) {
+      ptr->row[ptr->capa + i] = tbl + ((size_t)i * ptr->stride);
+    }
+
+    seg->prev    = last;
+    seg->base    = (last)? last->base: ((ptr->blk != ptr)? ptr->blk: NULL);
+    seg->rcapa   = rcapa;
+
+    ptr->blk     = seg;
+    ptr->capa   += n;
+    ptr->flags  |= CMAT_FLAG_SEGMENTED;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (seg) cmat_mem_free(ptr->pool, seg);
+  }
+
+  return ret;
+}
+
+/*
+ * 容量の拡張
+ *  capa行分の領域を確保する。大きい行列はセグメントを継ぎ足し、それ以外は
+ *  一つの領域に確保し直す(ビューの場合は値をコピーして元の行列から切り離
+ *  す)。どちらの場合も格納領域の共有は解かれる。
+ */
+static int
+grow_object(cmat_t* ptr, int capa)
+{
+  int ret;
+  void* blk;
+  float* tbl;
+  float** row;
+  int i;
+  int j;
+
+  ret = 0;
+
+  if (USE_SEGMENT(ptr)) {
+    ret = unshare_object(ptr, !0);
+    if (!ret) ret = append_segment(ptr, capa - ptr->capa);
+
+  } else do {
+    /* 行テーブルと値テーブルを一つの領域に確保し直す(境界を揃えたまま
+       拡張するためrealloc()は使わない) */
+    blk = cmat_mem_alloc(ptr->pool, ROWS_SIZE(capa) +
+                                    (sizeof(float) * capa * ptr->stride));
+    if (blk == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+
+    layout_storage(blk, capa, ptr->stride, &row, &tbl);
+
+    if (ptr->flags & CMAT_FLAG_VIEW) {
+      /* ビューの場合は値をコピーして元の行列から切り離す */
+      for (i = 0; i < ptr->rows; i++) {
+        memcpy(row[i], ptr->row[i], sizeof(float) * ptr->cols);
+        for (j = ptr->cols; j < ptr->stride; j++) row[i][j] = 0.0f;
+      }
+
+      ptr->flags &= ~CMAT_FLAG_VIEW;
+
+      if (ptr->stride % cmat_kernel->width == 0) {
+        ptr->flags |= CMAT_FLAG_ALIGNED;
+      }
+
+    } else if (ptr->row) {
+      /* 既存の行構成を再現する（他の演算でピボット操作で行位置が交換さ
+         れている場合がある） */
+      memcpy(tbl, ptr->tbl, sizeof(float) * ptr->capa * ptr->stride);
+
+      for (i = 0; i < ptr->capa; i++) {
+        row[i] = tbl + (ptr->row[i] - ptr->tbl);
+      }
+
+      /* 既存の領域は不要になったので解放(ヘッダと同じ領域の場合はオブ
+         ジェクトの削除時に解放される。共有中の場合は参照を外す) */
+      release_storage(ptr);
+    }
+
+    /* コンテキストの更新 */
+    ptr->tbl  = tbl;
+    ptr->row  = row;
+    ptr->capa = capa;
+    ptr->blk  = blk;
+  } while (0);
+
+  return ret;
+}
+
+typedef struct {
+  cmat_t* ptr;
+  float* src;
+  int stride;
+} append_arg_t;
+
+static void
+append_range(void* arg, long i0, long i1)
+{
+  append_arg_t* a;
+  cmat_t* ptr;
+  float* d;
+  long i;
+  int j;
+
+  a   = (append_arg_t*)arg;
+  ptr = a->ptr;
+
+  for (i = i0; i < i1; i++) {
+    d = ptr->row[ptr->rows + i];
+
+    memcpy(d, a->src + ((size_t)i * a->stride), sizeof(float) * ptr->cols);
+    for (j = ptr->cols; j < ptr->stride; j++) d[j] = 0.0f;
+  }
+}
+
+/*
+ * 行の一括追加
+ *  srcからstride要素おきにn行分をコピーする。容量が足りない場合はGROW()
+ *  で拡張する(必要な行数の方が多い場合はその行数まで)。
+ */
+static int
+append_rows(cmat_t* ptr, float* src, int n, int stride)
+{
+  int ret;
+  append_arg_t arg;
+  int capa;
+  int nt;
+
+  ret = 0;
+
+  /*
+   * grow table
+   */
+  if (ptr->rows + n > ptr->capa) {
+    capa = (ptr->capa < 10)? 10: GROW(ptr->capa);
+    if (capa < ptr->rows + n) capa = ptr->rows + n;
+
+    ret = grow_object(ptr, ALIGN_ROWS(capa));
+  }
+
+  /*
+   * copy shared storage
+   */
+  if (!ret) {
+    ret = unshare_object(ptr, !0);
+  }
+
+  /*
+   * copy rows
+   */
+  if (!ret) {
+    arg.ptr    = ptr;
+    arg.src    = src;
+    arg.stride = stride;
+
+    nt = cmat_ctx_threads((long)n * ptr->cols, APPEND_PARALLEL_MIN);
+    cmat_parallel_for(n, nt, append_range, &arg);
+
+    ptr->rows += n;
+  }
+
+  return ret;
+}
+
+/**
+ * 行の追加
+ *
+ * @param ptr   追加対象の行列オブジェクト
+ * @param src   追加する行のデータ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 値テーブルが一定の大きさ(SEG_BYTES)を超えた行列を拡張する場合は
+ *       既存の行を移動せずに新たな領域を継ぎ足す(CMAT_FLAG_SEGMENTED)。
+ *       連続した値テーブルが必要な場合はcmat_compact()を使用すること。
+ */
+int
+cmat_append(cmat_t* ptr, float* src)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (src == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * append row
+   */
+  if (!ret) {
+    ret = append_rows(ptr, src, 1, ptr->cols);
+  }
+
+  return ret;
+}
+
+/**
+ * 複数行の追加
+ *
+ * @param ptr     追加対象の行列オブジェクト
+ * @param src     追加する行のデータ
+ * @param n       追加する行数
+ * @param stride  srcの行の間隔(要素数, 列数以上であること)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 必要な容量を一度に確保し、行のコピーは行数が多い場合は並列に行
+ *       う。容量の拡張についてはcmat_append()と同じ。
+ */
+int
+cmat_append_rows(cmat_t* ptr, float* src, int n, int stride)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (src == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (n < 0 || stride < ptr->cols) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * append rows
+   */
+  if (!ret && n > 0) {
+    ret = append_rows(ptr, src, n, stride);
+  }
+
+  return ret;
+}
+
+/**
+ * 容量の予約
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param rows  確保する行数
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 以降のcmat_append(), cmat_append_rows()でrows行に達するまで領域の
+ *       確保を行わないようにする。容量が既にrows以上の場合は何もしない。
+ *       ビューに対して使用した場合は値をコピーして元の行列から切り離す。
+ */
+int
+cmat_reserve(cmat_t* ptr, int rows)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (rows < 0) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * grow table
+   */
+  if (!ret && rows > ptr->capa) {
+    ret = grow_object(ptr, ALIGN_ROWS(rows));
+  }
+
+  return ret;
+}
+
+/**
+ * 余剰な容量の解放
+ *
+ * @param ptr   対象の行列オブジェクト
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 容量を行数まで切り詰める。セグメント化されている場合は一つの領
+ *       域にまとめ直す(cmat_compact()と同じ)。ビューに対しては何もしな
+ *       い。行の位置が変わるので、ptrから作成したビューは無効になる。
+ */
+int
+cmat_shrink_to_fit(cmat_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release spare rows
+   */
+  if (!ret && !(ptr->flags & CMAT_FLAG_VIEW)) {
+    if (IS_SEGMENTED(ptr) || ptr->capa > ALIGN_ROWS(ptr->rows)) {
+      ret = relocate_object(ptr, ALIGN_ROWS(ptr->rows), !0);
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * 値テーブルの連続化
+ *
+ * @param ptr   対象の行列オブジェクト
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note cmat_append()でセグメント化した行列(CMAT_FLAG_SEGMENTED)の行を
+ *       一つの領域にまとめ直し、容量を行数まで切り詰める。行の位置が変わ
+ *       るので、ptrから作成したビューは無効になる。セグメント化されてい
+ *       ない行列に対しては何もしない。
+ */
+int
+cmat_compact(cmat_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * gather segments
+   */
+  if (!ret && IS_SEGMENTED(ptr)) {
+    ret = relocate_object(ptr, ALIGN_ROWS(ptr->rows), !0);
+  }
+
+  return ret;
+}
+
+/*
+ * 行単位の演算の引数 (calc_add(), calc_sub(), calc_mul(), calc_product())
+ */
+typedef struct {
+  cmat_t* ptr;
+  cmat_t* op;
+  cmat_t* obj;
+  float v;
+  void (*fn2)(float*, float*, float*, int);
+  void (*fn1)(float*, float*, float, int);
+} rows_arg_t;
+
+/* 二項演算 (obj = ptr (+|-) op) */
+static void
+binop_range(void* arg, long i0, long i1)
+{
+  rows_arg_t* a;
+  long r;
+
+  a = (rows_arg_t*)arg;
+
+  for (r = i0; r < i1; r++) {
+    a->fn2(a->obj->row[r], a->ptr->row[r], a->op->row[r],
+           STORE_COLS(a->ptr));
+  }
+}
+
+/* スカラー積 (obj = ptr * v) */
+static void
+scale_range(void* arg, long i0, long i1)
+{
+  rows_arg_t* a;
+  long r;
+
+  a = (rows_arg_t*)arg;
+
+  for (r = i0; r < i1; r++) {
+    a->fn1(a->obj->row[r], a->ptr->row[r], a->v, STORE_COLS(a->ptr));
+  }
+}
+
+/* 行列積 (obj = ptr * op) */
+static void
+product_range(void* arg, long i0, long i1)
+{
+  rows_arg_t* a;
+  long r;
+
+  a = (rows_arg_t*)arg;
+
+  for (r = i0; r < i1; r++) {
+    cmat_kernel->product(a->obj->row[r], a->ptr->row[r], a->op->row,
+                         a->ptr->cols, a->op->cols);
+  }
+}
+
+/*
+ * 要素ごとの和 (obj = ptr + op)
+ *  objはptr, opと同じオブジェクトでもよい。全てが転置ビュー(またはいずれ
+ *  も転置ビューでない)場合は行テーブルの並びのまま処理する。
+ */
+static void
+calc_add(cmat_t* ptr, cmat_t* op, cmat_t* obj)
+{
+  rows_arg_t arg;
+  int nt;
+
+  if (IS_TRANS(ptr) != IS_TRANS(op) || IS_TRANS(ptr) != IS_TRANS(obj)) {
+    calc_elem(ptr, op, 0.0f, obj, ELEM_ADD);
+
+  } else {
+    arg.ptr = ptr;
+    arg.op  = op;
+    arg.obj = obj;
+    arg.fn2 = (IS_STREAMABLE(obj, ptr, op))?
+              cmat_kernel->add_nt: cmat_kernel->add;
+
+    nt = cmat_ctx_threads((long)ptr->rows * ptr->cols, ELEM_PARALLEL_MIN);
+    cmat_parallel_for(STORE_ROWS(ptr), nt, binop_range, &arg);
+  }
+}
+
+/**
+ * 行列の和
+ *  ptr + op → dst       (dst != NULL)
+ *  ptr + op → ptr       (dst == NULL)
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param op    和行列
+ * @param dst   転置結果の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_add(cmat_t* ptr, cmat_t* op, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * check argument
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (ptr->rows != op->rows || ptr->cols != op->cols) ret = CMAT_ERR_SHAPE;
+  }
+
+  /*
+   * select target
+   */
+  if (!ret) {
+    if (dst) {
+      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+    } else {
+      ret = unshare_object(ptr, !0);
+      obj = ptr;
+    }
+  }
+
+  /*
+   * do add operation
+   */
+  if (!ret) {
+    calc_add(ptr, op, obj);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dst) *dst = obj;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (dst && obj) free_object(obj);
+  }
+
+  return ret;
+}
+
+/**
+ * 行列の和(出力先指定)
+ *  ptr + op → dst
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param op    和行列
+ * @param dst   演算結果の格納先(ptrと同じ形状の行列オブジェクト)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note dstにはptr, opと同じオブジェクトを指定してもよい。
+ */
+int
+cmat_add_into(cmat_t* ptr, cmat_t* op, cmat_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * check argument
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) do {
+    if (ptr->rows != op->rows || ptr->cols != op->cols) {
+      ret = CMAT_ERR_SHAPE;
+      break;
+    }
+
+    if (ptr->rows != dst->rows || ptr->cols != dst->cols) {
+      ret = CMAT_ERR_SHAPE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * copy shared storage
+   */
+  if (!ret) {
+    ret = unshare_object(dst, (dst == ptr || dst == op));
+  }
+
+  /*
+   * do add operation
+   */
+  if (!ret) {
+    calc_add(ptr, op, dst);
+  }
+
+  return ret;
+}
+
+/*
+ * 要素ごとの差 (obj = ptr - op)
+ *  objはptr, opと同じオブジェクトでもよい。転置ビューの扱いはcalc_add()と
+ *  同じ。
+ */
+static void
+calc_sub(cmat_t* ptr, cmat_t* op, cmat_t* obj)
+{
+  rows_arg_t arg;
+  int nt;
+
+  if (IS_TRANS(ptr) != IS_TRANS(op) || IS_TRANS(ptr) != IS_TRANS(obj)) {
+    calc_elem(ptr, op, 0.0f, obj, ELEM_SUB);
+
+  } else {
+    arg.ptr = ptr;
+    arg.op  = op;
+    arg.obj = obj;
+    arg.fn2 = (IS_STREAMABLE(obj, ptr, op))?
+              cmat_kernel->sub_nt: cmat_kernel->sub;
+
+    nt = cmat_ctx_threads((long)ptr->rows * ptr->cols, ELEM_PARALLEL_MIN);
+    cmat_parallel_for(STORE_ROWS(ptr), nt, binop_range, &arg);
+  }
+}
+
+/**
+ * 行列の差
+ *  ptr - op → dst       (dst != NULL)
+ *  ptr - op → ptr       (dst == NULL)
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param op    和行列
+ * @param dst   転置結果の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_sub(cmat_t* ptr, cmat_t* op, cmat_t** dst)
+{
+  int ret;
+  cmat_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * check argument
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
 
-    for (i = 0; i < sz; i++) {
-      det *= wr[i][i];
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
     }
   } while (0);
 
-  if (wr) free(wr);
-  if (wt) free(wt);
-  if (!ret) *dst = det;
-
-  return ret;
-}
-
-static void
-calc_inverse(float** src, int n, float** dst)
-{
-  int i;
-  int j;
-  int k;
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (ptr->rows != op->rows || ptr->cols != op->cols) ret = CMAT_ERR_SHAPE;
+  }
 
-  float max;
-  float tmp;
+  /*
+   * select target
+   */
+  if (!ret) {
+    if (dst) {
+      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+    } else {
+      ret = unshare_object(ptr, !0);
+      obj = ptr;
+    }
+  }
 
-  float* si;
-  float* sj;
-  float* di;
-  float* dj;
+  /*
+   * do add operation
+   */
+  if (!ret) {
+    calc_sub(ptr, op, obj);
+  }
 
-  /* create identity matrix */
-  for (i = 0; i < n; i++) {
-#ifdef ENABLE_NEON
-    bzero128(dst[i], sizeof(float) * n);
-#else /* defined(ENABLE_NEON) */
-    memset(dst[i], 0, sizeof(float) * n);
-#endif /* defined(ENABLE_NEON) */
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dst) *dst = obj;
+  }
 
-    dst[i][i] = 1.0;
+  /*
+   * post process
+   */
+  if (ret) {
+    if (dst && obj) free_object(obj);
   }
 
-  /* do row reduction method */
-  for (i = 0; i < n; i++) {
-    si  = src[i];
-    di  = dst[i];
+  return ret;
+}
 
-    max = fabsf(si[i]);
-    k   = i;
+/**
+ * 行列の差(出力先指定)
+ *  ptr - op → dst
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param op    差行列
+ * @param dst   演算結果の格納先(ptrと同じ形状の行列オブジェクト)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note dstにはptr, opと同じオブジェクトを指定してもよい。
+ */
+int
+cmat_sub_into(cmat_t* ptr, cmat_t* op, cmat_t* dst)
+{
+  int ret;
 
-    /* ピボット操作 */
-    // 注目行以降で最大の値（絶対値）の存在する行を探す
-    for (j = i + 1; j < n; j++) {
-      tmp = fabsf(src[j][i]);
+  /*
+   * initialize
+   */
+  ret = 0;
 
-      if (tmp > max) {
-        max = tmp;
-        k   = j;
-      }
+  /*
+   * check argument
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
     }
 
-    // 注目行と最大値のあった行を入れ替える
-    if (i != k) {
-      SWAP(src[i], src[k], float*);
-      SWAP(dst[i], dst[k], float*);
-
-      si = src[i];
-      di = dst[i];
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
     }
 
-    if (si[i] == 0.0) continue;
-
-    /* ここからガウス・ジョルダン法 */
-    tmp = 1.0 / si[i];
-
-    for (j = 0; j < n; j++) {
-      si[j] *= tmp;
-      di[j] *= tmp;
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
     }
+  } while (0);
 
-#pragma omp parallel for private(k,sj,dj,tmp)
-    for (j = 0; j < n; j++) {
-      if (i == j) continue;
-
-      sj  = src[j];
-      dj  = dst[j];
-      tmp = sj[i];
-
-      for (k = 0; k < n; k++) {
-        sj[k] -= si[k] * tmp;
-        dj[k] -= di[k] * tmp;
-      }
+  /*
+   * check shape
+   */
+  if (!ret) do {
+    if (ptr->rows != op->rows || ptr->cols != op->cols) {
+      ret = CMAT_ERR_SHAPE;
+      break;
     }
-  }
-}
 
-static void
-sort(int* a, size_t n)
-{
-  int h;
-  int f;
-  int i;
+    if (ptr->rows != dst->rows || ptr->cols != dst->cols) {
+      ret = CMAT_ERR_SHAPE;
+      break;
+    }
+  } while (0);
 
   /*
-   * sort by ascending order
+   * copy shared storage
    */
+  if (!ret) {
+    ret = unshare_object(dst, (dst == ptr || dst == op));
+  }
 
-  h = n;
+  /*
+   * do sub operation
+   */
+  if (!ret) {
+    calc_sub(ptr, op, dst);
+  }
 
-  do {
-    if (h > 1) {
-      h = SHRINK(h);
-    } else if (!f) {
-      break;
-    }
+  return ret;
+}
 
-    f = 0;
+/*
+ * 要素ごとのスカラー積 (obj = ptr * op)
+ *  objはptrと同じオブジェクトでもよい。転置ビューの扱いはcalc_add()と
+ *  同じ。
+ */
+static void
+calc_mul(cmat_t* ptr, float op, cmat_t* obj)
+{
+  rows_arg_t arg;
+  int nt;
 
-    if (h == 9 || h == 10) h = 11;
+  if (IS_TRANS(ptr) != IS_TRANS(obj)) {
+    calc_elem(ptr, NULL, op, obj, ELEM_MUL);
 
-    for (i = 0; i < ((int)n - h); i++) {
-      if (a[i] > a[i + h]) {
-        SWAP(a[i], a[i + h], int);
-        f = !0;
-      }
-    }
-  } while (1);
+  } else {
+    arg.ptr = ptr;
+    arg.obj = obj;
+    arg.v   = op;
+    arg.fn1 = (IS_STREAMABLE(obj, ptr, ptr))?
+              cmat_kernel->mul_nt: cmat_kernel->mul;
+
+    nt = cmat_ctx_threads((long)ptr->rows * ptr->cols, ELEM_PARALLEL_MIN);
+    cmat_parallel_for(STORE_ROWS(ptr), nt, scale_range, &arg);
+  }
 }
 
 /**
- * 行列オブジェクトの生成
+ * 行列のスカラー積
+ *  ptr * op → dst       (dst != NULL)
+ *  ptr * op → ptr       (dst == NULL)
  *
- * @param n   列数の指定
- * @param dst   生成したオブジェクトの格納先のポインタ
+ * @param ptr   対象の行列オブジェクト
+ * @param op    スカラー値
+ * @param dst   転置結果の格納先
  *
  * @return エラーコード(0で正常終了)
  */
 int
-cmat_new(float* src, int rows, int cols, cmat_t** dst)
+cmat_mul(cmat_t* ptr, float op, cmat_t** dst)
 {
   int ret;
   cmat_t* obj;
-  int i;
 
   /*
    * initialize
@@ -554,90 +3272,80 @@ cmat_new(float* src, int rows, int cols, cmat_t** dst)
   obj = NULL;
 
   /*
-   * argument check
+   * check argument
    */
   do {
-    if (rows < 0) {
-      ret = CMAT_ERR_BSIZE;
-      break;
-    }
-
-    if (cols <= 0) {
-      ret = CMAT_ERR_BSIZE;
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
       break;
     }
 
-    if (dst == NULL) {
-      ret = CMAT_ERR_BADDR;
+    if (isnan(op)) {
+      ret = CMAT_ERR_INVAL;
       break;
     }
-  } while(0);
+  } while (0);
 
   /*
-   * alloc memory
+   * select target
    */
   if (!ret) {
-    ret = alloc_object(rows, cols, NULL, &obj);
+    if (dst) {
+      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+    } else {
+      ret = unshare_object(ptr, !0);
+      obj = ptr;
+    }
   }
 
   /*
-   * set initial values
+   * do add operation
    */
   if (!ret) {
-    if (src) {
-      for (i = 0; i < rows; i++) {
-        memcpy(obj->row[i], src, sizeof(float) * cols);
-        src += cols;
-      }
-    } else {
-#ifdef ENABLE_NEON
-      bzero128(obj->tbl, sizeof(float) * rows * obj->stride);
-#else /* defined(ENABLE_NEON) */
-      memset(obj->tbl, 0, sizeof(float) * rows * obj->stride);
-#endif /* defined(ENABLE_NEON) */
-    }
+    calc_mul(ptr, op, obj);
   }
 
   /*
    * put return parameter
    */
   if (!ret) {
-    *dst = obj;
+    if (dst) *dst = obj;
   }
 
   /*
    * post process
    */
   if (ret) {
-    if (obj) free_object(obj);
+    if (dst && obj) free_object(obj);
   }
 
   return ret;
 }
 
 /**
- * 行列オブジェクトの複製
+ * 行列のスカラー積(出力先指定)
+ *  ptr * op → dst
  *
- * @param ptr   複製元になる行列オブジェクト
- * @param dst   生成したオブジェクトの格納先のポインタ
+ * @param ptr   対象の行列オブジェクト
+ * @param op    スカラー値
+ * @param dst   演算結果の格納先(ptrと同じ形状の行列オブジェクト)
  *
  * @return エラーコード(0で正常終了)
+ *
+ * @note dstにはptrと同じオブジェクトを指定してもよい。
  */
 int
-cmat_clone(cmat_t* ptr, cmat_t** dst)
+cmat_mul_into(cmat_t* ptr, float op, cmat_t* dst)
 {
   int ret;
-  cmat_t* obj;
-  int i;
 
   /*
    * initialize
    */
   ret = 0;
-  obj = NULL;
 
   /*
-   * argument check
+   * check argument
    */
   do {
     if (ptr == NULL) {
@@ -649,172 +3357,196 @@ cmat_clone(cmat_t* ptr, cmat_t** dst)
       ret = CMAT_ERR_BADDR;
       break;
     }
-  } while(0);
+
+    if (isnan(op)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
 
   /*
-   * alloc memory
+   * check shape
    */
   if (!ret) {
-    ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+    if (ptr->rows != dst->rows || ptr->cols != dst->cols) ret = CMAT_ERR_SHAPE;
   }
 
   /*
-   * copy values
+   * copy shared storage
    */
   if (!ret) {
-#ifdef ENABLE_NEON
-    memcpy128(obj->tbl, ptr->tbl, sizeof(float) * ptr->rows * ptr->stride);
-#else /* defined(ENABLE_NEON) */
-    memcpy(obj->tbl, ptr->tbl, sizeof(float) * ptr->rows * ptr->stride);
-#endif /* defined(ENABLE_NEON) */
-
-    for (i = 0; i < ptr->rows; i ++) {
-      obj->row[i] = obj->tbl + (ptr->row[i] - ptr->tbl);
-    }
+    ret = unshare_object(dst, (dst == ptr));
   }
 
   /*
-   * put return parameter
+   * do multiple operation
    */
   if (!ret) {
-    *dst = obj;
+    calc_mul(ptr, op, dst);
   }
 
   return ret;
 }
 
-/**
- * 行列オブジェクトの削除
- *
- * @param dst   削除するオブジェクトのポインタ
- *
- * @return エラーコード(0で正常終了)
+/*
+ * 行列の積 (obj = ptr * op)
+ *  objはptr, opと異なるオブジェクトでなければならない。いずれかが転置ビュー
+ *  の場合はGEMMエンジンで処理する。
  */
-int
-cmat_destroy(cmat_t* ptr)
+static int
+calc_product(cmat_t* ptr, cmat_t* op, cmat_t* obj)
 {
   int ret;
+  rows_arg_t arg;
+  int nt;
 
-  /*
-   * initialize
-   */
   ret = 0;
 
-  /*
-   * argument check
-   */
-  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+  if (IS_TRANS(obj)) {
+    /* obj^T = op^T * ptr^T */
+    ret = cmat_gemm_driver(op->cols, ptr->rows, ptr->cols,
+                           1.0f, op->row, !IS_TRANS(op),
+                           ptr->row, !IS_TRANS(ptr), 0.0f, obj->row);
 
-  /*
-   * release memory
-   */
-  if (!ret) {
-    free_object(ptr);
+  } else if (IS_TRANS(ptr) || IS_TRANS(op)) {
+    /* 転置ビューはGEMMエンジンのパッキングで転置して読み込む */
+    ret = cmat_gemm_driver(ptr->rows, op->cols, ptr->cols,
+                           1.0f, ptr->row, IS_TRANS(ptr) != 0,
+                           op->row, IS_TRANS(op) != 0, 0.0f, obj->row);
+
+  } else if (IS_FIXED_PRODUCT(ptr, op)) {
+    switch (ptr->rows) {
+    case 2:
+      calc_product_dim2(ptr->row, op->row, obj->row);
+      break;
+
+    case 3:
+      calc_product_dim3(ptr->row, op->row, obj->row);
+      break;
+
+    case 4:
+      calc_product_dim4(ptr->row, op->row, obj->row);
+      break;
+    }
+
+  } else if (IS_LARGE_PRODUCT(ptr->rows, op->cols, ptr->cols)) {
+    ret = cmat_gemm_driver(ptr->rows, op->cols, ptr->cols,
+                           1.0f, ptr->row, 0, op->row, 0, 0.0f, obj->row);
+
+  } else {
+    arg.ptr = ptr;
+    arg.op  = op;
+    arg.obj = obj;
+
+    nt = cmat_ctx_threads((long)ptr->rows * ptr->cols * op->cols,
+                          PRODUCT_PARALLEL_MIN);
+    cmat_parallel_for(ptr->rows, nt, product_range, &arg);
   }
 
   return ret;
 }
 
 /**
- * 行列オブジェクトの内容表示
+ * 行列の積
+ *  ptr * op → dst       (dst != NULL)
+ *  ptr * op → ptr       (dst == NULL)
  *
- * @param ptr   対象の行列オブジェクト
+ * @param ptr   転置対象の行列オブジェクト
+ * @param op    積行列
+ * @param dst   演算結果の格納先
  *
  * @return エラーコード(0で正常終了)
  */
 int
-cmat_print(cmat_t* ptr, char* label)
+cmat_product(cmat_t* ptr, cmat_t* op, cmat_t** dst)
 {
   int ret;
-  int r;
-  int c;
-
-  float* rp;   // as "Row Pointer"
-  char fmt[32];
-  char str[32];
-  int len;
-  int max;
-  int i;
+  cmat_t* obj;
 
   /*
    * initialize
    */
   ret = 0;
+  obj = NULL;
 
   /*
    * argument check
    */
-  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
 
   /*
-   * make format string
+   * check op value
    */
   if (!ret) {
-    max = 0;
-
-    for (r = 0; r < ptr->rows; r++) {
-      rp = ptr->row[r];
-
-      for (c = 0; c < ptr->cols; c++) {
-        len = format(rp[c], str, ptr->coff);
-        if (len > max) max = len;
-      }
-    }
-
-    sprintf(fmt, "%%%ds", max);
+    if (ptr->cols != op->rows) ret = CMAT_ERR_SHAPE;
   }
 
   /*
-   * show content
+   * alloc result object
    */
   if (!ret) {
-    if (label != NULL) printf("%s:\n", label);
-
-    for (r = 0; r < ptr->rows; r++) {
-      rp = ptr->row[r];
-
-      if (label != NULL) printf("  ");
-      printf("[");
+    ret = alloc_object(ptr->rows, op->cols, ptr, &obj);
+  }
 
-      for (c = 0; c < ptr->cols; c++) {
-        format(rp[c], str, ptr->coff);
-        printf(fmt, str);
-        if (c < (ptr->cols - 1)) printf(" ");
-      }
+  /*
+   * do multiple operation
+   */
+  if (!ret) {
+    ret = calc_product(ptr, op, obj);
+  }
 
-      printf(" ]\n");
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (dst) {
+      *dst = obj;
+    } else {
+      replace_object(ptr, &obj);
     }
   }
 
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj) free_object(obj);
+  }
+
   return ret;
 }
 
 /**
- * 行の追加
+ * 行列の積(出力先指定)
+ *  ptr * op → dst
  *
- * @param ptr   追加対象の行列オブジェクト
- * @param src   追加する行のデータ
+ * @param ptr   対象の行列オブジェクト
+ * @param op    積行列
+ * @param dst   演算結果の格納先(ptr->rows x op->colsの行列オブジェクト)
  *
  * @return エラーコード(0で正常終了)
+ *
+ * @note dstにptr, opと同じオブジェクトを指定することはできない。
  */
 int
-cmat_append(cmat_t* ptr, float* src)
+cmat_product_into(cmat_t* ptr, cmat_t* op, cmat_t* dst)
 {
   int ret;
-  float* tbl;
-  float** row;
-  int capa;
-  int i;
-#ifdef ENABLE_NEON
-  int j;
-#endif /* defined(ENABLE_NEON) */
 
   /*
    * initialize
    */
   ret = 0;
-  tbl = NULL;
-  row = NULL;
 
   /*
    * argument check
@@ -825,565 +3557,590 @@ cmat_append(cmat_t* ptr, float* src)
       break;
     }
 
-    if (src == NULL) {
+    if (op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
       ret = CMAT_ERR_BADDR;
       break;
     }
+
+    if (dst == ptr || dst == op) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
   } while (0);
 
   /*
-   * grow table 
+   * check shape
    */
   if (!ret) do {
-    if (ptr->capa == ptr->rows) {
-      capa = (ptr->capa < 10)? 10: GROW(ptr->capa);
-      capa = ALIGN_ROWS(capa);
-
-      tbl  = (float*)realloc(ptr->tbl, sizeof(float) * capa * ptr->stride);
-      if (tbl == NULL) {
-        ret = CMAT_ERR_NOMEM;
-        break;
-      }
-
-      /* LU分解などで置換が発生している可能性がある。このため既存の行配置
-         を再現する必要がある（==既存の行テーブルを参照する必要がある）の
-         でrealloc()は使わない */
-      row  = (float**)malloc(sizeof(float*) * capa);
-      if (row == NULL) {
-        ret = CMAT_ERR_NOMEM;
-        break;
-      }
-
-      if (ptr->row) {
-        /* 既存の行構成を再現する（他の演算でピボット操作で行位置が交換さ
-           れている場合がある） */
-        for (i = 0; i < ptr->capa; i++) {
-          row[i] = tbl + (ptr->row[i] - ptr->tbl);
-        }
-
-        /* 既存の行テーブルは不要になったので解放 */
-        free(ptr->row);
-
-      } else {
-        ptr->capa = 0;
-      }
-
-      /* 新規の部分の行構成を設定 */
-      for (i = ptr->capa; i < capa; i++) {
-        row[i] = tbl + (i * ptr->stride);
-      }
+    if (ptr->cols != op->rows) {
+      ret = CMAT_ERR_SHAPE;
+      break;
+    }
 
-      /* コンテキストの更新 */
-      ptr->tbl  = tbl;
-      ptr->row  = row;
-      ptr->capa = capa;
+    if (dst->rows != ptr->rows || dst->cols != op->cols) {
+      ret = CMAT_ERR_SHAPE;
+      break;
     }
   } while (0);
 
   /*
-   * update context
+   * copy shared storage
    */
   if (!ret) {
-    memcpy(ptr->row[ptr->rows], src, sizeof(float) * ptr->cols);
-#ifdef ENABLE_NEON
-    for (j = ptr->cols; j < ptr->stride; j++) ptr->row[ptr->rows][j] = 0.0f;
-#endif /* defined(ENABLE_NEON) */
-
-    ptr->rows++;
+    ret = unshare_object(dst, 0);
   }
 
   /*
-   * post process
+   * do multiple operation
    */
-  if (ret) {
-    if (tbl) free(tbl);
-    if (row) free(row);
+  if (!ret) {
+    ret = calc_product(ptr, op, dst);
   }
 
   return ret;
 }
 
 /**
- * 行列の和
- *  ptr + op → dst       (dst != NULL)
- *  ptr + op → ptr       (dst == NULL)
+ * 行列の積和
+ *  alpha * op(a) * op(b) + beta * c → c
  *
- * @param ptr   対象の行列オブジェクト
- * @param op    和行列
- * @param dst   転置結果の格納先
+ * @param ta    aの扱い(CMAT_NOTRANS: op(a) = a, CMAT_TRANS: op(a) = a^T)
+ * @param tb    bの扱い(CMAT_NOTRANS: op(b) = b, CMAT_TRANS: op(b) = b^T)
+ * @param alpha op(a) * op(b)に乗じる係数
+ * @param a     積の左側の行列オブジェクト
+ * @param b     積の右側の行列オブジェクト
+ * @param beta  cに乗じる係数
+ * @param c     加算対象(兼 演算結果の格納先)の行列オブジェクト
  *
  * @return エラーコード(0で正常終了)
+ *
+ * @note 結果は中間行列を生成せずにcに直接累積する。cがaまたはbと同じオブ
+ *       ジェクトの場合は、そのオペランドのみ作業領域に複写してから演算を
+ *       行う。
  */
 int
-cmat_add(cmat_t* ptr, cmat_t* op, cmat_t** dst)
+cmat_gemm(int ta, int tb, float alpha, cmat_t* a, cmat_t* b,
+          float beta, cmat_t* c)
 {
   int ret;
-  cmat_t* obj;
-  int r;
-  int c;
-
-  float* s;
-  float* o;
-  float* d;
+  int m;
+  int n;
+  int k;
+  int kb;
 
-#ifdef ENABLE_NEON
-  float32x4_t vs;
-  float32x4_t vo;
-  float32x4_t vd;
-#endif /* defined(ENABLE_NEON) */
+  float* at;   // as "A Table"
+  float** ar;  // as "A Rows"
+  float* bt;   // as "B Table"
+  float** br;  // as "B Rows"
 
   /*
    * initialize
    */
   ret = 0;
-  obj = NULL;
+  at  = NULL;
+  ar  = NULL;
+  bt  = NULL;
+  br  = NULL;
 
   /*
-   * check argument
+   * argument check
    */
   do {
-    if (ptr == NULL) {
+    if (a == NULL) {
       ret = CMAT_ERR_BADDR;
       break;
     }
 
-    if (op == NULL) {
+    if (b == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (c == NULL) {
       ret = CMAT_ERR_BADDR;
       break;
     }
+
+    if (ta != CMAT_NOTRANS && ta != CMAT_TRANS) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    if (tb != CMAT_NOTRANS && tb != CMAT_TRANS) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    if (isnan(alpha) || isnan(beta)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
   } while (0);
 
   /*
    * check shape
    */
   if (!ret) {
-    if (ptr->rows != op->rows || ptr->cols != op->cols) ret = CMAT_ERR_SHAPE;
+    m  = (ta)? a->cols: a->rows;
+    k  = (ta)? a->rows: a->cols;
+    kb = (tb)? b->cols: b->rows;
+    n  = (tb)? b->rows: b->cols;
+
+    if (k != kb || c->rows != m || c->cols != n) ret = CMAT_ERR_SHAPE;
   }
 
   /*
-   * select target
+   * copy shared storage
    */
   if (!ret) {
-    if (dst) {
-      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
-    } else {
-      obj = ptr;
-    }
+    ret = unshare_object(c, (beta != 0.0f || a == c || b == c));
   }
 
   /*
-   * do add operation
+   * copy operands overlapping with the destination
    */
   if (!ret) {
-#ifdef ENABLE_NEON
-#pragma omp parallel for private(s,o,d,c,vs,vo,vd)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      o = op->row[r];
-      d = obj->row[r];
-
-      for (c = 0; c < ptr->cols; c += 4) {
-        vs = vld1q_f32(s);
-        vo = vld1q_f32(o);
-        vd = vaddq_f32(vs, vo);
-
-        vst1q_f32(d, vd);
-
-        s += 4;
-        o += 4;
-        d += 4;
-      }
+    if (a == c) {
+      ret = alloc_table(a->row, STORE_ROWS(a), STORE_COLS(a), &at, &ar);
+    } else {
+      ar = a->row;
     }
-#else /* defined(ENABLE_NEON) */
-#pragma omp parallel for private(s,o,d,c)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      o = op->row[r];
-      d = obj->row[r];
+  }
 
-      for (c = 0; c < ptr->stride; c++) {
-        d[c] = s[c] + o[c];
-      }
+  if (!ret) {
+    if (b == c) {
+      ret = alloc_table(b->row, STORE_ROWS(b), STORE_COLS(b), &bt, &br);
+    } else {
+      br = b->row;
     }
-#endif /* defined(ENABLE_NEON) */
   }
 
   /*
-   * put return parameter
+   * do multiply-accumulate operation
    */
   if (!ret) {
-    if (dst) *dst = obj;
+    /* 転置ビューは行テーブルを転置の指定を反転して渡す */
+    if (IS_TRANS(a)) ta = !ta;
+    if (IS_TRANS(b)) tb = !tb;
+
+    if (IS_TRANS(c)) {
+      /* c^T = alpha * op(b)^T * op(a)^T + beta * c^T */
+      ret = cmat_gemm_driver(n, m, k, alpha, br, !tb, ar, !ta, beta, c->row);
+    } else {
+      ret = cmat_gemm_driver(m, n, k, alpha, ar, ta, br, tb, beta, c->row);
+    }
   }
 
   /*
    * post process
    */
-  if (ret) {
-    if (dst && obj) free_object(obj);
+  if (at) {
+    free(at);
+    free(ar);
+  }
+
+  if (bt) {
+    free(bt);
+    free(br);
   }
 
   return ret;
 }
 
-/**
- * 行列の差
- *  ptr - op → dst       (dst != NULL)
- *  ptr - op → ptr       (dst == NULL)
- *
- * @param ptr   対象の行列オブジェクト
- * @param op    和行列
- * @param dst   転置結果の格納先
- *
- * @return エラーコード(0で正常終了)
+/*
+ * 部分行列の転置
+ *  d[j][dc + i] = s[i][sc + j]  (i = 0..h, j = 0..w)
+ *  カーネルのタイル単位で処理し、端数は要素単位で処理する。
  */
-int
-cmat_sub(cmat_t* ptr, cmat_t* op, cmat_t** dst)
+static void
+transpose_block(float** d, int dc, float** s, int sc, int h, int w)
 {
-  int ret;
+  int tw;
+  int i;
+  int j;
+  int k;
+
+  tw = cmat_kernel->tw;
+
+  for (i = 0; i + tw <= h; i += tw) {
+    for (j = 0; j + tw <= w; j += tw) {
+      cmat_kernel->transpose(d + j, dc + i, s + i, sc + j);
+    }
+
+    for (; j < w; j++) {
+      for (k = i; k < i + tw; k++) d[j][dc + k] = s[k][sc + j];
+    }
+  }
+
+  for (; i < h; i++) {
+    for (j = 0; j < w; j++) d[j][dc + i] = s[i][sc + j];
+  }
+}
+
+typedef struct {
+  cmat_t* ptr;
   cmat_t* obj;
-  int r;
-  int c;
+  float** row;
+  int n;
+} trans_arg_t;
 
-  float* s;
-  float* o;
-  float* d;
+/* タイル行[i0, i1)の転置 */
+static void
+trans_range(void* arg, long i0, long i1)
+{
+  trans_arg_t* a;
+  long t;
+  int r0;
+  int c0;
+  int h;
+  int w;
 
-#ifdef ENABLE_NEON
-  float32x4_t vs;
-  float32x4_t vo;
-  float32x4_t vd;
-#endif /* defined(ENABLE_NEON) */
+  a = (trans_arg_t*)arg;
 
-  /*
-   * initialize
-   */
-  ret = 0;
-  obj = NULL;
+  for (t = i0; t < i1; t++) {
+    r0 = (int)t * TRANSPOSE_TILE;
+    h  = a->ptr->rows - r0;
+    if (h > TRANSPOSE_TILE) h = TRANSPOSE_TILE;
 
-  /*
-   * check argument
-   */
-  do {
-    if (ptr == NULL) {
-      ret = CMAT_ERR_BADDR;
-      break;
+    for (c0 = 0; c0 < a->ptr->cols; c0 += TRANSPOSE_TILE) {
+      w = a->ptr->cols - c0;
+      if (w > TRANSPOSE_TILE) w = TRANSPOSE_TILE;
+
+      transpose_block(a->obj->row + c0, r0, a->ptr->row + r0, c0, h, w);
+    }
+  }
+}
+
+/*
+ * 転置 (obj = ptr^T)
+ *  objはptrと異なるオブジェクトでなければならない。書き込みが行方向に飛
+ *  ばないように、TRANSPOSE_TILE四方のタイル単位で処理する。
+ */
+static void
+calc_transpose(cmat_t* ptr, cmat_t* obj)
+{
+  trans_arg_t arg;
+  int r;
+  int c;
+  int nt;
+
+  if (IS_TRANS(ptr) && !IS_TRANS(obj)) {
+    /* 転置ビューの転置は元の行列の行の並びそのもの */
+    for (r = 0; r < obj->rows; r++) {
+      memcpy(obj->row[r], ptr->row[r], sizeof(float) * obj->cols);
+    }
+
+  } else if (IS_TRANS(ptr) || IS_TRANS(obj)) {
+    for (r = 0; r < ptr->rows; r++) {
+      for (c = 0; c < ptr->cols; c++) {
+        ELEM(obj, c, r) = ELEM(ptr, r, c);
+      }
     }
 
-    if (op == NULL) {
-      ret = CMAT_ERR_BADDR;
-      break;
-    }
-  } while (0);
+  } else {
+    arg.ptr = ptr;
+    arg.obj = obj;
 
-  /*
-   * check shape
-   */
-  if (!ret) {
-    if (ptr->rows != op->rows || ptr->cols != op->cols) ret = CMAT_ERR_SHAPE;
+    nt = cmat_ctx_threads((long)ptr->rows * ptr->cols, TRANSPOSE_PAR_MIN);
+    cmat_parallel_for((ptr->rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE, nt,
+                      trans_range, &arg);
   }
+}
 
-  /*
-   * select target
-   */
-  if (!ret) {
-    if (dst) {
-      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
-    } else {
-      obj = ptr;
-    }
+/*
+ * タイル行[i0, i1)について対角を挟んだタイルの組を入れ替える
+ */
+static void
+trans_square_range(void* arg, long i0, long i1)
+{
+  trans_arg_t* a;
+  float tmp[TRANSPOSE_TILE * TRANSPOSE_TILE];
+  float* tr[TRANSPOSE_TILE];
+  float** row;
+  long t;
+  int n;
+  int r0;
+  int c0;
+  int h;
+  int w;
+  int i;
+
+  a   = (trans_arg_t*)arg;
+  row = a->row;
+  n   = a->n;
+
+  for (i = 0; i < TRANSPOSE_TILE; i++) {
+    tr[i] = tmp + (i * TRANSPOSE_TILE);
   }
 
-  /*
-   * do add operation
-   */
-  if (!ret) {
-#ifdef ENABLE_NEON
-#pragma omp parallel for private(s,o,d,c,vs,vo,vd)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      o = op->row[r];
-      d = obj->row[r];
+  for (t = i0; t < i1; t++) {
+    r0 = (int)t * TRANSPOSE_TILE;
+    h  = n - r0;
+    if (h > TRANSPOSE_TILE) h = TRANSPOSE_TILE;
 
-      for (c = 0; c < ptr->cols; c += 4) {
-        vs = vld1q_f32(s);
-        vo = vld1q_f32(o);
-        vd = vsubq_f32(vs, vo);
+    for (c0 = r0; c0 < n; c0 += TRANSPOSE_TILE) {
+      w = n - c0;
+      if (w > TRANSPOSE_TILE) w = TRANSPOSE_TILE;
 
-        vst1q_f32(d, vd);
+      /* tmp = A^T  (A: row[r0..][c0..], B: row[c0..][r0..]) */
+      transpose_block(tr, 0, row + r0, c0, h, w);
 
-        s += 4;
-        o += 4;
-        d += 4;
-      }
-    }
-#else /* defined(ENABLE_NEON) */
-#pragma omp parallel for private(s,o,d,c)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      o = op->row[r];
-      d = obj->row[r];
+      /* A = B^T (対角のタイルではAとBは同じ) */
+      if (c0 != r0) transpose_block(row + r0, c0, row + c0, r0, w, h);
 
-      for (c = 0; c < ptr->cols; c++) {
-        d[c] = s[c] - o[c];
+      /* B = tmp */
+      for (i = 0; i < w; i++) {
+        memcpy(row[c0 + i] + r0, tr[i], sizeof(float) * h);
       }
     }
-#endif /* defined(ENABLE_NEON) */
   }
+}
 
-  /*
-   * put return parameter
-   */
-  if (!ret) {
-    if (dst) *dst = obj;
-  }
+/*
+ * 正方行列のその場での転置
+ *  対角を挟んだタイルの組を作業領域経由で入れ替える。組の一方の転置を作業
+ *  領域に取り、もう一方を転置して書き込んだ後に作業領域を書き戻す。
+ */
+static void
+transpose_square(float** row, int n)
+{
+  trans_arg_t arg;
+  int nt;
 
-  /*
-   * post process
-   */
-  if (ret) {
-    if (dst && obj) free_object(obj);
-  }
+  arg.row = row;
+  arg.n   = n;
 
-  return ret;
+  nt = cmat_ctx_threads((long)n * n, TRANSPOSE_PAR_MIN);
+
+  cmat_parallel_for((n + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE, nt,
+                    trans_square_range, &arg);
 }
 
-/**
- * 行列のスカラー積
- *  ptr * op → dst       (dst != NULL)
- *  ptr * op → ptr       (dst == NULL)
- *
- * @param ptr   対象の行列オブジェクト
- * @param op    スカラー値
- * @param dst   転置結果の格納先
- *
- * @return エラーコード(0で正常終了)
+/*
+ * 矩形行列のその場での転置が可能かの判定
+ *  行が格納領域に順に並んでいて(行の入れ替えを行っていない)、転置後の行
+ *  テーブルと値テーブルが現在の行テーブルの先頭からの領域に収まる場合に
+ *  限る。
  */
-int
-cmat_mul(cmat_t* ptr, float op, cmat_t** dst)
+static int
+is_transposable(cmat_t* ptr)
 {
   int ret;
-  cmat_t* obj;
-  int r;
-  int c;
-
-  float* s;
-  float* d;
-
-#ifdef ENABLE_NEON
-  float32x4_t vs;
-  float32x4_t vo;
-  float32x4_t vd;
-#endif /* defined(ENABLE_NEON) */
+  int stride;
+  size_t size;
+  int i;
 
-  /*
-   * initialize
-   */
-  ret = 0;
-  obj = NULL;
+  ret = !0;
 
-  /*
-   * check argument
-   */
   do {
-    if (ptr == NULL) {
-      ret = CMAT_ERR_BADDR;
+    if ((ptr->flags & (CMAT_FLAG_VIEW | CMAT_FLAG_TRANS |
+                       CMAT_FLAG_SEGMENTED)) || IS_SHARED(ptr)) {
+      ret = 0;
       break;
     }
 
-    if (isnan(op)) {
-      ret = CMAT_ERR_INVAL;
+    if ((char*)ptr->tbl != (char*)ptr->row + ROWS_SIZE(ptr->capa)) {
+      ret = 0;
       break;
     }
+
+    stride = ALIGN_COLS(ptr->rows);
+    size   = ROWS_SIZE(ptr->capa) +
+             (sizeof(float) * ptr->capa * ptr->stride);
+
+    if (ROWS_SIZE(ptr->cols) + (sizeof(float) * ptr->cols * stride) > size) {
+      ret = 0;
+      break;
+    }
+
+    for (i = 0; i < ptr->rows; i++) {
+      if (ptr->row[i] != ptr->tbl + ((size_t)i * ptr->stride)) {
+        ret = 0;
+        break;
+      }
+    }
   } while (0);
 
+  return ret;
+}
+
+/*
+ * 矩形行列のその場での転置
+ *  値を詰めて並べ直した上で置換の巡回を辿って並べ替え、転置後のストライ
+ *  ドで配置し直す。作業領域は巡回済みの位置を記録するビット列のみ。
+ *  is_transposable()で可能であることを確認してから呼び出すこと。
+ */
+static int
+transpose_rect(cmat_t* ptr)
+{
+  int ret;
+  unsigned char* done;
+  size_t size;
+  float* tbl;
+  float* t;
+  float v;
+  float w;
+  long n;
+  long k;
+  long p;
+  int rows;
+  int cols;
+  int stride;
+  int capa;
+  int i;
+
   /*
-   * select target
+   * initialize
    */
-  if (!ret) {
-    if (dst) {
-      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
-    } else {
-      obj = ptr;
-    }
-  }
+  ret    = 0;
+  rows   = ptr->cols;
+  cols   = ptr->rows;
+  n      = (long)rows * cols;
+  tbl    = ptr->tbl;
 
   /*
-   * do add operation
+   * alloc visited bitmap
    */
+  done = (unsigned char*)calloc((n + 7) / 8, 1);
+  if (done == NULL) ret = CMAT_ERR_NOMEM;
+
   if (!ret) {
-#ifdef ENABLE_NEON
-    vo = vmovq_n_f32(op);
+    /*
+     * pack rows (stride → cols)
+     */
+    for (i = 1; i < cols; i++) {
+      memmove(tbl + ((long)i * rows), ptr->row[i], sizeof(float) * rows);
+    }
 
-#pragma omp parallel for private(s,d,c,vs,vd)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      d = obj->row[r];
+    /*
+     * follow permutation cycles (k = i * rows + j → j * cols + i)
+     */
+    for (k = 1; k < n - 1; k++) {
+      if (done[k >> 3] & (1 << (k & 7))) continue;
+
+      v = tbl[k];
+      p = k;
+
+      do {
+        p = ((p % rows) * cols) + (p / rows);
+        w = tbl[p];
+        tbl[p] = v;
+        v = w;
+        done[p >> 3] |= (1 << (p & 7));
+      } while (p != k);
+    }
 
-      for (c = 0; c < ptr->cols; c += 4) {
-        vs = vld1q_f32(s);
-        vd = vmulq_f32(vs, vo);
+    /*
+     * relayout with new stride (rows and capacity are recalculated in the
+     * same memory region)
+     */
+    size   = ROWS_SIZE(ptr->capa) +
+             (sizeof(float) * ptr->capa * ptr->stride);
+    stride = ALIGN_COLS(cols);
 
-        vst1q_f32(d, vd);
+    capa   = size / (sizeof(float*) + (sizeof(float) * stride));
+    while (ROWS_SIZE(capa) + (sizeof(float) * capa * stride) > size) capa--;
 
-        s += 4;
-        d += 4;
-      }
-    }
-#else /* defined(ENABLE_NEON) */
-#pragma omp parallel for private(s,d,c)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      d = obj->row[r];
+    t = (float*)((char*)ptr->row + ROWS_SIZE(capa));
+    memmove(t, tbl, sizeof(float) * n);
 
-      for (c = 0; c < ptr->cols; c++) {
-        d[c] = s[c] * op;
-      }
+    for (i = rows - 1; i > 0; i--) {
+      memmove(t + ((long)i * stride), t + ((long)i * cols),
+              sizeof(float) * cols);
     }
-#endif /* defined(ENABLE_NEON) */
-  }
 
-  /*
-   * put return parameter
-   */
-  if (!ret) {
-    if (dst) *dst = obj;
+    layout_storage(ptr->row, capa, stride, &ptr->row, &ptr->tbl);
+
+    ptr->rows   = rows;
+    ptr->cols   = cols;
+    ptr->stride = stride;
+    ptr->capa   = capa;
+
+    if (stride % cmat_kernel->width == 0) {
+      ptr->flags |= CMAT_FLAG_ALIGNED;
+    } else {
+      ptr->flags &= ~CMAT_FLAG_ALIGNED;
+    }
   }
 
   /*
    * post process
    */
-  if (ret) {
-    if (dst && obj) free_object(obj);
-  }
+  if (done) free(done);
 
   return ret;
 }
 
 /**
- * 行列の積
- *  ptr * op → dst       (dst != NULL)
- *  ptr * op → ptr       (dst == NULL)
+ * 行列の転置
+ *  transpose(ptr) → dst       (dst != NULL)
+ *  transpose(ptr) → ptr       (dst == NULL)
  *
  * @param ptr   転置対象の行列オブジェクト
- * @param op    積行列
- * @param dst   演算結果の格納先
+ * @param dst   転置結果の格納先
  *
  * @return エラーコード(0で正常終了)
+ *
+ * @note dstにNULLを指定した場合、正方行列(ビューを含む)は新たな領域を確保
+ *       せずにその場で転置する。矩形行列は転置後の形状が現在の領域に収ま
+ *       る場合に限りその場で転置し、収まらない場合は新たな領域を確保する。
  */
 int
-cmat_product(cmat_t* ptr, cmat_t* op, cmat_t** dst)
+cmat_transpose(cmat_t* ptr, cmat_t** dst)
 {
   int ret;
   cmat_t* obj;
-  int r;
-  int c;
-  int i;
-
-#ifdef ENABLE_NEON
-  float** s;
-  float** o;
-  float** d;
-
-  float32x4_t vs;
-  float32x4_t vo;
-  float32x4_t vd;
-#else /* defined(ENABLE_NEON) */
-  float* s;
-  float* d;
-#endif /* defined(ENABLE_NEON) */
+  int inp;
 
   /*
    * initialize
    */
   ret = 0;
   obj = NULL;
+  inp = 0;
 
   /*
    * argument check
    */
-  do {
-    if (ptr == NULL) {
-      ret = CMAT_ERR_BADDR;
-      break;
-    }
-
-    if (op == NULL) {
-      ret = CMAT_ERR_BADDR;
-      break;
-    }
-  } while (0);
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
 
   /*
-   * check op value
+   * transpose in place
    */
-  if (!ret) {
-    if (ptr->cols != op->rows) ret = CMAT_ERR_SHAPE;
+  if (!ret && dst == NULL && !IS_SHARED(ptr)) {
+    if (ptr->rows == ptr->cols) {
+      transpose_square(ptr->row, ptr->rows);
+      inp = !0;
+
+    } else if (is_transposable(ptr)) {
+      ret = transpose_rect(ptr);
+      inp = !0;
+    }
   }
 
   /*
    * alloc result object
    */
-  if (!ret) {
-    ret = alloc_object(ptr->rows, op->cols, ptr, &obj);
+  if (!ret && !inp) {
+    ret = alloc_object(ptr->cols, ptr->rows, ptr, &obj);
   }
 
   /*
-   * do multiple operation
+   * do transpose operation
    */
-  if (!ret) {
-#ifdef ENABLE_NEON
-    s = ptr->row;
-    o = op->row;
-    d = obj->row;
-
-#pragma omp parallel for private(c,i,vs,vo,vd)
-    for (r = 0; r < ptr->rows; r += 4) {
-      for (c = 0; c < op->cols; c++) {
-        // set 0 to destination
-        vd = vmovq_n_f32(0.0f);
-
-        for (i = 0; i < ptr->cols; i++) {
-          // load sources
-          vs = vsetq_lane_f32(s[r+0][i], vs, 0);
-          vs = vsetq_lane_f32(s[r+1][i], vs, 1);
-          vs = vsetq_lane_f32(s[r+2][i], vs, 2);
-          vs = vsetq_lane_f32(s[r+3][i], vs, 3);
-
-          // load operands
-          vo = vmovq_n_f32(o[i][c]);
-
-          // do product-sum
-          vd = vmlaq_f32(vd, vs, vo);
-        }
-
-        // store destination
-        d[r+0][c] = vgetq_lane_f32(vd, 0);
-        d[r+1][c] = vgetq_lane_f32(vd, 1);
-        d[r+2][c] = vgetq_lane_f32(vd, 2);
-        d[r+3][c] = vgetq_lane_f32(vd, 3);
-      }
-    }
-#else /* defined(ENABLE_NEON) */
-#pragma omp parallel for private(c,i)
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
-      d = obj->row[r];
-
-      for (c = 0; c < op->cols; c++) {
-        d[c] = 0.0;
-
-        for (i = 0; i < ptr->cols; i++) {
-          d[c] += s[i] * op->row[i][c];
-        }
-      }
-    }
-#endif /* defined(ENABLE_NEON) */
+  if (!ret && !inp) {
+    calc_transpose(ptr, obj);
   }
 
   /*
    * put return parameter
    */
-  if (!ret) {
+  if (!ret && !inp) {
     if (dst) {
       *dst = obj;
     } else {
@@ -1395,111 +4152,98 @@ cmat_product(cmat_t* ptr, cmat_t* op, cmat_t** dst)
    * post process
    */
   if (ret) {
-    if (obj) free_object(obj);
+    if (obj) cmat_destroy(obj);
   }
 
   return ret;
 }
 
 /**
- * 行列の転置
- *  transpose(ptr) → dst       (dst != NULL)
- *  transpose(ptr) → ptr       (dst == NULL)
+ * 行列の転置(出力先指定)
+ *  transpose(ptr) → dst
  *
  * @param ptr   転置対象の行列オブジェクト
- * @param dst   転置結果の格納先
+ * @param dst   転置結果の格納先(ptr->cols x ptr->rowsの行列オブジェクト)
  *
  * @return エラーコード(0で正常終了)
+ *
+ * @note dstにptrと同じオブジェクトを指定することはできない。
  */
 int
-cmat_transpose(cmat_t* ptr, cmat_t** dst)
+cmat_transpose_into(cmat_t* ptr, cmat_t* dst)
 {
   int ret;
-  cmat_t* obj;
-  int r;
-  int c;
-
-  float* s;
 
   /*
    * initialize
    */
   ret = 0;
-  obj = NULL;
 
   /*
    * argument check
    */
-  if (ptr == NULL) ret = CMAT_ERR_BADDR;
-
-  /*
-   * alloc result object
-   */
-  if (!ret) {
-    ret = alloc_object(ptr->cols, ptr->rows, ptr, &obj);
-  }
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
 
-  /*
-   * do transpose operation
-   */
-  if (!ret) {
-    for (r = 0; r < ptr->rows; r++) {
-      s = ptr->row[r];
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
 
-      for (c = 0; c < ptr->cols; c++) {
-        obj->row[c][r] = s[c];
-      }
+    if (dst == ptr) {
+      ret = CMAT_ERR_INVAL;
+      break;
     }
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (dst->rows != ptr->cols || dst->cols != ptr->rows) ret = CMAT_ERR_SHAPE;
   }
 
   /*
-   * put return parameter
+   * copy shared storage
    */
   if (!ret) {
-    if (dst) {
-      *dst = obj;
-    } else {
-      replace_object(ptr, &obj);
-    }
+    ret = unshare_object(dst, 0);
   }
 
   /*
-   * post process
+   * do transpose operation
    */
-  if (ret) {
-    if (obj) cmat_destroy(obj);
+  if (!ret) {
+    calc_transpose(ptr, dst);
   }
 
   return ret;
 }
 
-/**
+/*
  * 逆行列の算出
- *  inverse(ptr) → dst       (dst != NULL)
- *  inverse(ptr) → ptr       (dst == NULL)
- *
- * @param ptr   対象の行列オブジェクト
- * @param dst   逆行列の格納先
- *
- * @return エラーコード(0で正常終了)
- *
- * @refer http://thira.plavox.info/blog/2008/06/_c.html
- *        http://www.yamamo10.jp/yamamoto/lecture/2006/5E/
- *                      Linear_eauations/gaussj_html/node2.html
+ *  outを指定した場合はoutに、dstを指定した場合は新規に確保したオブジェ
+ *  クトに、いずれも指定しない場合はptrに結果を書き込む。
  */
-int
-cmat_inverse(cmat_t* ptr, cmat_t** dst)
+static int
+inverse_object(cmat_t* ptr, cmat_t* out, cmat_t** dst)
 {
   int ret;
   cmat_t* obj;
 
   float det;
+  int* piv;
+  int swp;
+  int fix;
   int i;
 
-  float* st;   // as "Source Table"
-  float** sr;  // as "Source Row"
+  float ft[16];  // as "Fixed-size Table"
 
-  float* dt;   // as "Destination Table"
+  float* wt;   // as "Work Table"
+  float** wr;  // as "Work Rows"
   float** dr;  // as "destination Row"
 
   /*
@@ -1507,58 +4251,91 @@ cmat_inverse(cmat_t* ptr, cmat_t** dst)
    */
   ret = 0;
   obj = NULL;
-  st  = NULL;
-  sr  = NULL;
-  dt  = NULL;
+  piv = NULL;
+  wt  = NULL;
+  wr  = NULL;
   dr  = NULL;
 
   /*
    * argument check
    */
-  if (ptr == NULL) ret = CMAT_ERR_BADDR;
-  
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (IS_TRANS(ptr) || (out && IS_TRANS(out))) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
   /*
-   * check if it's a regular matrix
+   * check shape
    */
   if (!ret) {
-    ret = cmat_det(ptr, &det);
+    if (ptr->rows != ptr->cols) ret = CMAT_ERR_SHAPE;
   }
 
   if (!ret) {
-    if (fabsf(det) < ptr->coff) ret = CMAT_ERR_NREGL;
+    fix = (ptr->rows <= 4);
   }
 
   /*
-   * alloc work(or output) memory
+   * alloc work memory
    */
-  if (!ret) {
-    ret = alloc_table(NULL, ptr->capa, ptr->cols, &st, &sr);
+  if (!ret && !fix) {
+    ret = alloc_table(ptr->row, ptr->rows, ptr->cols, &wt, &wr);
+  }
+
+  if (!ret && !fix) {
+    piv = (int*)malloc(sizeof(int) * ptr->rows);
+    if (piv == NULL) ret = CMAT_ERR_NOMEM;
   }
 
   /*
-   * alloc result object
+   * do LU decomposition (or calculate inverse of small matrix)
    */
   if (!ret) {
-    if (dst) {
-      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+    if (fix) {
+      det = calc_inverse_fixed(ptr->row, ptr->rows, ft);
+
+    } else {
+      ret = lu_decomp(wr, ptr->rows, ptr->coff, piv, &swp);
       if (!ret) {
+        det = (swp & 1)? -1.0: 1.0;
+
         for (i = 0; i < ptr->rows; i++) {
-#ifdef ENABLE_NEON
-          memcpy128(sr[i], ptr->row[i], sizeof(float) * ptr->cols);
-#else /* defined(ENABLE_NEON) */
-          memcpy(sr[i], ptr->row[i], sizeof(float) * ptr->cols);
-#endif /* defined(ENABLE_NEON) */
+          det *= wr[i][i];
         }
-
-        dt = obj->tbl;
-        dr = obj->row;
       }
+    }
+  }
+
+  /*
+   * check if it's a regular matrix
+   */
+  if (!ret) {
+    if (fabsf(det) < ptr->coff) ret = CMAT_ERR_NREGL;
+  }
+
+  /*
+   * alloc result object
+   */
+  if (!ret) {
+    if (out) {
+      /* 以降ptrの値は参照しないのでout == ptrでも値のコピーは不要 */
+      ret = unshare_object(out, 0);
+      if (!ret) dr = out->row;
+
+    } else if (dst) {
+      ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
+      if (!ret) dr = obj->row;
 
     } else {
-      dt = st;
-      dr = sr;
-      st = ptr->tbl;
-      sr = ptr->row;
+      ret = unshare_object(ptr, 0);
+      if (!ret) dr = ptr->row;
     }
   }
 
@@ -1566,38 +4343,107 @@ cmat_inverse(cmat_t* ptr, cmat_t** dst)
    * calculate inverse matrix
    */
   if (!ret) {
-    calc_inverse(sr, ptr->rows, dr);
+    if (fix) {
+      for (i = 0; i < ptr->rows; i++) {
+        memcpy(dr[i], ft + (i * ptr->rows), sizeof(float) * ptr->rows);
+      }
+
+    } else {
+      ret = calc_inverse(wr, ptr->rows, piv, dr);
+    }
   }
 
   /*
    * put return parameter
    */
   if (!ret) {
-    if (dst) {
-      *dst = obj;
-    } else {
-      free(ptr->tbl);
-      free(ptr->row);
-      ptr->tbl = dt;
-      ptr->row = dr;
-    }
+    if (dst) *dst = obj;
   }
 
   /*
    * post process
    */
   if (ret) {
-    if (dst) {
-      if (obj) free_object(obj);
-    } else {
-      if (dt) free(dt);
-      if (dr) free(dr);
+    if (obj) free_object(obj);
+  }
+
+  if (piv) free(piv);
+  if (wr) free(wr);
+  if (wt) free(wt);
+
+  return ret;
+}
+
+/**
+ * 逆行列の算出
+ *  inverse(ptr) → dst       (dst != NULL)
+ *  inverse(ptr) → ptr       (dst == NULL)
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param dst   逆行列の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note LU分解は一度だけ行い、正則性の判定(行列式の評価)にも分解結果を
+ *       用いる。
+ * @note 4x4以下の行列は作業領域を確保せずに余因子行列から直接求める。
+ */
+int
+cmat_inverse(cmat_t* ptr, cmat_t** dst)
+{
+  return inverse_object(ptr, NULL, dst);
+}
+
+/**
+ * 逆行列の算出(出力先指定)
+ *  inverse(ptr) → dst
+ *
+ * @param ptr   対象の行列オブジェクト
+ * @param dst   逆行列の格納先(ptrと同じ形状の行列オブジェクト)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note dstにはptrと同じオブジェクトを指定してもよい。
+ * @note 4x4以下の行列では作業領域の確保は発生しない。それより大きな行列
+ *       ではLU分解用の作業領域を確保する。
+ */
+int
+cmat_inverse_into(cmat_t* ptr, cmat_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
     }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    if (dst->rows != ptr->rows || dst->cols != ptr->cols) ret = CMAT_ERR_SHAPE;
   }
 
-  if (dst) {
-    if (st) free(st);
-    if (sr) free(sr);
+  /*
+   * calculate inverse matrix
+   */
+  if (!ret) {
+    ret = inverse_object(ptr, dst, NULL);
   }
 
   return ret;
@@ -1636,6 +4482,7 @@ cmat_lu_decomp(cmat_t* ptr, cmat_t** dst, int* piv)
   cmat_t* obj;
 
   int i;
+  int swp;
 
   float** row;  // as "Source Row"
 
@@ -1649,7 +4496,17 @@ cmat_lu_decomp(cmat_t* ptr, cmat_t** dst, int* piv)
   /*
    * argument check
    */
-  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
  
   /*
    * alloc result object
@@ -1659,17 +4516,14 @@ cmat_lu_decomp(cmat_t* ptr, cmat_t** dst, int* piv)
       ret = alloc_object(ptr->rows, ptr->cols, ptr, &obj);
       if (!ret) {
         for (i = 0; i < ptr->rows; i++) {
-#ifdef ENABLE_NEON
-          memcpy128(obj->row[i], ptr->row[i], sizeof(float) * ptr->cols);
-#else /* defined(ENABLE_NEON) */
           memcpy(obj->row[i], ptr->row[i], sizeof(float) * ptr->cols);
-#endif /* defined(ENABLE_NEON) */
         }
 
         row = obj->row;
       }
 
     } else {
+      ret = unshare_object(ptr, !0);
       row = ptr->row;
     }
   }
@@ -1678,7 +4532,7 @@ cmat_lu_decomp(cmat_t* ptr, cmat_t** dst, int* piv)
    * do LU decompression
    */
   if (!ret) {
-    lu_decomp(row, ptr->rows, ptr->coff, piv);
+    ret = lu_decomp(row, ptr->rows, ptr->coff, piv, &swp);
   }
 
   /*
@@ -1749,7 +4603,7 @@ cmat_det(cmat_t* ptr, float* dst)
   if (!ret) {
     switch (ptr->rows) {
     case 1:             // when 1x1
-      det = ptr->tbl[0];
+      det = ptr->row[0][0];
       break;
 
     case 2:             // when 2x2
@@ -1760,6 +4614,10 @@ cmat_det(cmat_t* ptr, float* dst)
       det = calc_det_dim3(ptr->row[0], ptr->row[1], ptr->row[2]);
       break;
 
+    case 4:             // when 4x4
+      det = calc_det_dim4(ptr->row[0], ptr->row[1], ptr->row[2], ptr->row[3]);
+      break;
+
     default:            // when nxn
       ret = calc_det(ptr->row, ptr->rows, ptr->coff, &det);
       break;
@@ -1776,6 +4634,53 @@ cmat_det(cmat_t* ptr, float* dst)
   return ret;
 }
 
+/*
+ * ドット積の[i0, i1)の範囲の部分和
+ */
+static float
+dot_block(cmat_t* ptr, cmat_t* op, long i0, long i1)
+{
+  float ret;
+
+  if (!IS_TRANS(ptr) && !IS_TRANS(op)) {
+    ret = calc_dot(ptr->row, ptr->cols, op->row, op->cols, i0, i1);
+
+  } else if (IS_TRANS(ptr) && IS_TRANS(op) &&
+             ptr->rows == op->rows && ptr->cols == op->cols) {
+    /* 同じ形状の転置ビュー同士は元の行列の並びで積和を求めればよい */
+    ret = calc_dot(ptr->row, ptr->rows, op->row, op->rows, i0, i1);
+
+  } else {
+    ret = calc_dot_elem(ptr, op, i0, i1);
+  }
+
+  return ret;
+}
+
+typedef struct {
+  cmat_t* ptr;
+  cmat_t* op;
+  long n;
+  float* part;    // DOT_BLOCKごとの部分和
+} dot_arg_t;
+
+static void
+dot_range(void* arg, long i0, long i1)
+{
+  dot_arg_t* a;
+  long b;
+  long e;
+
+  a = (dot_arg_t*)arg;
+
+  for (b = i0; b < i1; b++) {
+    e = (b + 1) * DOT_BLOCK;
+    if (e > a->n) e = a->n;
+
+    a->part[b] = dot_block(a->ptr, a->op, b * DOT_BLOCK, e);
+  }
+}
+
 /**
  * 行列のドット積の計算
  *  ptr * op → dst
@@ -1790,15 +4695,13 @@ int
 cmat_dot(cmat_t* ptr, cmat_t* op, float* dst)
 {
   int ret;
+  dot_arg_t arg;
   float dot;
-  int i;
-  int n;
-
-  int r1;
-  int r2;
-
-  float* s;
-  float* o;
+  long nb;
+  long n;
+  long i;
+  long e;
+  int nt;
 
   /*
    * initialize
@@ -1837,15 +4740,31 @@ cmat_dot(cmat_t* ptr, cmat_t* op, float* dst)
    * calc dot product
    */
   if (!ret) {
-    n  = ptr->rows * ptr->cols;
-    r1 = 0;
-    r2 = 0;
+    /*
+     * 要素数の大きい場合はDOT_BLOCK単位で分割して並列に処理する。部分和は
+     * ブロックの順に足し合わせるので、結果はスレッド数によらず同じになる。
+     */
+    n   = (long)ptr->rows * ptr->cols;
+    nb  = (n + DOT_BLOCK - 1) / DOT_BLOCK;
+    nt  = cmat_ctx_threads(n, DOT_PARALLEL_MIN);
 
-    for (i = 0; i < n; i++) {
-      if (i % ptr->cols == 0) s = ptr->row[r1++];
-      if (i % op->cols == 0) o = op->row[r2++];
+    arg.part = (nt > 1 && nb > 1)? (float*)malloc(sizeof(float) * nb): NULL;
+
+    if (arg.part) {
+      arg.ptr = ptr;
+      arg.op  = op;
+      arg.n   = n;
+
+      cmat_parallel_for(nb, nt, dot_range, &arg);
 
-      dot += s[i % ptr->cols] * o[i % op->cols];
+      for (i = 0; i < nb; i++) dot += arg.part[i];
+      free(arg.part);
+
+    } else {
+      for (i = 0; i < n; i += DOT_BLOCK) {
+        e    = (n - i < DOT_BLOCK)? n: i + DOT_BLOCK;
+        dot += dot_block(ptr, op, i, e);
+      }
     }
   }
 
@@ -1904,10 +4823,10 @@ cmat_abs_max(cmat_t* ptr, float* dst)
    * lookup maximum value
    */
   if (!ret) {
-    for (r = 0; r < ptr->rows; r++) {
+    for (r = 0; r < STORE_ROWS(ptr); r++) {
       row = ptr->row[r];
 
-      for (c = 0; c < ptr->cols; c++) {
+      for (c = 0; c < STORE_COLS(ptr); c++) {
         if (fabsf(row[c]) > fabsf(max)) max = row[c];
       }
     }
@@ -1968,10 +4887,10 @@ cmat_abs_min(cmat_t* ptr, float* dst)
    */
   if (!ret) {
     if (ptr->rows > 0 && ptr->cols > 0) {
-      for (r = 0; r < ptr->rows; r++) {
+      for (r = 0; r < STORE_ROWS(ptr); r++) {
         row = ptr->row[r];
 
-        for (c = 0; c < ptr->cols; c++) {
+        for (c = 0; c < STORE_COLS(ptr); c++) {
           if (fabsf(row[c]) < fabsf(min)) min = row[c];
         }
       }
@@ -2028,8 +4947,20 @@ cmat_permute_row(cmat_t* ptr, int* _piv)
       ret = CMAT_ERR_BADDR;
       break;
     }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
   } while (0);
 
+  /*
+   * copy shared storage
+   */
+  if (!ret) {
+    ret = unshare_object(ptr, !0);
+  }
+
   /*
    * alloc pivots array
    */
@@ -2119,8 +5050,20 @@ cmat_permute_column(cmat_t* ptr, int* _piv)
       ret = CMAT_ERR_BADDR;
       break;
     }
+
+    if (IS_TRANS(ptr)) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
   } while (0);
 
+  /*
+   * copy shared storage
+   */
+  if (!ret) {
+    ret = unshare_object(ptr, !0);
+  }
+
   /*
    * alloc pivots array
    */
@@ -2189,8 +5132,6 @@ cmat_compare(cmat_t* ptr, cmat_t* op, int* dst)
   int res;
   int r;
   int c;
-  float* p;
-  float* o;
 
   /*
    * initialize
@@ -2227,11 +5168,8 @@ cmat_compare(cmat_t* ptr, cmat_t* op, int* dst)
 
     /* check values */
     for (r = 0; r < ptr->rows; r++) {
-      p = ptr->row[r];
-      o = op->row[r];
-
       for (c = 0; c < ptr->cols; c++) {
-        if (fcmp(p[c], o[c], ptr->coff)) goto loop_out;
+        if (fcmp(ELEM(ptr, r, c), ELEM(op, r, c), ptr->coff)) goto loop_out;
       }
     }
 
@@ -2268,7 +5206,6 @@ cmat_check(cmat_t* ptr, float* val, int* dst)
   int r;
   int c;
 
-  float* p;
 
   /*
    * initialize
@@ -2302,10 +5239,8 @@ cmat_check(cmat_t* ptr, float* val, int* dst)
   if (!ret) {
     /* check values */
     for (r = 0; r < ptr->rows; r++) {
-      p = ptr->row[r];
-
       for (c = 0; c < ptr->cols; c++) {
-        if (fcmp(p[c], *val++, ptr->coff)) goto loop_out;
+        if (fcmp(ELEM(ptr, r, c), *val++, ptr->coff)) goto loop_out;
       }
     }
 
@@ -2324,6 +5259,42 @@ cmat_check(cmat_t* ptr, float* val, int* dst)
   return ret;
 }
 
+/**
+ * 使用中のSIMDカーネルの取得
+ *
+ * @param dst   カーネル種別(CMAT_SIMD_*)の格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note カーネルは起動時にCPUの機能から自動的に選択される。環境変数
+ *       CMAT_SIMD_LEVELにscalar, sse42, avx2, avx512, neonのいずれかを
+ *       指定すると(そのCPUで使用可能な場合に限り)選択を上書きできる。
+ */
+int
+cmat_get_simd_level(int* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * check argument
+   */
+  if (dst == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = cmat_kernel->level;
+  }
+
+  return ret;
+}
+
 /**
  * 切り捨て処理の閾値の設定
  *
@@ -0,0 +1,644 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * 実行コンテキスト
+ *
+ *  並列化に使うスレッド数、並列化を行う最小の処理量、作業領域をまとめたも
+ *  の。小さな行列の演算でOpenMPのスレッドチームを起動するコストを避けるた
+ *  め、各演算は処理量が閾値に満たない場合は逐次に実行する。閾値は演算ごと
+ *  の既定値を持ち、コンテキストで一律に上書きできる。
+ *
+ *  カレントコンテキストはスレッドローカルに保持するので、異なるスレッドか
+ *  ら別々のコンテキストで演算を行ってよい(同じコンテキストを複数のスレッ
+ *  ドで同時に使用してはならない)。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* defined(_OPENMP) */
+
+#include "cmat.h"
+#include "ctx.h"
+#include "parallel.h"
+
+#define ALIGN_BYTES         64
+
+struct __cmat_ctx__ {
+  int nthreads;       // 使用するスレッド数(0でOpenMPの既定値)
+  long par_min;       // 並列化を行う最小の処理量(負の場合は演算ごとの既定値)
+  cmat_sched_t* sched;  // 並列化に使うスケジューラ(NULLでOpenMP)
+  int numa;           // NUMAの配置方針(CMAT_NUMA_*)
+
+  void* scratch;      // 作業領域
+  size_t size;        // 作業領域の大きさ
+};
+
+/*
+ * カレントコンテキストを切り替えて演算を呼び出す
+ */
+#define WITH_CTX(ctx,call) \
+                            do { \
+                              int __ret; \
+                              cmat_ctx_t* __org; \
+                              if ((ctx) == NULL) return CMAT_ERR_BADDR; \
+                              __org = cmat_ctx_enter(ctx); \
+                              __ret = (call); \
+                              cmat_ctx_leave(__org); \
+                              return __ret; \
+                            } while (0)
+
+static __thread cmat_ctx_t* current = NULL;
+
+cmat_ctx_t*
+cmat_ctx_enter(cmat_ctx_t* ctx)
+{
+  cmat_ctx_t* ret;
+
+  ret     = current;
+  current = ctx;
+
+  return ret;
+}
+
+void
+cmat_ctx_leave(cmat_ctx_t* org)
+{
+  current = org;
+}
+
+int
+cmat_ctx_threads(long work, long min)
+{
+  int ret;
+  cmat_ctx_t* ctx;
+
+  ctx = current;
+
+  if (ctx && ctx->par_min >= 0) min = ctx->par_min;
+
+  if (work < min) {
+    ret = 1;
+
+  } else if (ctx && ctx->nthreads > 0) {
+    ret = ctx->nthreads;
+
+  } else if (cmat_sched_current()) {
+    ret = cmat_sched_size(cmat_sched_current());
+
+  } else {
+#ifdef _OPENMP
+    ret = omp_get_max_threads();
+#else /* defined(_OPENMP) */
+    ret = 1;
+#endif /* defined(_OPENMP) */
+  }
+
+  return ret;
+}
+
+cmat_sched_t*
+cmat_ctx_sched(void)
+{
+  return (current)? current->sched: NULL;
+}
+
+int
+cmat_ctx_numa(void)
+{
+  return (current)? current->numa: CMAT_NUMA_NONE;
+}
+
+void*
+cmat_ctx_scratch(size_t size)
+{
+  void* ret;
+  cmat_ctx_t* ctx;
+
+  ret = NULL;
+  ctx = current;
+
+  if (ctx && ctx->size >= size) {
+    ret = ctx->scratch;
+
+  } else if (ctx) {
+    if (ctx->scratch) free(ctx->scratch);
+
+    if (posix_memalign(&ret, ALIGN_BYTES, size)) ret = NULL;
+
+    ctx->scratch = ret;
+    ctx->size    = (ret)? size: 0;
+  }
+
+  return ret;
+}
+
+void
+cmat_ctx_copy(cmat_ctx_t* dst, cmat_ctx_t* src)
+{
+  if (src) {
+    dst->nthreads = src->nthreads;
+    dst->par_min  = src->par_min;
+    dst->sched    = src->sched;
+    dst->numa     = src->numa;
+
+  } else {
+    dst->nthreads = 0;
+    dst->par_min  = -1;
+    dst->sched    = NULL;
+    dst->numa     = CMAT_NUMA_NONE;
+  }
+}
+
+int
+cmat_ctx_dup(cmat_ctx_t* ctx, cmat_ctx_t** dst)
+{
+  int ret;
+
+  ret = cmat_ctx_new(dst);
+  if (!ret) cmat_ctx_copy(*dst, ctx);
+
+  return ret;
+}
+
+/**
+ * 実行コンテキストの生成
+ *
+ * @param dst   生成したコンテキストの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 生成直後はスレッド数・閾値とも既定値(cmat_ctx_set_threads(),
+ *       cmat_ctx_set_parallel_min()参照)。
+ */
+int
+cmat_ctx_new(cmat_ctx_t** dst)
+{
+  int ret;
+  cmat_ctx_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    obj = (cmat_ctx_t*)malloc(sizeof(cmat_ctx_t));
+    if (obj == NULL) ret = CMAT_ERR_NOMEM;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    memset(obj, 0, sizeof(cmat_ctx_t));
+    obj->par_min = -1;
+
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * 実行コンテキストの削除
+ *
+ * @param ptr   削除するコンテキスト
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_ctx_destroy(cmat_ctx_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    if (ptr->scratch) free(ptr->scratch);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+/**
+ * 並列化に使用するスレッド数の設定
+ *
+ * @param ptr   対象のコンテキスト
+ * @param n     スレッド数(0で既定値、1で常に逐次実行)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 既定値はスケジューラが設定されている場合はそのワーカ数 + 1、それ
+ *       以外はOpenMPの既定のスレッド数。
+ */
+int
+cmat_ctx_set_threads(cmat_ctx_t* ptr, int n)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (n < 0) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update context
+   */
+  if (!ret) {
+    ptr->nthreads = n;
+  }
+
+  return ret;
+}
+
+/**
+ * 並列化を行う最小の処理量の設定
+ *
+ * @param ptr   対象のコンテキスト
+ * @param n     最小の処理量(負の値で演算ごとの既定値に戻す)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 処理量は要素ごとの演算では要素数、行列積・LU分解・逆行列では積和
+ *       の回数(m * n * k, n^3)、バッチ演算では行列の数で数える。0を指定
+ *       すると常に並列化する。
+ */
+int
+cmat_ctx_set_parallel_min(cmat_ctx_t* ptr, long n)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * update context
+   */
+  if (!ret) {
+    ptr->par_min = (n < 0)? -1: n;
+  }
+
+  return ret;
+}
+
+/**
+ * 並列化に使用するスケジューラの設定
+ *
+ * @param ptr   対象のコンテキスト
+ * @param sched スケジューラ(NULLでOpenMPを使用する)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note コンテキストはschedを所有しない。schedはptrを使う演算が全て終わ
+ *       るまで削除してはならない。
+ */
+int
+cmat_ctx_set_sched(cmat_ctx_t* ptr, cmat_sched_t* sched)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * update context
+   */
+  if (!ret) {
+    ptr->sched = sched;
+  }
+
+  return ret;
+}
+
+/**
+ * NUMAの配置方針の設定
+ *
+ * @param ptr     対象のコンテキスト
+ * @param policy  配置方針(CMAT_NUMA_*)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note ptrを指定して生成する行列(cmat_new_ctx()と各演算の結果)の値テー
+ *       ブルに適用する。CMAT_NUMA_FIRST_TOUCHは初期化を並列に行って書き
+ *       込んだスレッドのノードに、CMAT_NUMA_INTERLEAVEは全ノードにページ
+ *       単位で交互に、CMAT_NUMA_ROW_BLOCKSは行を連続したブロックに分けて
+ *       先頭から順に各ノードに置く。CMAT_NUMA_NONE以外では並列forの範囲
+ *       を各スレッドに固定で割り当てるので、初期化と以降の演算で同じ行が
+ *       同じスレッドで処理される。スケジューラのワーカは
+ *       cmat_sched_set_numa()で、OpenMPのスレッドはOMP_PROC_BIND=closeで
+ *       ノードの順に固定しておくこと。メモリプールから確保する行列とノー
+ *       ドが一つしか無い環境では配置を行わない。
+ */
+int
+cmat_ctx_set_numa(cmat_ctx_t* ptr, int policy)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (policy < CMAT_NUMA_NONE || policy > CMAT_NUMA_ROW_BLOCKS) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update context
+   */
+  if (!ret) {
+    ptr->numa = policy;
+  }
+
+  return ret;
+}
+
+/**
+ * 行列オブジェクトの生成 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_new()と同じ。
+ */
+int
+cmat_new_ctx(cmat_ctx_t* ctx, float* src, int rows, int cols, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_new(src, rows, cols, dst));
+}
+
+/**
+ * 行列の和 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_add()と同じ。
+ */
+int
+cmat_add_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_add(ptr, op, dst));
+}
+
+/**
+ * 行列の差 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_sub()と同じ。
+ */
+int
+cmat_sub_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_sub(ptr, op, dst));
+}
+
+/**
+ * 行列の積 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_product()と同じ。
+ */
+int
+cmat_product_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_product(ptr, op, dst));
+}
+
+/**
+ * スカラー積 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_mul()と同じ。
+ */
+int
+cmat_mul_ctx(cmat_ctx_t* ctx, cmat_t* ptr, float op, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_mul(ptr, op, dst));
+}
+
+/**
+ * 一般化行列積 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_gemm()と同じ。
+ */
+int
+cmat_gemm_ctx(cmat_ctx_t* ctx, int ta, int tb, float alpha,
+              cmat_t* a, cmat_t* b, float beta, cmat_t* c)
+{
+  WITH_CTX(ctx, cmat_gemm(ta, tb, alpha, a, b, beta, c));
+}
+
+/**
+ * 転置行列 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_transpose()と同じ。
+ */
+int
+cmat_transpose_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_transpose(ptr, dst));
+}
+
+/**
+ * 行列式 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_det()と同じ。
+ */
+int
+cmat_det_ctx(cmat_ctx_t* ctx, cmat_t* ptr, float* dst)
+{
+  WITH_CTX(ctx, cmat_det(ptr, dst));
+}
+
+/**
+ * ドット積 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_dot()と同じ。
+ */
+int
+cmat_dot_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, float* dst)
+{
+  WITH_CTX(ctx, cmat_dot(ptr, op, dst));
+}
+
+/**
+ * 逆行列 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_inverse()と同じ。
+ */
+int
+cmat_inverse_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst)
+{
+  WITH_CTX(ctx, cmat_inverse(ptr, dst));
+}
+
+/**
+ * LU分解 (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_lu_decomp()と同じ。
+ */
+int
+cmat_lu_decomp_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst, int* piv)
+{
+  WITH_CTX(ctx, cmat_lu_decomp(ptr, dst, piv));
+}
+
+/**
+ * 行列の和(出力先指定) (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_add_into()と同じ。
+ */
+int
+cmat_add_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t* dst)
+{
+  WITH_CTX(ctx, cmat_add_into(ptr, op, dst));
+}
+
+/**
+ * 行列の差(出力先指定) (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_sub_into()と同じ。
+ */
+int
+cmat_sub_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t* dst)
+{
+  WITH_CTX(ctx, cmat_sub_into(ptr, op, dst));
+}
+
+/**
+ * 行列の積(出力先指定) (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_product_into()と同じ。
+ */
+int
+cmat_product_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t* dst)
+{
+  WITH_CTX(ctx, cmat_product_into(ptr, op, dst));
+}
+
+/**
+ * スカラー積(出力先指定) (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_mul_into()と同じ。
+ */
+int
+cmat_mul_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, float op, cmat_t* dst)
+{
+  WITH_CTX(ctx, cmat_mul_into(ptr, op, dst));
+}
+
+/**
+ * 転置行列(出力先指定) (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_transpose_into()と同じ。
+ */
+int
+cmat_transpose_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* dst)
+{
+  WITH_CTX(ctx, cmat_transpose_into(ptr, dst));
+}
+
+/**
+ * 逆行列(出力先指定) (コンテキスト指定)
+ *
+ * @param ctx   実行コンテキスト
+ *
+ * @note その他の引数と戻り値はcmat_inverse_into()と同じ。
+ */
+int
+cmat_inverse_into_ctx(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* dst)
+{
+  WITH_CTX(ctx, cmat_inverse_into(ptr, dst));
+}
@@ -0,0 +1,63 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_MATRIX_CTX_H__
+#define __CHEAP_MATRIX_CTX_H__
+
+#include <stddef.h>
+
+/*
+ * 実行コンテキスト
+ *
+ * *_ctx()系の関数は、呼び出しの間だけ指定されたコンテキストを呼び出し元
+ * スレッドのカレントコンテキストにする。演算の内部ではcmat_ctx_threads()
+ * で並列化の要否とスレッド数を、cmat_ctx_scratch()で作業領域を得る。カレ
+ * ントコンテキストが無い場合は既定値(OpenMPの既定のスレッド数と演算ごと
+ * の閾値)で動作する。
+ */
+cmat_ctx_t* cmat_ctx_enter(cmat_ctx_t* ctx);
+void cmat_ctx_leave(cmat_ctx_t* org);
+
+/*
+ * 処理量workの並列領域で使用するスレッド数(1の場合は並列化しない)
+ *  minは演算ごとの並列化を行う最小の処理量で、コンテキストで閾値が指定さ
+ *  れている場合はそちらを使う。
+ */
+int cmat_ctx_threads(long work, long min);
+
+/*
+ * 設定(スレッド数、閾値、スケジューラ、NUMAの配置方針)を引き継いだコン
+ * テキストの生成
+ *  作業領域は引き継がない。ctxがNULLの場合は既定値のコンテキストを生成す
+ *  る。
+ */
+int cmat_ctx_dup(cmat_ctx_t* ctx, cmat_ctx_t** dst);
+
+/*
+ * 設定(スレッド数、閾値、スケジューラ、NUMAの配置方針)のコピー
+ *  srcがNULLの場合は既定値に戻す。dstの作業領域はそのまま残す。
+ */
+void cmat_ctx_copy(cmat_ctx_t* dst, cmat_ctx_t* src);
+
+/*
+ * カレントコンテキストに設定されたスケジューラ(無い場合はNULL)
+ */
+cmat_sched_t* cmat_ctx_sched(void);
+
+/*
+ * カレントコンテキストのNUMAの配置方針(無い場合はCMAT_NUMA_NONE)
+ */
+int cmat_ctx_numa(void);
+
+/*
+ * カレントコンテキストの作業領域(sizeバイト以上、64バイト境界)
+ *  カレントコンテキストが無い場合、または確保できなかった場合はNULLを返す
+ *  (呼び出し側で確保すること)。領域は次のcmat_ctx_scratch()の呼び出しま
+ *  で有効。
+ */
+void* cmat_ctx_scratch(size_t size);
+
+#endif /* !defined(__CHEAP_MATRIX_CTX_H__) */
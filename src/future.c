@@ -0,0 +1,701 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * 非同期演算
+ *
+ *  *_async()系の関数は演算をスケジューラに投入して直ちに戻り、完了を待ち
+ *  合わせるためのハンドル(cmat_future_t)を返す。演算は指定されたコンテキ
+ *  ストの設定(スレッド数、閾値、スケジューラ)を引き継いだ専用のコンテキ
+ *  ストで実行するので、呼び出し元は同じコンテキストで他の演算を続けてよい。
+ *  コンテキストにスケジューラが設定されていない場合はライブラリ既定のスケ
+ *  ジューラ(cmat_sched_default())を使用する。
+ *
+ *  メモリプールはスレッドセーフではないので、結果の行列の確保と共有の解除
+ *  は呼び出し元のスレッドで投入時に済ませておき、ワーカでは出力先指定の演
+ *  算(cmat_*_into()相当)のみを行う(ワーカはプールに触れない)。
+ *
+ *  完了は二段階で通知する。演算の戻り値が確定した時点(ready)でコールバッ
+ *  クを呼び出し、コールバックから戻った時点(done)で完了待ちを解く。コール
+ *  バックの中で呼び出されたcmat_future_destroy()は削除の予約のみを行い、
+ *  コールバックから戻った後に削除する。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "cmat.h"
+#include "ctx.h"
+#include "parallel.h"
+
+#define OP_PRODUCT          0
+#define OP_INVERSE          1
+#define OP_LU_DECOMP        2
+
+struct __cmat_future__ {
+  int op;                   // 演算の種類
+  cmat_t* ptr;
+  cmat_t* arg;
+  cmat_t* out;              // 結果の格納先(呼び出し元に渡すまで所有する)
+  cmat_t** dst;
+  int* piv;
+
+  cmat_ctx_t* ctx;          // 演算に使うコンテキスト
+  cmat_sched_t* sched;
+
+  int ready;                // 演算の戻り値が確定した場合は!0
+  int done;                 // コールバックまで完了した場合は!0
+  int ret;                  // 演算の戻り値
+
+  void (*cb)(cmat_future_t* fut, int res, void* user);
+  void* user;
+
+  int in_cb;                // コールバックを実行中の場合は!0
+  pthread_t cb_th;          // コールバックを実行しているスレッド
+  int dead;                 // コールバックの中で削除された場合は!0
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+static void
+free_future(cmat_future_t* ptr)
+{
+  pthread_mutex_destroy(&ptr->lock);
+  pthread_cond_destroy(&ptr->cond);
+
+  if (ptr->out) cmat_destroy(ptr->out);
+  if (ptr->ctx) cmat_ctx_destroy(ptr->ctx);
+  free(ptr);
+}
+
+/*
+ * 呼び出し元のスレッドがコールバックを実行中か (lockを取得して呼ぶこと)
+ */
+static int
+in_callback(cmat_future_t* fut)
+{
+  return (fut->in_cb && pthread_equal(fut->cb_th, pthread_self()));
+}
+
+/*
+ * コールバックの呼び出し
+ *  戻った後に完了を通知する。コールバックの中で削除された場合はここで削
+ *  除する。
+ */
+static void
+call_back(cmat_future_t* fut, void (*cb)(cmat_future_t*, int, void*),
+          int res, void* user)
+{
+  int dead;
+
+  cb(fut, res, user);
+
+  pthread_mutex_lock(&fut->lock);
+
+  fut->in_cb = 0;
+  dead       = fut->dead;
+
+  if (!dead) {
+    __atomic_store_n(&fut->done, !0, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&fut->cond);
+  }
+
+  pthread_mutex_unlock(&fut->lock);
+
+  if (dead) free_future(fut);
+}
+
+/*
+ * LU分解 (outを使う場合は値をコピーしてから分解する)
+ */
+static int
+lu_decomp_into(cmat_t* ptr, cmat_t* out, int* piv)
+{
+  int ret;
+  int i;
+
+  if (out == NULL) {
+    ret = cmat_lu_decomp(ptr, NULL, piv);
+
+  } else if (ptr->flags & CMAT_FLAG_TRANS) {
+    ret = CMAT_ERR_INVAL;
+
+  } else {
+    for (i = 0; i < ptr->rows; i++) {
+      memcpy(CMAT_ROW(out, i), CMAT_ROW(ptr, i), sizeof(float) * ptr->cols);
+    }
+
+    ret = cmat_lu_decomp(out, NULL, piv);
+  }
+
+  return ret;
+}
+
+/*
+ * 演算の実行(スケジューラのワーカで呼び出される)
+ *  結果の格納先(out)は投入時に確保済みなので、ここでは領域の確保・解放を
+ *  行わない(outを使わないのはプールを使わない行列の積の場合のみ)。
+ */
+static void
+run_future(void* arg)
+{
+  cmat_future_t* fut;
+  cmat_ctx_t* org;
+  void (*cb)(cmat_future_t*, int, void*);
+  void* user;
+  int ret;
+
+  fut = (cmat_future_t*)arg;
+  org = cmat_ctx_enter(fut->ctx);
+
+  switch (fut->op) {
+  case OP_PRODUCT:
+    if (fut->out) {
+      ret = cmat_product_into(fut->ptr, fut->arg, fut->out);
+    } else {
+      ret = cmat_product(fut->ptr, fut->arg, NULL);
+    }
+    break;
+
+  case OP_INVERSE:
+    ret = cmat_inverse_into(fut->ptr, (fut->out)? fut->out: fut->ptr);
+    break;
+
+  case OP_LU_DECOMP:
+    ret = lu_decomp_into(fut->ptr, fut->out, fut->piv);
+    break;
+
+  default:
+    ret = CMAT_ERR_INVAL;
+    break;
+  }
+
+  cmat_ctx_leave(org);
+
+  pthread_mutex_lock(&fut->lock);
+
+  if (!ret && fut->dst) {
+    *fut->dst = fut->out;
+    fut->out  = NULL;
+  }
+
+  fut->ret   = ret;
+  fut->ready = !0;
+  cb         = fut->cb;
+  user       = fut->user;
+
+  if (cb) {
+    fut->in_cb = !0;
+    fut->cb_th = pthread_self();
+  } else {
+    __atomic_store_n(&fut->done, !0, __ATOMIC_RELEASE);
+  }
+
+  pthread_cond_broadcast(&fut->cond);
+  pthread_mutex_unlock(&fut->lock);
+
+  if (cb) call_back(fut, cb, ret, user);
+}
+
+/*
+ * 結果の格納先の確保 (呼び出し元のスレッドで行う)
+ *  ptrと同じプールから確保し、カットオフ値を引き継ぐ。
+ */
+static int
+alloc_result(cmat_t* ptr, int rows, int cols, cmat_t** dst)
+{
+  int ret;
+
+  if (ptr->pool) {
+    ret = cmat_pool_alloc(ptr->pool, NULL, rows, cols, dst);
+  } else {
+    ret = cmat_new(NULL, rows, cols, dst);
+  }
+
+  if (!ret) cmat_set_cutoff_threshold(*dst, ptr->coff);
+
+  return ret;
+}
+
+/*
+ * 非同期演算の開始
+ *  ワーカを持たないスケジューラの場合、およびキューが一杯の場合はその場で
+ *  実行する(戻った時点で完了している)。
+ */
+static int
+start_future(cmat_ctx_t* ctx, int op, cmat_t* ptr, cmat_t* arg,
+             cmat_t** dst, int* piv, cmat_future_t** fut)
+{
+  int ret;
+  cmat_future_t* obj;
+  cmat_ctx_t* org;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * alloc memory
+   */
+  obj = (cmat_future_t*)malloc(sizeof(cmat_future_t));
+  if (obj == NULL) ret = CMAT_ERR_NOMEM;
+
+  if (!ret) {
+    memset(obj, 0, sizeof(cmat_future_t));
+
+    obj->op  = op;
+    obj->ptr = ptr;
+    obj->arg = arg;
+    obj->dst = dst;
+    obj->piv = piv;
+
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_cond_init(&obj->cond, NULL);
+
+    ret = cmat_ctx_dup(ctx, &obj->ctx);
+  }
+
+  /*
+   * alloc result object
+   *  結果を別の行列に出力する場合は格納先を確保し、ptrを書き換える場合は
+   *  共有を解いておく(いずれもptrのプールを使うので呼び出し元で行う)。
+   */
+  if (!ret) {
+    org = cmat_ctx_enter(obj->ctx);
+
+    if (dst) {
+      if (op == OP_PRODUCT) {
+        ret = alloc_result(ptr, ptr->rows, arg->cols, &obj->out);
+      } else {
+        ret = alloc_result(ptr, ptr->rows, ptr->cols, &obj->out);
+      }
+
+    } else if (op != OP_PRODUCT) {
+      ret = cmat_unshare(ptr);
+    }
+
+    cmat_ctx_leave(org);
+  }
+
+  /*
+   * select scheduler
+   */
+  if (!ret) {
+    org        = cmat_ctx_enter(obj->ctx);
+    obj->sched = cmat_ctx_sched();
+    cmat_ctx_leave(org);
+
+    if (obj->sched == NULL) {
+      obj->sched = cmat_sched_default();
+      cmat_ctx_set_sched(obj->ctx, obj->sched);
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *fut = obj;
+  }
+
+  /*
+   * start operation
+   */
+  if (!ret) {
+    if (obj->sched == NULL || !cmat_sched_has_workers(obj->sched) ||
+        cmat_sched_post(obj->sched, run_future, obj)) {
+      run_future(obj);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj) free_future(obj);
+  }
+
+  return ret;
+}
+
+/**
+ * 行列の積 (非同期)
+ *
+ * @param ctx   実行コンテキスト(NULLの場合は既定値)
+ * @param fut   完了待ち合わせ用のハンドルの格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note その他の引数はcmat_product()と同じ。演算の戻り値は
+ *       cmat_future_wait()で得る。ptr, op, dstは完了するまで変更・削除し
+ *       てはならない。
+ * @note 結果の行列は呼び出し元のスレッドでptrと同じプールから確保し、ワー
+ *       カではプールを使用しない。ただし、プールから確保したptrを結果で
+ *       置き換える(dstにNULLを指定する)場合はCMAT_ERR_INVALを返す。
+ */
+int
+cmat_product_async(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t* op, cmat_t** dst,
+                   cmat_future_t** fut)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || op == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (fut == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL && ptr->pool != NULL) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * start operation
+   */
+  if (!ret) {
+    ret = start_future(ctx, OP_PRODUCT, ptr, op, dst, NULL, fut);
+  }
+
+  return ret;
+}
+
+/**
+ * 逆行列 (非同期)
+ *
+ * @param ctx   実行コンテキスト(NULLの場合は既定値)
+ * @param fut   完了待ち合わせ用のハンドルの格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note その他の引数はcmat_inverse()と同じ。演算の戻り値は
+ *       cmat_future_wait()で得る。ptr, dstは完了するまで変更・削除しては
+ *       ならない。
+ * @note 結果の行列の確保(dstにNULLを指定した場合はptrの共有の解除)は呼
+ *       び出し元のスレッドで行うので、プールから確保した行列を指定しても
+ *       ワーカはプールを使用しない。
+ */
+int
+cmat_inverse_async(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst,
+                   cmat_future_t** fut)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (fut == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * start operation
+   */
+  if (!ret) {
+    ret = start_future(ctx, OP_INVERSE, ptr, NULL, dst, NULL, fut);
+  }
+
+  return ret;
+}
+
+/**
+ * LU分解 (非同期)
+ *
+ * @param ctx   実行コンテキスト(NULLの場合は既定値)
+ * @param fut   完了待ち合わせ用のハンドルの格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note その他の引数はcmat_lu_decomp()と同じ。演算の戻り値は
+ *       cmat_future_wait()で得る。ptr, dst, pivは完了するまで変更・削除
+ *       してはならない。
+ * @note 結果の行列の確保(dstにNULLを指定した場合はptrの共有の解除)は呼
+ *       び出し元のスレッドで行うので、プールから確保した行列を指定しても
+ *       ワーカはプールを使用しない。
+ */
+int
+cmat_lu_decomp_async(cmat_ctx_t* ctx, cmat_t* ptr, cmat_t** dst, int* piv,
+                     cmat_future_t** fut)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (fut == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * start operation
+   */
+  if (!ret) {
+    ret = start_future(ctx, OP_LU_DECOMP, ptr, NULL, dst, piv, fut);
+  }
+
+  return ret;
+}
+
+/**
+ * 非同期演算の完了待ち
+ *
+ * @param ptr   対象のハンドル
+ * @param res   演算の戻り値の格納先(NULLの場合は格納しない)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 待ちの間は呼び出し元のスレッドもスケジューラのタスクを処理する。
+ *       コールバックが設定されている場合はコールバックから戻るまで待つ
+ *       (コールバックの中から呼び出した場合を除く)。
+ */
+int
+cmat_future_wait(cmat_future_t* ptr, int* res)
+{
+  int ret;
+  int inside;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * wait for completion
+   *  キューにタスクが残っている間はそれを処理し、無くなったら(演算は他の
+   *  スレッドが処理中なので)完了の通知を待つ。
+   */
+  if (!ret) {
+    pthread_mutex_lock(&ptr->lock);
+    inside = in_callback(ptr);
+    pthread_mutex_unlock(&ptr->lock);
+
+    while (!inside && !__atomic_load_n(&ptr->done, __ATOMIC_ACQUIRE)) {
+      if (ptr->sched == NULL || !cmat_sched_help(ptr->sched)) break;
+    }
+
+    /* コールバックの中からの呼び出しでは戻り値の確定のみを待つ */
+    pthread_mutex_lock(&ptr->lock);
+    while (!((inside)? ptr->ready: ptr->done)) {
+      pthread_cond_wait(&ptr->cond, &ptr->lock);
+    }
+    pthread_mutex_unlock(&ptr->lock);
+
+    if (res) *res = ptr->ret;
+  }
+
+  return ret;
+}
+
+/**
+ * 非同期演算の完了の確認
+ *
+ * @param ptr   対象のハンドル
+ * @param done  完了している場合は!0、処理中の場合は0の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 完了の通知を待ってブロックすることはない。処理中の場合はキューに
+ *       残っているタスクを一つだけ呼び出し元のスレッドで処理する。完了し
+ *       ている場合の演算の戻り値はcmat_future_wait()で得る(直ちに戻る)。
+ */
+int
+cmat_future_poll(cmat_future_t* ptr, int* done)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (done == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (!__atomic_load_n(&ptr->done, __ATOMIC_ACQUIRE) && ptr->sched) {
+      cmat_sched_help(ptr->sched);
+    }
+
+    *done = __atomic_load_n(&ptr->done, __ATOMIC_ACQUIRE);
+  }
+
+  return ret;
+}
+
+/**
+ * 完了時のコールバックの設定
+ *
+ * @param ptr   対象のハンドル
+ * @param cb    コールバック関数(NULLで解除)
+ * @param user  cbに渡す任意のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note cb(ptr, res, user)は演算を処理したワーカのスレッドで呼び出される
+ *       (resは演算の戻り値)。既に完了している場合はこの関数の中で呼び出
+ *       す。cbの中でcmat_future_destroy()を呼び出してよい。
+ */
+int
+cmat_future_set_callback(cmat_future_t* ptr,
+                         void (*cb)(cmat_future_t* fut, int res, void* user),
+                         void* user)
+{
+  int ret;
+  int ready;
+  int track;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * set callback
+   */
+  if (!ret) {
+    pthread_mutex_lock(&ptr->lock);
+
+    ready = ptr->ready;
+    track = 0;
+
+    if (!ready) {
+      ptr->cb   = cb;
+      ptr->user = user;
+
+    } else if (cb && !ptr->in_cb) {
+      ptr->in_cb = !0;
+      ptr->cb_th = pthread_self();
+      track      = !0;
+    }
+
+    pthread_mutex_unlock(&ptr->lock);
+
+    if (track) {
+      call_back(ptr, cb, ptr->ret, user);
+    } else if (ready && cb) {
+      cb(ptr, ptr->ret, user);
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * ハンドルの削除
+ *
+ * @param ptr   削除するハンドル
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 演算が完了していない場合は完了を待ってから削除する(コールバッ
+ *       クが設定されている場合はコールバックから戻るまで待つ)。コールバッ
+ *       クの中から呼び出した場合は、コールバックから戻った後に削除する。
+ * @note 演算が失敗した場合は結果用に確保した行列もここで解放する。プール
+ *       から確保した行列の演算では、コールバックの中で削除しないこと(プー
+ *       ルへの返却がワーカのスレッドで行われる)。
+ */
+int
+cmat_future_destroy(cmat_future_t* ptr)
+{
+  int ret;
+  int inside;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    pthread_mutex_lock(&ptr->lock);
+    inside = in_callback(ptr);
+    if (inside) ptr->dead = !0;
+    pthread_mutex_unlock(&ptr->lock);
+
+    if (!inside) {
+      cmat_future_wait(ptr, NULL);
+      free_future(ptr);
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,368 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * キャッシュブロッキングとパッキングを行う行列積 (Goto/BLIS方式)
+ *
+ *  for jc in [0, n) step nc              ... Bの列ブロック (L3)
+ *    for pc in [0, k) step kc            ... 内積方向のブロック
+ *      Bのkc x ncブロックをnr列ごとのパネルにパックする
+ *      Aのm x kcブロックをmr行ごとのパネルにパックする
+ *      for ic in [0, m) step mc          ... Aの行ブロック (L2)  ┐並列化
+ *        for jr in [0, nc) step nr       ... Bパネル (L1)        ┘
+ *          for ir in [ic, ic + mc) step mr
+ *            マイクロカーネルでmr x nrのタイルを計算し、Cに書き戻す
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmat.h"
+#include "kernel.h"
+#include "gemm.h"
+#include "ctx.h"
+#include "parallel.h"
+
+#define ALIGN_BYTES         64
+#define MAX_TILE            (16 * 32)
+#define PARALLEL_MIN        (64 * 64 * 64)
+
+#define MIN(a,b)            (((a) < (b))? (a): (b))
+#define ROUND_UP(n,m)       ((((n) + (m) - 1) / (m)) * (m))
+
+static void*
+alloc_aligned(size_t size)
+{
+  void* ret;
+
+  if (posix_memalign(&ret, ALIGN_BYTES, size)) ret = NULL;
+
+  return ret;
+}
+
+/*
+ * Aのパッキング
+ *  a[i0 .. i0+mb) x [p0 .. p0+kc)の範囲を、dst[p * mr + i]の形式で
+ *  格納する(mbがmrに満たない部分は0で埋める)。taが0以外の場合はaを転置
+ *  したものとして扱う。
+ */
+static void
+pack_a(float* dst, float** a, int ta, int i0, int mb, int p0, int kc, int mr)
+{
+  int i;
+  int p;
+  float* src;
+
+  if (ta) {
+    for (p = 0; p < kc; p++) {
+      src = a[p0 + p] + i0;
+
+      for (i = 0; i < mb; i++) {
+        dst[p * mr + i] = src[i];
+      }
+    }
+
+  } else {
+    for (i = 0; i < mb; i++) {
+      src = a[i0 + i] + p0;
+
+      for (p = 0; p < kc; p++) {
+        dst[p * mr + i] = src[p];
+      }
+    }
+  }
+
+  for (i = mb; i < mr; i++) {
+    for (p = 0; p < kc; p++) {
+      dst[p * mr + i] = 0.0f;
+    }
+  }
+}
+
+/*
+ * Bのパッキング
+ *  b[p0 .. p0+kc) x [j0 .. j0+nb)の範囲を、dst[p * nr + j]の形式で
+ *  格納する(nbがnrに満たない部分は0で埋める)。tbが0以外の場合はbを転置
+ *  したものとして扱う。
+ */
+static void
+pack_b(float* dst, float** b, int tb, int p0, int kc, int j0, int nb, int nr)
+{
+  int p;
+  int j;
+
+  for (p = 0; p < kc; p++) {
+    if (tb) {
+      for (j = 0; j < nb; j++) dst[j] = b[j0 + j][p0 + p];
+    } else {
+      memcpy(dst, b[p0 + p] + j0, sizeof(float) * nb);
+    }
+
+    if (nb < nr) memset(dst + nb, 0, sizeof(float) * (nr - nb));
+
+    dst += nr;
+  }
+}
+
+/*
+ * マイクロカーネルの出力タイルをCに書き戻す
+ */
+static void
+store_tile(float** c, int i0, int j0, int mb, int nb, int nr,
+           float* t, float alpha, float beta)
+{
+  int i;
+  int j;
+  float* d;
+
+  for (i = 0; i < mb; i++) {
+    d = c[i0 + i] + j0;
+
+    if (beta == 0.0f) {
+      for (j = 0; j < nb; j++) d[j] = alpha * t[j];
+
+    } else if (beta == 1.0f) {
+      for (j = 0; j < nb; j++) d[j] += alpha * t[j];
+
+    } else {
+      for (j = 0; j < nb; j++) d[j] = (beta * d[j]) + (alpha * t[j]);
+    }
+
+    t += nr;
+  }
+}
+
+static void
+scale(float** c, int m, int n, float beta)
+{
+  int i;
+  int j;
+
+  for (i = 0; i < m; i++) {
+    if (beta == 0.0f) {
+      memset(c[i], 0, sizeof(float) * n);
+
+    } else {
+      for (j = 0; j < n; j++) c[i][j] *= beta;
+    }
+  }
+}
+
+/*
+ * 処理中のブロックの情報 (並列化した各処理に渡す)
+ */
+typedef struct {
+  const kernel_t* kn;
+
+  float** a;
+  int ta;
+  float** b;
+  int tb;
+  float** c;
+  float alpha;
+  float bt;     // 処理中のブロックに適用するbeta
+
+  float* ap;
+  float* bp;
+
+  int m;
+  int jc;
+  int pc;
+  int nb;       // 処理中のBブロックの列数
+  int kb;       // 処理中のブロックの内積方向の長さ
+
+  int npb;      // Bブロックのパネル数(nr列単位)
+  int nmc;      // Aの行ブロック数(mc行単位)
+} block_t;
+
+/*
+ * パッキング
+ *  [0, npb)はBのnr列ごとのパネル、それ以降はAのmr行ごとのパネルを表す。
+ */
+static void
+pack_range(void* arg, long i0, long i1)
+{
+  block_t* bk;
+  long x;
+  int mr;
+  int nr;
+  int i;
+
+  bk = (block_t*)arg;
+  mr = bk->kn->mr;
+  nr = bk->kn->nr;
+
+  for (x = i0; x < i1; x++) {
+    if (x < bk->npb) {
+      i = (int)x * nr;
+      pack_b(bk->bp + (i * bk->kb), bk->b, bk->tb, bk->pc, bk->kb,
+             bk->jc + i, MIN(nr, bk->nb - i), nr);
+
+    } else {
+      i = (int)(x - bk->npb) * mr;
+      pack_a(bk->ap + (i * bk->kb), bk->a, bk->ta, i, MIN(mr, bk->m - i),
+             bk->pc, bk->kb, mr);
+    }
+  }
+}
+
+/*
+ * タイルの計算
+ *  Aの行ブロック(mc行)とBのパネル(nr列)の組を一つの単位とする。
+ */
+static void
+tile_range(void* arg, long i0, long i1)
+{
+  block_t* bk;
+  const kernel_t* kn;
+  long x;
+  int ic;
+  int jr;
+  int ir;
+  int m;
+
+  float t[MAX_TILE] __attribute__((aligned(ALIGN_BYTES)));
+
+  bk = (block_t*)arg;
+  kn = bk->kn;
+  m  = bk->m;
+
+  for (x = i0; x < i1; x++) {
+    ic = (int)(x / bk->npb) * kn->mc;
+    jr = (int)(x % bk->npb) * kn->nr;
+
+    for (ir = ic; ir < MIN(ic + kn->mc, m); ir += kn->mr) {
+      kn->gemm(bk->kb, bk->ap + (ir * bk->kb), bk->bp + (jr * bk->kb), t);
+
+      store_tile(bk->c, ir, bk->jc + jr,
+                 MIN(kn->mr, m - ir), MIN(kn->nr, bk->nb - jr), kn->nr,
+                 t, bk->alpha, bk->bt);
+    }
+  }
+}
+
+int
+cmat_gemm_driver(int m, int n, int k,
+                 float alpha, float** a, int ta, float** b, int tb,
+                 float beta, float** c)
+{
+  int ret;
+  const kernel_t* kn;
+
+  float* ap;    // as "packed A"
+  float* bp;    // as "packed B"
+  size_t asz;   // パックしたAの大きさ(バイト数)
+  size_t bsz;   // パックしたBの大きさ(バイト数)
+  int own;      // パッキング用の領域を自前で確保した場合は!0
+  block_t bk;
+
+  int mr;
+  int nr;
+  int mc;
+  int kc;
+  int nc;
+
+  int jc;
+  int pc;
+  int nt;       // 処理中のブロックの並列化に使うスレッド数
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  kn  = cmat_kernel;
+  ap  = NULL;
+  bp  = NULL;
+  own = 0;
+
+  mr  = kn->mr;
+  nr  = kn->nr;
+  mc  = kn->mc;
+  kc  = kn->kc;
+  nc  = kn->nc;
+
+  /*
+   * check trivial case
+   */
+  if (m <= 0 || n <= 0) goto out;
+
+  if (k <= 0 || alpha == 0.0f) {
+    if (beta != 1.0f) scale(c, m, n, beta);
+    goto out;
+  }
+
+  /*
+   * alloc packing buffer
+   *  実行コンテキストが指定されている場合はその作業領域を使う
+   */
+  asz = ROUND_UP(sizeof(float) * ROUND_UP(m, mr) * kc, ALIGN_BYTES);
+  bsz = sizeof(float) * ROUND_UP(MIN(n, nc), nr) * kc;
+  ap  = (float*)cmat_ctx_scratch(asz + bsz);
+
+  if (ap) {
+    bp = (float*)((char*)ap + asz);
+
+  } else do {
+    own = !0;
+
+    ap  = (float*)alloc_aligned(asz);
+    if (ap == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+
+    bp  = (float*)alloc_aligned(bsz);
+    if (bp == NULL) {
+      ret = CMAT_ERR_NOMEM;
+      break;
+    }
+  } while (0);
+
+  /*
+   * do blocked multiplication
+   */
+  if (!ret) {
+    bk.kn    = kn;
+    bk.a     = a;
+    bk.ta    = ta;
+    bk.b     = b;
+    bk.tb    = tb;
+    bk.c     = c;
+    bk.alpha = alpha;
+    bk.ap    = ap;
+    bk.bp    = bp;
+    bk.m     = m;
+    bk.nmc   = (m + mc - 1) / mc;
+
+    for (jc = 0; jc < n; jc += nc) {
+      bk.jc  = jc;
+      bk.nb  = MIN(nc, n - jc);
+      bk.npb = (bk.nb + nr - 1) / nr;
+
+      for (pc = 0; pc < k; pc += kc) {
+        bk.pc = pc;
+        bk.kb = MIN(kc, k - pc);
+        bk.bt = (pc == 0)? beta: 1.0f;
+
+        nt = cmat_ctx_threads((long)m * bk.nb * bk.kb, PARALLEL_MIN);
+
+        cmat_parallel_for(bk.npb + ((m + mr - 1) / mr), nt, pack_range, &bk);
+        cmat_parallel_for((long)bk.nmc * bk.npb, nt, tile_range, &bk);
+      }
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (own) {
+    if (ap) free(ap);
+    if (bp) free(bp);
+  }
+
+  out:
+  return ret;
+}
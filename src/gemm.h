@@ -0,0 +1,21 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_MATRIX_GEMM_H__
+#define __CHEAP_MATRIX_GEMM_H__
+
+/*
+ * c[m x n] = alpha * (op(a)[m x k] * op(b)[k x n]) + beta * c[m x n]
+ *
+ * 各行列は行ポインタの配列で渡す。ta,tbが0以外の場合はそれぞれa,bを転置
+ * したもの(op(a) = a^T, op(b) = b^T)として扱う。cはa,bと重なっていては
+ * ならない。
+ */
+int cmat_gemm_driver(int m, int n, int k,
+                     float alpha, float** a, int ta, float** b, int tb,
+                     float beta, float** c);
+
+#endif /* !defined(__CHEAP_MATRIX_GEMM_H__) */
@@ -0,0 +1,905 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * 演算グラフ
+ *
+ *  演算の並びを一度記録しておき、入力を入れ替えながら繰り返し実行する。
+ *  ノードは入力または演算で、それぞれが一つの行列を出力する(ノード番号が
+ *  そのまま値の識別子になる)。記録は常に既存のノードを参照するので、記録
+ *  順がそのままトポロジカル順になる。
+ *
+ *  最初の実行の前に以下を計画する(束縛を変えるまで再利用する)。
+ *
+ *   - 出力先が束縛されておらず、他からも参照されないノードは実行しない
+ *   - 中間結果のバッファは同じ形状のものを使い回す。値の最後の参照が済ん
+ *     だバッファを再利用するノードには、その値を参照する全てのノードから
+ *     の依存を追加する(実行順が入れ替わって上書きしないように)
+ *   - 出力先が束縛されたノードは、束縛された行列に直接書き込む
+ *
+ *  実行時は先行ノードが全て完了したノードから順にタスクとしてスケジューラ
+ *  に投入する。演算全体を区切る同期は無く、独立したノードと各演算の内部
+ *  の並列処理(タイル)は同じスケジューラの上で混在して処理される。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmat.h"
+#include "ctx.h"
+#include "parallel.h"
+
+#define GROW(n)             ((n * 13) / 10)
+
+#define OP_INPUT            0
+#define OP_ADD              1
+#define OP_SUB              2
+#define OP_MUL              3
+#define OP_PRODUCT          4
+#define OP_TRANSPOSE        5
+#define OP_INVERSE          6
+
+typedef struct {
+  int op;                   // OP_*
+  int a;                    // オペランドのノード番号(無い場合は-1)
+  int b;
+  float v;                  // スカラー積の係数
+
+  int rows;                 // 出力の形状
+  int cols;
+
+  cmat_t* bind;             // 束縛された行列(入力または出力先)
+  cmat_t* out;              // 実行時の出力
+  cmat_ctx_t* ctx;          // 実行に使うコンテキスト(作業領域を再利用する)
+
+  /* 計画 */
+  int live;                 // 実行する(入力の場合は参照される)場合は!0
+  int last;                 // 出力を最後に参照するノード
+  int buf;                  // 割り当てたバッファ(無い場合は-1)
+
+  int* succ;                // 後続ノード
+  int nsucc;
+  int csucc;
+  int ndep;                 // 先行ノードの数
+
+  /* 実行時 */
+  int pending;              // 完了していない先行ノードの数
+  cmat_graph_t* graph;
+} node_t;
+
+typedef struct {
+  cmat_t* mat;
+  int owner;                // 現在の値を出力するノード
+  int free;                 // 再利用できる場合は!0
+} buf_t;
+
+struct __cmat_graph__ {
+  node_t* node;
+  int n;
+  int capa;
+
+  buf_t* buf;
+  int nbuf;
+
+  int planned;              // 計画済みの場合は!0
+
+  cmat_ctx_t* ctx;          // 実行時のコンテキスト
+  cmat_task_group_t grp;
+  int err;                  // 実行時に最初に発生したエラー
+};
+
+static int
+add_edge(cmat_graph_t* ptr, int from, int to)
+{
+  int ret;
+  node_t* nd;
+  int* succ;
+  int capa;
+
+  ret = 0;
+  nd  = ptr->node + from;
+
+  if (nd->nsucc == nd->csucc) {
+    capa = (nd->csucc < 4)? 4: GROW(nd->csucc);
+    succ = (int*)realloc(nd->succ, sizeof(int) * capa);
+
+    if (succ == NULL) {
+      ret = CMAT_ERR_NOMEM;
+    } else {
+      nd->succ  = succ;
+      nd->csucc = capa;
+    }
+  }
+
+  if (!ret) {
+    nd->succ[nd->nsucc++] = to;
+    ptr->node[to].ndep++;
+  }
+
+  return ret;
+}
+
+static void
+clear_plan(cmat_graph_t* ptr)
+{
+  node_t* nd;
+  int i;
+
+  for (i = 0; i < ptr->n; i++) {
+    nd = ptr->node + i;
+
+    if (nd->succ) free(nd->succ);
+
+    nd->succ  = NULL;
+    nd->nsucc = 0;
+    nd->csucc = 0;
+    nd->ndep  = 0;
+    nd->live  = 0;
+    nd->last  = -1;
+    nd->buf   = -1;
+    nd->out   = NULL;
+  }
+
+  for (i = 0; i < ptr->nbuf; i++) {
+    cmat_destroy(ptr->buf[i].mat);
+  }
+
+  if (ptr->buf) free(ptr->buf);
+
+  ptr->buf     = NULL;
+  ptr->nbuf    = 0;
+  ptr->planned = 0;
+}
+
+static int
+is_temp(node_t* nd)
+{
+  return (nd->op != OP_INPUT && nd->bind == NULL);
+}
+
+/*
+ * 中間結果のバッファの割り当て
+ *  値の参照が済んだ同じ形状のバッファがあれば再利用し、その値を参照した
+ *  ノードからidへの依存を追加する。
+ */
+static int
+assign_buffer(cmat_graph_t* ptr, int id)
+{
+  int ret;
+  node_t* nd;
+  node_t* rd;
+  buf_t* bp;
+  int i;
+  int j;
+
+  ret = 0;
+  nd  = ptr->node + id;
+
+  for (i = 0; i < ptr->nbuf; i++) {
+    bp = ptr->buf + i;
+
+    if (bp->free && bp->mat->rows == nd->rows && bp->mat->cols == nd->cols) {
+      for (j = bp->owner + 1; !ret && j < id; j++) {
+        rd = ptr->node + j;
+
+        if (rd->live && (rd->a == bp->owner || rd->b == bp->owner)) {
+          ret = add_edge(ptr, j, id);
+        }
+      }
+
+      break;
+    }
+  }
+
+  if (!ret && i == ptr->nbuf) {
+    bp = (buf_t*)realloc(ptr->buf, sizeof(buf_t) * (ptr->nbuf + 1));
+
+    if (bp == NULL) {
+      ret = CMAT_ERR_NOMEM;
+
+    } else {
+      ptr->buf = bp;
+      ret = cmat_new(NULL, nd->rows, nd->cols, &ptr->buf[i].mat);
+      if (!ret) ptr->nbuf++;
+    }
+  }
+
+  if (!ret) {
+    ptr->buf[i].owner = id;
+    ptr->buf[i].free  = 0;
+
+    nd->buf = i;
+    nd->out = ptr->buf[i].mat;
+  }
+
+  return ret;
+}
+
+/*
+ * 実行計画の作成
+ */
+static int
+make_plan(cmat_graph_t* ptr)
+{
+  int ret;
+  node_t* nd;
+  int opr[2];
+  int i;
+  int j;
+
+  ret = 0;
+
+  clear_plan(ptr);
+
+  /*
+   * mark live nodes
+   *  出力先が束縛されたノードと、実行するノードが参照するノード
+   */
+  for (i = ptr->n - 1; i >= 0; i--) {
+    nd = ptr->node + i;
+
+    if (nd->op != OP_INPUT && nd->bind) nd->live = !0;
+
+    if (nd->live) {
+      if (nd->a >= 0) ptr->node[nd->a].live = !0;
+      if (nd->b >= 0) ptr->node[nd->b].live = !0;
+    }
+  }
+
+  /*
+   * find last reference
+   */
+  for (i = 0; i < ptr->n; i++) {
+    nd = ptr->node + i;
+
+    if (nd->live && nd->op != OP_INPUT) {
+      if (nd->a >= 0) ptr->node[nd->a].last = i;
+      if (nd->b >= 0) ptr->node[nd->b].last = i;
+    }
+  }
+
+  /*
+   * assign buffers and build dependencies
+   */
+  for (i = 0; !ret && i < ptr->n; i++) {
+    nd = ptr->node + i;
+
+    if (!nd->live || nd->op == OP_INPUT) continue;
+
+    if (nd->ctx == NULL) {
+      ret = cmat_ctx_new(&nd->ctx);
+      if (ret) break;
+    }
+
+    if (is_temp(nd)) {
+      ret = assign_buffer(ptr, i);
+      if (ret) break;
+    }
+
+    opr[0] = nd->a;
+    opr[1] = (nd->b != nd->a)? nd->b: -1;
+
+    for (j = 0; !ret && j < 2; j++) {
+      if (opr[j] < 0 || ptr->node[opr[j]].op == OP_INPUT) continue;
+
+      ret = add_edge(ptr, opr[j], i);
+
+      /* 最後の参照が済んだ値のバッファは再利用できる */
+      if (ptr->node[opr[j]].last == i && ptr->node[opr[j]].buf >= 0) {
+        ptr->buf[ptr->node[opr[j]].buf].free = !0;
+      }
+    }
+  }
+
+  if (!ret) {
+    ptr->planned = !0;
+  } else {
+    clear_plan(ptr);
+  }
+
+  return ret;
+}
+
+/*
+ * ノードの実行(スケジューラのタスク)
+ */
+static void
+run_node(void* arg)
+{
+  node_t* nd;
+  node_t* nodes;
+  cmat_graph_t* g;
+  cmat_ctx_t* org;
+  cmat_t* a;
+  cmat_t* b;
+  int ret;
+  int z;
+  int i;
+
+  nd    = (node_t*)arg;
+  g     = nd->graph;
+  nodes = g->node;
+  ret   = 0;
+
+  if (!__atomic_load_n(&g->err, __ATOMIC_ACQUIRE)) {
+    a   = (nd->a >= 0)? nodes[nd->a].out: NULL;
+    b   = (nd->b >= 0)? nodes[nd->b].out: NULL;
+    org = cmat_ctx_enter(nd->ctx);
+
+    switch (nd->op) {
+    case OP_ADD:
+      ret = cmat_add_into(a, b, nd->out);
+      break;
+
+    case OP_SUB:
+      ret = cmat_sub_into(a, b, nd->out);
+      break;
+
+    case OP_MUL:
+      ret = cmat_mul_into(a, nd->v, nd->out);
+      break;
+
+    case OP_PRODUCT:
+      ret = cmat_product_into(a, b, nd->out);
+      break;
+
+    case OP_TRANSPOSE:
+      ret = cmat_transpose_into(a, nd->out);
+      break;
+
+    case OP_INVERSE:
+      ret = cmat_inverse_into(a, nd->out);
+      break;
+    }
+
+    cmat_ctx_leave(org);
+
+    if (ret) {
+      z = 0;
+      __atomic_compare_exchange_n(&g->err, &z, ret, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+  }
+
+  /*
+   * release successors
+   */
+  for (i = 0; i < nd->nsucc; i++) {
+    if (__atomic_sub_fetch(&nodes[nd->succ[i]].pending, 1,
+                           __ATOMIC_ACQ_REL) == 0) {
+      cmat_task_spawn(&g->grp, run_node, nodes + nd->succ[i]);
+    }
+  }
+}
+
+/*
+ * ノードの追加
+ */
+static int
+add_node(cmat_graph_t* ptr, int op, int a, int b, float v, int rows,
+         int cols, int* dst)
+{
+  int ret;
+  node_t* node;
+  node_t* nd;
+  int capa;
+
+  ret = 0;
+
+  if (ptr->n == ptr->capa) {
+    capa = (ptr->capa < 16)? 16: GROW(ptr->capa);
+    node = (node_t*)realloc(ptr->node, sizeof(node_t) * capa);
+
+    if (node == NULL) {
+      ret = CMAT_ERR_NOMEM;
+    } else {
+      ptr->node = node;
+      ptr->capa = capa;
+    }
+  }
+
+  if (!ret) {
+    nd = ptr->node + ptr->n;
+    memset(nd, 0, sizeof(node_t));
+
+    nd->op    = op;
+    nd->a     = a;
+    nd->b     = b;
+    nd->v     = v;
+    nd->rows  = rows;
+    nd->cols  = cols;
+    nd->last  = -1;
+    nd->buf   = -1;
+    nd->graph = ptr;
+
+    *dst = ptr->n++;
+
+    /* 新しいノードは束縛されていないので計画は変わらない */
+  }
+
+  return ret;
+}
+
+/*
+ * 演算ノードの記録の共通部
+ *  a, bの妥当性と形状を確認して出力の形状を決め、ノードを追加する。
+ */
+static int
+record(cmat_graph_t* ptr, int op, int a, int b, float v, int* dst)
+{
+  int ret;
+  node_t* na;
+  node_t* nb;
+  int rows;
+  int cols;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  na  = NULL;
+  nb  = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (a < 0 || a >= ptr->n) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    if (b >= ptr->n || (b < 0 && (op == OP_ADD || op == OP_SUB ||
+                                  op == OP_PRODUCT))) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    na = ptr->node + a;
+    nb = (b >= 0)? ptr->node + b: NULL;
+  } while (0);
+
+  /*
+   * check shape
+   */
+  if (!ret) {
+    rows = na->rows;
+    cols = na->cols;
+
+    switch (op) {
+    case OP_ADD:
+    case OP_SUB:
+      if (na->rows != nb->rows || na->cols != nb->cols) ret = CMAT_ERR_SHAPE;
+      break;
+
+    case OP_PRODUCT:
+      if (na->cols != nb->rows) ret = CMAT_ERR_SHAPE;
+      cols = nb->cols;
+      break;
+
+    case OP_TRANSPOSE:
+      rows = na->cols;
+      cols = na->rows;
+      break;
+
+    case OP_INVERSE:
+      if (na->rows != na->cols) ret = CMAT_ERR_SHAPE;
+      break;
+    }
+  }
+
+  /*
+   * append node
+   */
+  if (!ret) {
+    ret = add_node(ptr, op, a, b, v, rows, cols, dst);
+  }
+
+  return ret;
+}
+
+/**
+ * 演算グラフの生成
+ *
+ * @param dst   生成したグラフの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_new(cmat_graph_t** dst)
+{
+  int ret;
+  cmat_graph_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    obj = (cmat_graph_t*)malloc(sizeof(cmat_graph_t));
+    if (obj == NULL) ret = CMAT_ERR_NOMEM;
+  }
+
+  if (!ret) {
+    memset(obj, 0, sizeof(cmat_graph_t));
+
+    ret = cmat_ctx_new(&obj->ctx);
+    if (ret) free(obj);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * 演算グラフの削除
+ *
+ * @param ptr   削除するグラフ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 束縛された行列は削除しない。
+ */
+int
+cmat_graph_destroy(cmat_graph_t* ptr)
+{
+  int ret;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    clear_plan(ptr);
+
+    for (i = 0; i < ptr->n; i++) {
+      if (ptr->node[i].ctx) cmat_ctx_destroy(ptr->node[i].ctx);
+    }
+
+    if (ptr->node) free(ptr->node);
+    cmat_ctx_destroy(ptr->ctx);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+/**
+ * 入力ノードの追加
+ *
+ * @param ptr   対象のグラフ
+ * @param rows  入力する行列の行数
+ * @param cols  入力する行列の列数
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 実行前にcmat_graph_bind()で行列を束縛すること。
+ */
+int
+cmat_graph_input(cmat_graph_t* ptr, int rows, int cols, int* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (rows <= 0 || cols <= 0) {
+      ret = CMAT_ERR_BSIZE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * append node
+   */
+  if (!ret) {
+    ret = add_node(ptr, OP_INPUT, -1, -1, 0.0f, rows, cols, dst);
+  }
+
+  return ret;
+}
+
+/**
+ * 行列の和の記録 (a + b)
+ *
+ * @param ptr   対象のグラフ
+ * @param a     オペランドのノード番号
+ * @param b     オペランドのノード番号
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_add(cmat_graph_t* ptr, int a, int b, int* dst)
+{
+  return record(ptr, OP_ADD, a, b, 0.0f, dst);
+}
+
+/**
+ * 行列の差の記録 (a - b)
+ *
+ * @param ptr   対象のグラフ
+ * @param a     オペランドのノード番号
+ * @param b     オペランドのノード番号
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_sub(cmat_graph_t* ptr, int a, int b, int* dst)
+{
+  return record(ptr, OP_SUB, a, b, 0.0f, dst);
+}
+
+/**
+ * スカラー積の記録 (a * v)
+ *
+ * @param ptr   対象のグラフ
+ * @param a     オペランドのノード番号
+ * @param v     係数
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_mul(cmat_graph_t* ptr, int a, float v, int* dst)
+{
+  return record(ptr, OP_MUL, a, -1, v, dst);
+}
+
+/**
+ * 行列の積の記録 (a * b)
+ *
+ * @param ptr   対象のグラフ
+ * @param a     オペランドのノード番号
+ * @param b     オペランドのノード番号
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_product(cmat_graph_t* ptr, int a, int b, int* dst)
+{
+  return record(ptr, OP_PRODUCT, a, b, 0.0f, dst);
+}
+
+/**
+ * 転置の記録 (a^T)
+ *
+ * @param ptr   対象のグラフ
+ * @param a     オペランドのノード番号
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_transpose(cmat_graph_t* ptr, int a, int* dst)
+{
+  return record(ptr, OP_TRANSPOSE, a, -1, 0.0f, dst);
+}
+
+/**
+ * 逆行列の記録 (a^-1)
+ *
+ * @param ptr   対象のグラフ
+ * @param a     オペランドのノード番号
+ * @param dst   追加したノードの番号の格納先
+ *
+ * @return エラーコード(0で正常終了)
+ */
+int
+cmat_graph_inverse(cmat_graph_t* ptr, int a, int* dst)
+{
+  return record(ptr, OP_INVERSE, a, -1, 0.0f, dst);
+}
+
+/**
+ * 行列の束縛
+ *
+ * @param ptr   対象のグラフ
+ * @param id    ノードの番号
+ * @param mat   束縛する行列(NULLで解除)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 入力ノードに束縛した行列は実行時に読み込み、演算ノードに束縛した
+ *       行列には実行時に結果を書き込む(結果を取り出すノードには必ず束縛
+ *       すること)。matの形状はノードと同じでなければならない。演算ノー
+ *       ドの束縛の有無を変えた場合は次の実行時に計画を作り直す。
+ */
+int
+cmat_graph_bind(cmat_graph_t* ptr, int id, cmat_t* mat)
+{
+  int ret;
+  node_t* nd;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  nd  = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (id < 0 || id >= ptr->n) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+
+    nd = ptr->node + id;
+
+    if (mat && (mat->rows != nd->rows || mat->cols != nd->cols)) {
+      ret = CMAT_ERR_SHAPE;
+      break;
+    }
+  } while (0);
+
+  /*
+   * update node
+   */
+  if (!ret) {
+    if (nd->op != OP_INPUT && (nd->bind == NULL) != (mat == NULL)) {
+      ptr->planned = 0;
+    }
+
+    nd->bind = mat;
+  }
+
+  return ret;
+}
+
+/**
+ * 演算グラフの実行
+ *
+ * @param ctx   実行コンテキスト(NULLの場合は既定値)
+ * @param ptr   対象のグラフ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 全ての演算が完了するまで戻らない。いずれかの演算がエラーになった
+ *       場合は最初のエラーを返す(その時点で未実行の演算は実行しない)。
+ *       コンテキストにスケジューラが設定されていない場合はライブラリ既定
+ *       のスケジューラを使用する。同じグラフを複数のスレッドで同時に実行
+ *       してはならない。
+ */
+int
+cmat_graph_execute(cmat_ctx_t* ctx, cmat_graph_t* ptr)
+{
+  int ret;
+  cmat_ctx_t* org;
+  node_t* nd;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * make plan
+   */
+  if (!ret && !ptr->planned) {
+    ret = make_plan(ptr);
+  }
+
+  /*
+   * check inputs
+   */
+  for (i = 0; !ret && i < ptr->n; i++) {
+    nd = ptr->node + i;
+
+    if (nd->live && nd->op == OP_INPUT && nd->bind == NULL) {
+      ret = CMAT_ERR_INVAL;
+    }
+  }
+
+  /*
+   * setup context
+   */
+  if (!ret) {
+    cmat_ctx_copy(ptr->ctx, ctx);
+
+    org = cmat_ctx_enter(ptr->ctx);
+    if (cmat_ctx_sched() == NULL) {
+      cmat_ctx_set_sched(ptr->ctx, cmat_sched_default());
+    }
+    cmat_ctx_leave(org);
+
+    for (i = 0; i < ptr->n; i++) {
+      nd = ptr->node + i;
+
+      if (nd->bind) nd->out = nd->bind;
+      if (nd->ctx) cmat_ctx_copy(nd->ctx, ptr->ctx);
+
+      nd->pending = nd->ndep;
+    }
+
+    ptr->err         = 0;
+    ptr->grp.pending = 0;
+  }
+
+  /*
+   * execute nodes
+   */
+  if (!ret) {
+    org = cmat_ctx_enter(ptr->ctx);
+
+    for (i = 0; i < ptr->n; i++) {
+      nd = ptr->node + i;
+
+      if (nd->live && nd->op != OP_INPUT && nd->ndep == 0) {
+        cmat_task_spawn(&ptr->grp, run_node, nd);
+      }
+    }
+
+    cmat_task_wait(&ptr->grp);
+    cmat_ctx_leave(org);
+
+    ret = ptr->err;
+  }
+
+  return ret;
+}
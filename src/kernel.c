@@ -0,0 +1,170 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ENABLE_NEON) && defined(__linux__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif /* defined(ENABLE_NEON) && defined(__linux__) && ... */
+
+#include "cmat.h"
+#include "kernel.h"
+
+#define ENV_SIMD_LEVEL      "CMAT_SIMD_LEVEL"
+#define ENV_PAD_WIDTH       "CMAT_PAD_WIDTH"
+
+#define MAX_PAD_WIDTH       16
+
+/*
+ * 選択可能なカーネルの一覧(性能の低い順に並べること)
+ */
+static const kernel_t* table[] = {
+  &cmat_kernel_scalar,
+#ifdef ENABLE_SSE42
+  &cmat_kernel_sse42,
+#endif /* defined(ENABLE_SSE42) */
+#ifdef ENABLE_AVX2
+  &cmat_kernel_avx2,
+#endif /* defined(ENABLE_AVX2) */
+#ifdef ENABLE_AVX512
+  &cmat_kernel_avx512,
+#endif /* defined(ENABLE_AVX512) */
+#ifdef ENABLE_NEON
+  &cmat_kernel_neon,
+#endif /* defined(ENABLE_NEON) */
+  NULL
+};
+
+/*
+ * 現在選択されているカーネル
+ *  (kernel_init()が呼ばれるまではスカラー実装を使用する)
+ */
+const kernel_t* cmat_kernel = &cmat_kernel_scalar;
+
+/*
+ * 行列の行のパディング単位(float数)
+ *  (ストライドはこの値の倍数に切り上げる)
+ */
+int cmat_pad_width = 4;
+
+static int
+is_supported(const kernel_t* k)
+{
+  int ret;
+
+  switch (k->level) {
+  case CMAT_SIMD_SCALAR:
+    ret = !0;
+    break;
+
+#ifdef ENABLE_SSE42
+  case CMAT_SIMD_SSE42:
+    ret = __builtin_cpu_supports("sse4.2");
+    break;
+#endif /* defined(ENABLE_SSE42) */
+
+#ifdef ENABLE_AVX2
+  case CMAT_SIMD_AVX2:
+    ret = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    break;
+#endif /* defined(ENABLE_AVX2) */
+
+#ifdef ENABLE_AVX512
+  case CMAT_SIMD_AVX512:
+    ret = __builtin_cpu_supports("avx512f");
+    break;
+#endif /* defined(ENABLE_AVX512) */
+
+#ifdef ENABLE_NEON
+  case CMAT_SIMD_NEON:
+#if defined(__aarch64__)
+    /* AArch64ではASIMD(NEON)は必須 */
+    ret = !0;
+#elif defined(__linux__)
+    ret = (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else /* defined(__aarch64__) */
+    ret = !0;
+#endif /* defined(__aarch64__) */
+    break;
+#endif /* defined(ENABLE_NEON) */
+
+  default:
+    ret = 0;
+    break;
+  }
+
+  return ret;
+}
+
+/*
+ * パディング単位の決定
+ *
+ * 選択したカーネルのベクトル幅の倍数で、MAX_PAD_WIDTH(キャッシュライン
+ * 幅)以下の値のみ受け付ける。
+ */
+static int
+pad_width(const kernel_t* k, const char* env)
+{
+  int ret;
+  int v;
+
+  ret = k->pad;
+
+  if (env != NULL) {
+    v = atoi(env);
+
+    if (v > 0 && v <= MAX_PAD_WIDTH && (v & (v - 1)) == 0 &&
+        (v % k->width) == 0) {
+      ret = v;
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * カーネルの選択
+ *
+ * 実行中のCPUで使用可能な最も高速なカーネルを選択する。環境変数
+ * CMAT_SIMD_LEVELにカーネル名(scalar, sse42, avx2, avx512, neon)が指定
+ * されている場合は、そのカーネルが使用可能であればそれを優先する。
+ *
+ * 行のパディング単位はカーネルごとの既定値を使用する。環境変数
+ * CMAT_PAD_WIDTHで変更できる(4, 8, 16など)。
+ */
+static void __attribute__((constructor))
+kernel_init(void)
+{
+  const kernel_t* sel;
+  const char* env;
+  int i;
+
+#if defined(ENABLE_SSE42) || defined(ENABLE_AVX2) || defined(ENABLE_AVX512)
+  __builtin_cpu_init();
+#endif /* defined(ENABLE_SSE42) || defined(ENABLE_AVX2) || ... */
+
+  sel = &cmat_kernel_scalar;
+
+  for (i = 0; table[i] != NULL; i++) {
+    if (is_supported(table[i])) sel = table[i];
+  }
+
+  env = getenv(ENV_SIMD_LEVEL);
+
+  if (env != NULL) {
+    for (i = 0; table[i] != NULL; i++) {
+      if (!strcmp(table[i]->name, env) && is_supported(table[i])) {
+        sel = table[i];
+        break;
+      }
+    }
+  }
+
+  cmat_kernel    = sel;
+  cmat_pad_width = pad_width(sel, getenv(ENV_PAD_WIDTH));
+}
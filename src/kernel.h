@@ -0,0 +1,117 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_MATRIX_KERNEL_H__
+#define __CHEAP_MATRIX_KERNEL_H__
+
+/*
+ * 演算カーネルのディスパッチテーブル
+ *
+ * 各カーネルは1行分(n要素)の演算を行う。nはベクトル幅の倍数である必要は
+ * 無く、端数は各カーネルで処理する。
+ */
+typedef struct {
+  int level;              // CMAT_SIMD_*
+  const char* name;       // CMAT_SIMD_LEVELで指定する名前
+  int width;              // ベクトル幅(float数)
+  int pad;                // 行のパディング単位(float数)
+
+  /* d = s + o */
+  void (*add)(float* d, float* s, float* o, int n);
+
+  /* d = s - o */
+  void (*sub)(float* d, float* s, float* o, int n);
+
+  /* d = s * v */
+  void (*mul)(float* d, float* s, float v, int n);
+
+  /*
+   * add, sub, mulの非テンポラルストア版
+   *  d, s, oはベクトル幅の境界に揃っていること。キャッシュに収まらない大
+   *  きさの結果を書き出す場合に使用する。
+   */
+  void (*add_nt)(float* d, float* s, float* o, int n);
+  void (*sub_nt)(float* d, float* s, float* o, int n);
+  void (*mul_nt)(float* d, float* s, float v, int n);
+
+  /* d = d - (s * v) */
+  void (*nmadd)(float* d, float* s, float v, int n);
+
+  /* Σ(s * o) */
+  float (*dot)(float* s, float* o, int n);
+
+  /* d[0..m) = Σ(s[i] * o[i][0..m))  (i = 0..n) */
+  void (*product)(float* d, float* s, float** o, int n, int m);
+
+  /*
+   * GEMMのブロッキングパラメータ
+   *  mr x nr  : マイクロカーネルのレジスタタイルの大きさ
+   *  mc,kc,nc : L2/L1/L3に収めるブロックの大きさ(mcはmr, ncはnrの倍数)
+   */
+  int mr;
+  int nr;
+  int mc;
+  int kc;
+  int nc;
+
+  /*
+   * GEMMマイクロカーネル
+   *  t[mr x nr] = a[mr x k] * b[k x nr]
+   *
+   *  aはmr行ごと、bはnr列ごとにパックされたパネル(gemm.c参照)で、tは
+   *  行優先で格納する。
+   */
+  void (*gemm)(int k, const float* a, const float* b, float* t);
+
+  /*
+   * 転置タイルカーネル
+   *  d[j][dc + i] = s[i][sc + j]  (i, j = 0..tw)
+   *
+   *  twはレジスタ上で転置するタイルの一辺(float数)。dとsの領域は重なって
+   *  いないこと。
+   */
+  int tw;
+  void (*transpose)(float** d, int dc, float** s, int sc);
+
+  /*
+   * バッチ演算カーネル(kernel_batch.h参照)
+   *  各行列要素の平面(n行列分)の配列を受け取り、行列方向にベクトル化して
+   *  処理する。
+   */
+
+  /* d[m x l] = a[m x k] * b[k x l] */
+  void (*batch_product)(float** d, float** a, float** b,
+                        int m, int k, int l, int n);
+
+  /* d = det(s)  (sz = 1..4) */
+  void (*batch_det)(float** s, float* d, int sz, int n);
+
+  /* d = s^-1, det = det(s)  (sz = 1..4) */
+  void (*batch_inverse)(float** s, float** d, float* det, int sz, int n);
+} kernel_t;
+
+extern const kernel_t cmat_kernel_scalar;
+
+#ifdef ENABLE_SSE42
+extern const kernel_t cmat_kernel_sse42;
+#endif /* defined(ENABLE_SSE42) */
+
+#ifdef ENABLE_AVX2
+extern const kernel_t cmat_kernel_avx2;
+#endif /* defined(ENABLE_AVX2) */
+
+#ifdef ENABLE_AVX512
+extern const kernel_t cmat_kernel_avx512;
+#endif /* defined(ENABLE_AVX512) */
+
+#ifdef ENABLE_NEON
+extern const kernel_t cmat_kernel_neon;
+#endif /* defined(ENABLE_NEON) */
+
+extern const kernel_t* cmat_kernel;
+extern int cmat_pad_width;
+
+#endif /* !defined(__CHEAP_MATRIX_KERNEL_H__) */
@@ -0,0 +1,392 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include "cmat.h"
+#include "kernel.h"
+
+#ifdef ENABLE_AVX2
+
+#if !defined(__AVX2__) || !defined(__FMA__)
+#error "x86 AVX2/FMA instruction set is not available."
+#endif /* !defined(__AVX2__) || !defined(__FMA__) */
+
+#include <immintrin.h>
+
+#include "kernel_batch.h"
+
+static inline float
+hsum(__m256 v8)
+{
+  __m128 v;
+
+  v = _mm_add_ps(_mm256_castps256_ps128(v8), _mm256_extractf128_ps(v8, 1));
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_movehdup_ps(v));
+
+  return _mm_cvtss_f32(v);
+}
+
+static void
+add(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(s + i),
+                                          _mm256_loadu_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] + o[i];
+  }
+}
+
+static void
+sub(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(d + i, _mm256_sub_ps(_mm256_loadu_ps(s + i),
+                                          _mm256_loadu_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] - o[i];
+  }
+}
+
+static void
+mul(float* d, float* s, float v, int n)
+{
+  int i;
+  __m256 vv;
+
+  vv = _mm256_set1_ps(v);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_loadu_ps(s + i), vv));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] * v;
+  }
+}
+
+/*
+ * 非テンポラルストア版(d, s, oは32バイト境界に揃っていること)
+ */
+static void
+add_nt(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_stream_ps(d + i, _mm256_add_ps(_mm256_load_ps(s + i),
+                                          _mm256_load_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] + o[i];
+  }
+
+  _mm_sfence();
+}
+
+static void
+sub_nt(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_stream_ps(d + i, _mm256_sub_ps(_mm256_load_ps(s + i),
+                                          _mm256_load_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] - o[i];
+  }
+
+  _mm_sfence();
+}
+
+static void
+mul_nt(float* d, float* s, float v, int n)
+{
+  int i;
+  __m256 vv;
+
+  vv = _mm256_set1_ps(v);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_stream_ps(d + i, _mm256_mul_ps(_mm256_load_ps(s + i), vv));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] * v;
+  }
+
+  _mm_sfence();
+}
+
+static void
+nmadd(float* d, float* s, float v, int n)
+{
+  int i;
+  __m256 vv;
+
+  vv = _mm256_set1_ps(v);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(d + i, _mm256_fnmadd_ps(_mm256_loadu_ps(s + i), vv,
+                                             _mm256_loadu_ps(d + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] -= s[i] * v;
+  }
+}
+
+static float
+dot(float* s, float* o, int n)
+{
+  float ret;
+  int i;
+  __m256 vd0;
+  __m256 vd1;
+  __m256 vd2;
+  __m256 vd3;
+
+  vd0 = _mm256_setzero_ps();
+  vd1 = _mm256_setzero_ps();
+  vd2 = _mm256_setzero_ps();
+  vd3 = _mm256_setzero_ps();
+
+  /*
+   * FMAのレイテンシを隠すために4本のアキュムレータで累積する
+   */
+  for (i = 0; i + 32 <= n; i += 32) {
+    vd0 = _mm256_fmadd_ps(_mm256_loadu_ps(s + i + 0),
+                          _mm256_loadu_ps(o + i + 0), vd0);
+    vd1 = _mm256_fmadd_ps(_mm256_loadu_ps(s + i + 8),
+                          _mm256_loadu_ps(o + i + 8), vd1);
+    vd2 = _mm256_fmadd_ps(_mm256_loadu_ps(s + i + 16),
+                          _mm256_loadu_ps(o + i + 16), vd2);
+    vd3 = _mm256_fmadd_ps(_mm256_loadu_ps(s + i + 24),
+                          _mm256_loadu_ps(o + i + 24), vd3);
+  }
+
+  for (; i + 8 <= n; i += 8) {
+    vd0 = _mm256_fmadd_ps(_mm256_loadu_ps(s + i), _mm256_loadu_ps(o + i), vd0);
+  }
+
+  ret = hsum(_mm256_add_ps(_mm256_add_ps(vd0, vd1), _mm256_add_ps(vd2, vd3)));
+
+  for (; i < n; i++) {
+    ret += s[i] * o[i];
+  }
+
+  return ret;
+}
+
+static void
+product(float* d, float* s, float** o, int n, int m)
+{
+  int c;
+  int i;
+  float* p;
+
+  __m256 vs;
+  __m256 vd0;
+  __m256 vd1;
+  __m256 vd2;
+  __m256 vd3;
+
+  /*
+   * 出力行の32列分(8列x4レジスタ)をレジスタ上で累積する
+   */
+  for (c = 0; c + 32 <= m; c += 32) {
+    vd0 = _mm256_setzero_ps();
+    vd1 = _mm256_setzero_ps();
+    vd2 = _mm256_setzero_ps();
+    vd3 = _mm256_setzero_ps();
+
+    for (i = 0; i < n; i++) {
+      vs  = _mm256_set1_ps(s[i]);
+      p   = o[i] + c;
+
+      vd0 = _mm256_fmadd_ps(vs, _mm256_loadu_ps(p + 0), vd0);
+      vd1 = _mm256_fmadd_ps(vs, _mm256_loadu_ps(p + 8), vd1);
+      vd2 = _mm256_fmadd_ps(vs, _mm256_loadu_ps(p + 16), vd2);
+      vd3 = _mm256_fmadd_ps(vs, _mm256_loadu_ps(p + 24), vd3);
+    }
+
+    _mm256_storeu_ps(d + c + 0, vd0);
+    _mm256_storeu_ps(d + c + 8, vd1);
+    _mm256_storeu_ps(d + c + 16, vd2);
+    _mm256_storeu_ps(d + c + 24, vd3);
+  }
+
+  for (; c + 8 <= m; c += 8) {
+    vd0 = _mm256_setzero_ps();
+
+    for (i = 0; i < n; i++) {
+      vs  = _mm256_set1_ps(s[i]);
+      vd0 = _mm256_fmadd_ps(vs, _mm256_loadu_ps(o[i] + c), vd0);
+    }
+
+    _mm256_storeu_ps(d + c, vd0);
+  }
+
+  for (; c < m; c++) {
+    d[c] = 0.0f;
+
+    for (i = 0; i < n; i++) {
+      d[c] += s[i] * o[i][c];
+    }
+  }
+}
+
+/*
+ * 6x16のマイクロカーネル(12レジスタで累積)
+ */
+static void
+gemm(int k, const float* a, const float* b, float* t)
+{
+  int p;
+  __m256 b0;
+  __m256 b1;
+  __m256 av;
+
+  __m256 c00, c01;
+  __m256 c10, c11;
+  __m256 c20, c21;
+  __m256 c30, c31;
+  __m256 c40, c41;
+  __m256 c50, c51;
+
+  c00 = c01 = _mm256_setzero_ps();
+  c10 = c11 = _mm256_setzero_ps();
+  c20 = c21 = _mm256_setzero_ps();
+  c30 = c31 = _mm256_setzero_ps();
+  c40 = c41 = _mm256_setzero_ps();
+  c50 = c51 = _mm256_setzero_ps();
+
+  for (p = 0; p < k; p++) {
+    b0  = _mm256_load_ps(b + 0);
+    b1  = _mm256_load_ps(b + 8);
+
+    av  = _mm256_broadcast_ss(a + 0);
+    c00 = _mm256_fmadd_ps(av, b0, c00);
+    c01 = _mm256_fmadd_ps(av, b1, c01);
+
+    av  = _mm256_broadcast_ss(a + 1);
+    c10 = _mm256_fmadd_ps(av, b0, c10);
+    c11 = _mm256_fmadd_ps(av, b1, c11);
+
+    av  = _mm256_broadcast_ss(a + 2);
+    c20 = _mm256_fmadd_ps(av, b0, c20);
+    c21 = _mm256_fmadd_ps(av, b1, c21);
+
+    av  = _mm256_broadcast_ss(a + 3);
+    c30 = _mm256_fmadd_ps(av, b0, c30);
+    c31 = _mm256_fmadd_ps(av, b1, c31);
+
+    av  = _mm256_broadcast_ss(a + 4);
+    c40 = _mm256_fmadd_ps(av, b0, c40);
+    c41 = _mm256_fmadd_ps(av, b1, c41);
+
+    av  = _mm256_broadcast_ss(a + 5);
+    c50 = _mm256_fmadd_ps(av, b0, c50);
+    c51 = _mm256_fmadd_ps(av, b1, c51);
+
+    a += 6;
+    b += 16;
+  }
+
+  _mm256_storeu_ps(t + 0, c00);
+  _mm256_storeu_ps(t + 8, c01);
+  _mm256_storeu_ps(t + 16, c10);
+  _mm256_storeu_ps(t + 24, c11);
+  _mm256_storeu_ps(t + 32, c20);
+  _mm256_storeu_ps(t + 40, c21);
+  _mm256_storeu_ps(t + 48, c30);
+  _mm256_storeu_ps(t + 56, c31);
+  _mm256_storeu_ps(t + 64, c40);
+  _mm256_storeu_ps(t + 72, c41);
+  _mm256_storeu_ps(t + 80, c50);
+  _mm256_storeu_ps(t + 88, c51);
+}
+
+/*
+ * 8x8の転置(レジスタ上で入れ替える)
+ */
+static void
+transpose(float** d, int dc, float** s, int sc)
+{
+  __m256 r[8];
+  __m256 t[8];
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    r[i] = _mm256_loadu_ps(s[i] + sc);
+  }
+
+  /* 隣接する2行の要素を交互に並べる */
+  for (i = 0; i < 8; i += 2) {
+    t[i + 0] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+    t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+  }
+
+  /* 4行分の要素を128ビットレーン内で揃える */
+  for (i = 0; i < 8; i += 4) {
+    r[i + 0] = _mm256_shuffle_ps(t[i + 0], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+    r[i + 1] = _mm256_shuffle_ps(t[i + 0], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+    r[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+    r[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+  }
+
+  /* 上下4行の128ビットレーンを組み合わせる */
+  for (i = 0; i < 4; i++) {
+    _mm256_storeu_ps(d[i + 0] + dc,
+                     _mm256_permute2f128_ps(r[i], r[i + 4], 0x20));
+    _mm256_storeu_ps(d[i + 4] + dc,
+                     _mm256_permute2f128_ps(r[i], r[i + 4], 0x31));
+  }
+}
+
+const kernel_t cmat_kernel_avx2 = {
+  CMAT_SIMD_AVX2,
+  "avx2",
+  8,
+  8,
+
+  add,
+  sub,
+  mul,
+  add_nt,
+  sub_nt,
+  mul_nt,
+  nmadd,
+  dot,
+  product,
+
+  6,          // mr
+  16,         // nr
+  72,         // mc
+  256,        // kc
+  4080,       // nc
+
+  gemm,
+
+  8,          // tw
+  transpose,
+
+  batch_product,
+  batch_det,
+  batch_inverse,
+};
+#endif /* defined(ENABLE_AVX2) */
@@ -0,0 +1,359 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include "cmat.h"
+#include "kernel.h"
+
+#ifdef ENABLE_AVX512
+
+#ifndef __AVX512F__
+#error "x86 AVX-512 instruction set is not available."
+#endif /* !defined(__AVX512F__) */
+
+#include <immintrin.h>
+
+#include "kernel_batch.h"
+
+/*
+ * 端数処理はマスク付きロード/ストアで行う
+ */
+#define TAIL(n)       ((__mmask16)((1u << (n)) - 1))
+
+static void
+add(float* d, float* s, float* o, int n)
+{
+  int i;
+  __mmask16 k;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(d + i, _mm512_add_ps(_mm512_loadu_ps(s + i),
+                                          _mm512_loadu_ps(o + i)));
+  }
+
+  if (i < n) {
+    k = TAIL(n - i);
+    _mm512_mask_storeu_ps(d + i, k,
+                          _mm512_add_ps(_mm512_maskz_loadu_ps(k, s + i),
+                                        _mm512_maskz_loadu_ps(k, o + i)));
+  }
+}
+
+static void
+sub(float* d, float* s, float* o, int n)
+{
+  int i;
+  __mmask16 k;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(d + i, _mm512_sub_ps(_mm512_loadu_ps(s + i),
+                                          _mm512_loadu_ps(o + i)));
+  }
+
+  if (i < n) {
+    k = TAIL(n - i);
+    _mm512_mask_storeu_ps(d + i, k,
+                          _mm512_sub_ps(_mm512_maskz_loadu_ps(k, s + i),
+                                        _mm512_maskz_loadu_ps(k, o + i)));
+  }
+}
+
+static void
+mul(float* d, float* s, float v, int n)
+{
+  int i;
+  __mmask16 k;
+  __m512 vv;
+
+  vv = _mm512_set1_ps(v);
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(d + i, _mm512_mul_ps(_mm512_loadu_ps(s + i), vv));
+  }
+
+  if (i < n) {
+    k = TAIL(n - i);
+    _mm512_mask_storeu_ps(d + i, k,
+                          _mm512_mul_ps(_mm512_maskz_loadu_ps(k, s + i), vv));
+  }
+}
+
+/*
+ * 非テンポラルストア版(d, s, oは64バイト境界に揃っていること)
+ *  端数はストリーミングストアが使えないので通常のマスク付きストアで書く。
+ */
+static void
+add_nt(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_stream_ps(d + i, _mm512_add_ps(_mm512_load_ps(s + i),
+                                          _mm512_load_ps(o + i)));
+  }
+
+  if (i < n) add(d + i, s + i, o + i, n - i);
+
+  _mm_sfence();
+}
+
+static void
+sub_nt(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_stream_ps(d + i, _mm512_sub_ps(_mm512_load_ps(s + i),
+                                          _mm512_load_ps(o + i)));
+  }
+
+  if (i < n) sub(d + i, s + i, o + i, n - i);
+
+  _mm_sfence();
+}
+
+static void
+mul_nt(float* d, float* s, float v, int n)
+{
+  int i;
+  __m512 vv;
+
+  vv = _mm512_set1_ps(v);
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_stream_ps(d + i, _mm512_mul_ps(_mm512_load_ps(s + i), vv));
+  }
+
+  if (i < n) mul(d + i, s + i, v, n - i);
+
+  _mm_sfence();
+}
+
+static void
+nmadd(float* d, float* s, float v, int n)
+{
+  int i;
+  __mmask16 k;
+  __m512 vv;
+
+  vv = _mm512_set1_ps(v);
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(d + i, _mm512_fnmadd_ps(_mm512_loadu_ps(s + i), vv,
+                                             _mm512_loadu_ps(d + i)));
+  }
+
+  if (i < n) {
+    k = TAIL(n - i);
+    _mm512_mask_storeu_ps(d + i, k,
+                          _mm512_fnmadd_ps(_mm512_maskz_loadu_ps(k, s + i), vv,
+                                           _mm512_maskz_loadu_ps(k, d + i)));
+  }
+}
+
+static float
+dot(float* s, float* o, int n)
+{
+  int i;
+  __mmask16 k;
+  __m512 vd0;
+  __m512 vd1;
+  __m512 vd2;
+  __m512 vd3;
+
+  vd0 = _mm512_setzero_ps();
+  vd1 = _mm512_setzero_ps();
+  vd2 = _mm512_setzero_ps();
+  vd3 = _mm512_setzero_ps();
+
+  /*
+   * FMAのレイテンシを隠すために4本のアキュムレータで累積する
+   */
+  for (i = 0; i + 64 <= n; i += 64) {
+    vd0 = _mm512_fmadd_ps(_mm512_loadu_ps(s + i + 0),
+                          _mm512_loadu_ps(o + i + 0), vd0);
+    vd1 = _mm512_fmadd_ps(_mm512_loadu_ps(s + i + 16),
+                          _mm512_loadu_ps(o + i + 16), vd1);
+    vd2 = _mm512_fmadd_ps(_mm512_loadu_ps(s + i + 32),
+                          _mm512_loadu_ps(o + i + 32), vd2);
+    vd3 = _mm512_fmadd_ps(_mm512_loadu_ps(s + i + 48),
+                          _mm512_loadu_ps(o + i + 48), vd3);
+  }
+
+  for (; i + 16 <= n; i += 16) {
+    vd0 = _mm512_fmadd_ps(_mm512_loadu_ps(s + i), _mm512_loadu_ps(o + i), vd0);
+  }
+
+  if (i < n) {
+    k   = TAIL(n - i);
+    vd1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(k, s + i),
+                          _mm512_maskz_loadu_ps(k, o + i), vd1);
+  }
+
+  return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(vd0, vd1),
+                                            _mm512_add_ps(vd2, vd3)));
+}
+
+static void
+product(float* d, float* s, float** o, int n, int m)
+{
+  int c;
+  int i;
+  float* p;
+  __mmask16 k;
+
+  __m512 vs;
+  __m512 vd0;
+  __m512 vd1;
+  __m512 vd2;
+  __m512 vd3;
+
+  /*
+   * 出力行の64列分(16列x4レジスタ)をレジスタ上で累積する
+   */
+  for (c = 0; c + 64 <= m; c += 64) {
+    vd0 = _mm512_setzero_ps();
+    vd1 = _mm512_setzero_ps();
+    vd2 = _mm512_setzero_ps();
+    vd3 = _mm512_setzero_ps();
+
+    for (i = 0; i < n; i++) {
+      vs  = _mm512_set1_ps(s[i]);
+      p   = o[i] + c;
+
+      vd0 = _mm512_fmadd_ps(vs, _mm512_loadu_ps(p + 0), vd0);
+      vd1 = _mm512_fmadd_ps(vs, _mm512_loadu_ps(p + 16), vd1);
+      vd2 = _mm512_fmadd_ps(vs, _mm512_loadu_ps(p + 32), vd2);
+      vd3 = _mm512_fmadd_ps(vs, _mm512_loadu_ps(p + 48), vd3);
+    }
+
+    _mm512_storeu_ps(d + c + 0, vd0);
+    _mm512_storeu_ps(d + c + 16, vd1);
+    _mm512_storeu_ps(d + c + 32, vd2);
+    _mm512_storeu_ps(d + c + 48, vd3);
+  }
+
+  for (; c < m; c += 16) {
+    k   = (m - c >= 16)? (__mmask16)0xffff: TAIL(m - c);
+    vd0 = _mm512_setzero_ps();
+
+    for (i = 0; i < n; i++) {
+      vs  = _mm512_set1_ps(s[i]);
+      vd0 = _mm512_fmadd_ps(vs, _mm512_maskz_loadu_ps(k, o[i] + c), vd0);
+    }
+
+    _mm512_mask_storeu_ps(d + c, k, vd0);
+  }
+}
+
+/*
+ * 8x32のマイクロカーネル(16レジスタで累積)
+ */
+static void
+gemm(int k, const float* a, const float* b, float* t)
+{
+  int p;
+  int i;
+  __m512 b0;
+  __m512 b1;
+  __m512 av;
+  __m512 c0[8];
+  __m512 c1[8];
+
+  for (i = 0; i < 8; i++) {
+    c0[i] = _mm512_setzero_ps();
+    c1[i] = _mm512_setzero_ps();
+  }
+
+  for (p = 0; p < k; p++) {
+    b0 = _mm512_load_ps(b + 0);
+    b1 = _mm512_load_ps(b + 16);
+
+#pragma GCC unroll 8
+    for (i = 0; i < 8; i++) {
+      av    = _mm512_set1_ps(a[i]);
+      c0[i] = _mm512_fmadd_ps(av, b0, c0[i]);
+      c1[i] = _mm512_fmadd_ps(av, b1, c1[i]);
+    }
+
+    a += 8;
+    b += 32;
+  }
+
+  for (i = 0; i < 8; i++) {
+    _mm512_storeu_ps(t + (i * 32) + 0, c0[i]);
+    _mm512_storeu_ps(t + (i * 32) + 16, c1[i]);
+  }
+}
+
+/*
+ * 8x8の転置(レジスタ上で入れ替える)
+ */
+static void
+transpose(float** d, int dc, float** s, int sc)
+{
+  __m256 r[8];
+  __m256 t[8];
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    r[i] = _mm256_loadu_ps(s[i] + sc);
+  }
+
+  /* 隣接する2行の要素を交互に並べる */
+  for (i = 0; i < 8; i += 2) {
+    t[i + 0] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+    t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+  }
+
+  /* 4行分の要素を128ビットレーン内で揃える */
+  for (i = 0; i < 8; i += 4) {
+    r[i + 0] = _mm256_shuffle_ps(t[i + 0], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+    r[i + 1] = _mm256_shuffle_ps(t[i + 0], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+    r[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+    r[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+  }
+
+  /* 上下4行の128ビットレーンを組み合わせる */
+  for (i = 0; i < 4; i++) {
+    _mm256_storeu_ps(d[i + 0] + dc,
+                     _mm256_permute2f128_ps(r[i], r[i + 4], 0x20));
+    _mm256_storeu_ps(d[i + 4] + dc,
+                     _mm256_permute2f128_ps(r[i], r[i + 4], 0x31));
+  }
+}
+
+const kernel_t cmat_kernel_avx512 = {
+  CMAT_SIMD_AVX512,
+  "avx512",
+  16,
+  16,
+
+  add,
+  sub,
+  mul,
+  add_nt,
+  sub_nt,
+  mul_nt,
+  nmadd,
+  dot,
+  product,
+
+  8,          // mr
+  32,         // nr
+  96,         // mc
+  384,        // kc
+  4096,       // nc
+
+  gemm,
+
+  8,          // tw
+  transpose,
+
+  batch_product,
+  batch_det,
+  batch_inverse,
+};
+#endif /* defined(ENABLE_AVX512) */
@@ -0,0 +1,204 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * バッチ演算カーネル
+ *
+ * 各kernel_*.cからインクルードされ、それぞれの命令セットのコンパイルオプ
+ * ションでコンパイルされる。バッチ行列は要素ごとの平面(n行列分の同じ位置
+ * の要素を連続して並べた配列)で渡されるので、以下のループはいずれも行列方
+ * 向(i)に連続アクセスとなり、コンパイラによってその命令セットのベクトル幅
+ * で自動ベクトル化される。
+ *
+ *  s, d, a, b  : 要素平面の配列(行優先で rows * cols 個)
+ *  n           : 処理する行列の数
+ */
+
+#ifndef __CHEAP_MATRIX_KERNEL_BATCH_H__
+#define __CHEAP_MATRIX_KERNEL_BATCH_H__
+
+/* d[m x l] = a[m x k] * b[k x l] */
+static void
+batch_product(float** d, float** a, float** b, int m, int k, int l, int n)
+{
+  float* dp;
+  float* ap;
+  float* bp;
+  int r;
+  int c;
+  int p;
+  int i;
+
+  for (r = 0; r < m; r++) {
+    for (c = 0; c < l; c++) {
+      dp = d[(r * l) + c];
+      ap = a[r * k];
+      bp = b[c];
+
+      for (i = 0; i < n; i++) {
+        dp[i] = ap[i] * bp[i];
+      }
+
+      for (p = 1; p < k; p++) {
+        ap = a[(r * k) + p];
+        bp = b[(p * l) + c];
+
+        for (i = 0; i < n; i++) {
+          dp[i] += ap[i] * bp[i];
+        }
+      }
+    }
+  }
+}
+
+/* d = det(s)  (sz = 1..4) */
+static void
+batch_det(float** s, float* d, int sz, int n)
+{
+  float s0, s1, s2, s3, s4, s5;
+  float c0, c1, c2, c3, c4, c5;
+  int i;
+
+  switch (sz) {
+  case 1:
+    for (i = 0; i < n; i++) {
+      d[i] = s[0][i];
+    }
+    break;
+
+  case 2:
+    for (i = 0; i < n; i++) {
+      d[i] = (s[0][i] * s[3][i]) - (s[1][i] * s[2][i]);
+    }
+    break;
+
+  case 3:
+    for (i = 0; i < n; i++) {
+      d[i] = (s[0][i] * ((s[4][i] * s[8][i]) - (s[5][i] * s[7][i]))) -
+             (s[1][i] * ((s[3][i] * s[8][i]) - (s[5][i] * s[6][i]))) +
+             (s[2][i] * ((s[3][i] * s[7][i]) - (s[4][i] * s[6][i])));
+    }
+    break;
+
+  case 4:
+    for (i = 0; i < n; i++) {
+      s0 = (s[0][i] * s[5][i]) - (s[4][i] * s[1][i]);
+      s1 = (s[0][i] * s[6][i]) - (s[4][i] * s[2][i]);
+      s2 = (s[0][i] * s[7][i]) - (s[4][i] * s[3][i]);
+      s3 = (s[1][i] * s[6][i]) - (s[5][i] * s[2][i]);
+      s4 = (s[1][i] * s[7][i]) - (s[5][i] * s[3][i]);
+      s5 = (s[2][i] * s[7][i]) - (s[6][i] * s[3][i]);
+
+      c5 = (s[10][i] * s[15][i]) - (s[14][i] * s[11][i]);
+      c4 = (s[9][i] * s[15][i]) - (s[13][i] * s[11][i]);
+      c3 = (s[9][i] * s[14][i]) - (s[13][i] * s[10][i]);
+      c2 = (s[8][i] * s[15][i]) - (s[12][i] * s[11][i]);
+      c1 = (s[8][i] * s[14][i]) - (s[12][i] * s[10][i]);
+      c0 = (s[8][i] * s[13][i]) - (s[12][i] * s[9][i]);
+
+      d[i] = (s0 * c5) - (s1 * c4) + (s2 * c3) +
+             (s3 * c2) - (s4 * c1) + (s5 * c0);
+    }
+    break;
+  }
+}
+
+/* d = s^-1 (余因子行列による), det = det(s)  (sz = 1..4) */
+static void
+batch_inverse(float** s, float** d, float* det, int sz, int n)
+{
+  float s0, s1, s2, s3, s4, s5;
+  float c0, c1, c2, c3, c4, c5;
+  float t0, t1, t2;
+  float v;
+  int i;
+
+  switch (sz) {
+  case 1:
+    for (i = 0; i < n; i++) {
+      det[i]  = s[0][i];
+      d[0][i] = 1.0f / s[0][i];
+    }
+    break;
+
+  case 2:
+    for (i = 0; i < n; i++) {
+      det[i]  = (s[0][i] * s[3][i]) - (s[1][i] * s[2][i]);
+      v       = 1.0f / det[i];
+
+      d[0][i] =  s[3][i] * v;
+      d[1][i] = -s[1][i] * v;
+      d[2][i] = -s[2][i] * v;
+      d[3][i] =  s[0][i] * v;
+    }
+    break;
+
+  case 3:
+    for (i = 0; i < n; i++) {
+      t0      = (s[4][i] * s[8][i]) - (s[5][i] * s[7][i]);
+      t1      = (s[5][i] * s[6][i]) - (s[3][i] * s[8][i]);
+      t2      = (s[3][i] * s[7][i]) - (s[4][i] * s[6][i]);
+
+      det[i]  = (s[0][i] * t0) + (s[1][i] * t1) + (s[2][i] * t2);
+      v       = 1.0f / det[i];
+
+      d[0][i] = t0 * v;
+      d[1][i] = ((s[2][i] * s[7][i]) - (s[1][i] * s[8][i])) * v;
+      d[2][i] = ((s[1][i] * s[5][i]) - (s[2][i] * s[4][i])) * v;
+      d[3][i] = t1 * v;
+      d[4][i] = ((s[0][i] * s[8][i]) - (s[2][i] * s[6][i])) * v;
+      d[5][i] = ((s[2][i] * s[3][i]) - (s[0][i] * s[5][i])) * v;
+      d[6][i] = t2 * v;
+      d[7][i] = ((s[1][i] * s[6][i]) - (s[0][i] * s[7][i])) * v;
+      d[8][i] = ((s[0][i] * s[4][i]) - (s[1][i] * s[3][i])) * v;
+    }
+    break;
+
+  case 4:
+    for (i = 0; i < n; i++) {
+      s0 = (s[0][i] * s[5][i]) - (s[4][i] * s[1][i]);
+      s1 = (s[0][i] * s[6][i]) - (s[4][i] * s[2][i]);
+      s2 = (s[0][i] * s[7][i]) - (s[4][i] * s[3][i]);
+      s3 = (s[1][i] * s[6][i]) - (s[5][i] * s[2][i]);
+      s4 = (s[1][i] * s[7][i]) - (s[5][i] * s[3][i]);
+      s5 = (s[2][i] * s[7][i]) - (s[6][i] * s[3][i]);
+
+      c5 = (s[10][i] * s[15][i]) - (s[14][i] * s[11][i]);
+      c4 = (s[9][i] * s[15][i]) - (s[13][i] * s[11][i]);
+      c3 = (s[9][i] * s[14][i]) - (s[13][i] * s[10][i]);
+      c2 = (s[8][i] * s[15][i]) - (s[12][i] * s[11][i]);
+      c1 = (s[8][i] * s[14][i]) - (s[12][i] * s[10][i]);
+      c0 = (s[8][i] * s[13][i]) - (s[12][i] * s[9][i]);
+
+      det[i] = (s0 * c5) - (s1 * c4) + (s2 * c3) +
+               (s3 * c2) - (s4 * c1) + (s5 * c0);
+      v      = 1.0f / det[i];
+
+      d[0][i]  = ( (s[5][i] * c5) - (s[6][i] * c4) + (s[7][i] * c3)) * v;
+      d[1][i]  = (-(s[1][i] * c5) + (s[2][i] * c4) - (s[3][i] * c3)) * v;
+      d[2][i]  = ( (s[13][i] * s5) - (s[14][i] * s4) + (s[15][i] * s3)) * v;
+      d[3][i]  = (-(s[9][i] * s5) + (s[10][i] * s4) - (s[11][i] * s3)) * v;
+
+      d[4][i]  = (-(s[4][i] * c5) + (s[6][i] * c2) - (s[7][i] * c1)) * v;
+      d[5][i]  = ( (s[0][i] * c5) - (s[2][i] * c2) + (s[3][i] * c1)) * v;
+      d[6][i]  = (-(s[12][i] * s5) + (s[14][i] * s2) - (s[15][i] * s1)) * v;
+      d[7][i]  = ( (s[8][i] * s5) - (s[10][i] * s2) + (s[11][i] * s1)) * v;
+
+      d[8][i]  = ( (s[4][i] * c4) - (s[5][i] * c2) + (s[7][i] * c0)) * v;
+      d[9][i]  = (-(s[0][i] * c4) + (s[1][i] * c2) - (s[3][i] * c0)) * v;
+      d[10][i] = ( (s[12][i] * s4) - (s[13][i] * s2) + (s[15][i] * s0)) * v;
+      d[11][i] = (-(s[8][i] * s4) + (s[9][i] * s2) - (s[11][i] * s0)) * v;
+
+      d[12][i] = (-(s[4][i] * c3) + (s[5][i] * c1) - (s[6][i] * c0)) * v;
+      d[13][i] = ( (s[0][i] * c3) - (s[1][i] * c1) + (s[2][i] * c0)) * v;
+      d[14][i] = (-(s[12][i] * s3) + (s[13][i] * s1) - (s[14][i] * s0)) * v;
+      d[15][i] = ( (s[8][i] * s3) - (s[9][i] * s1) + (s[10][i] * s0)) * v;
+    }
+    break;
+  }
+}
+
+#endif /* !defined(__CHEAP_MATRIX_KERNEL_BATCH_H__) */
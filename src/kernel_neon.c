@@ -0,0 +1,317 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include "cmat.h"
+#include "kernel.h"
+
+#ifdef ENABLE_NEON
+
+#if !defined(__ARM_NEON) && !defined(__ARM_NEON__)
+#error "ARM NEON instruction set is not available."
+#endif /* !defined(__ARM_NEON) && !defined(__ARM_NEON__) */
+
+#include <arm_neon.h>
+
+#include "kernel_batch.h"
+
+#ifdef __aarch64__
+#define VFMA(a,b,c)   vfmaq_f32((a), (b), (c))
+#define VFMS(a,b,c)   vfmsq_f32((a), (b), (c))
+#else /* defined(__aarch64__) */
+#define VFMA(a,b,c)   vmlaq_f32((a), (b), (c))
+#define VFMS(a,b,c)   vmlsq_f32((a), (b), (c))
+#endif /* defined(__aarch64__) */
+
+static inline float
+hsum(float32x4_t v)
+{
+#ifdef __aarch64__
+  return vaddvq_f32(v);
+#else /* defined(__aarch64__) */
+  float32x2_t h;
+
+  h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  h = vpadd_f32(h, h);
+
+  return vget_lane_f32(h, 0);
+#endif /* defined(__aarch64__) */
+}
+
+static void
+add(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    vst1q_f32(d + i, vaddq_f32(vld1q_f32(s + i), vld1q_f32(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] + o[i];
+  }
+}
+
+static void
+sub(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    vst1q_f32(d + i, vsubq_f32(vld1q_f32(s + i), vld1q_f32(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] - o[i];
+  }
+}
+
+static void
+mul(float* d, float* s, float v, int n)
+{
+  int i;
+  float32x4_t vv;
+
+  vv = vmovq_n_f32(v);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    vst1q_f32(d + i, vmulq_f32(vld1q_f32(s + i), vv));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] * v;
+  }
+}
+
+/*
+ * 非テンポラルストア版
+ *  NEONにはストリーミングストアが無いので通常版をそのまま使う。
+ */
+#define add_nt        add
+#define sub_nt        sub
+#define mul_nt        mul
+
+static void
+nmadd(float* d, float* s, float v, int n)
+{
+  int i;
+  float32x4_t vv;
+
+  vv = vmovq_n_f32(v);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    vst1q_f32(d + i, VFMS(vld1q_f32(d + i), vld1q_f32(s + i), vv));
+  }
+
+  for (; i < n; i++) {
+    d[i] -= s[i] * v;
+  }
+}
+
+static float
+dot(float* s, float* o, int n)
+{
+  float ret;
+  int i;
+  float32x4_t vd0;
+  float32x4_t vd1;
+  float32x4_t vd2;
+  float32x4_t vd3;
+
+  vd0 = vmovq_n_f32(0.0f);
+  vd1 = vmovq_n_f32(0.0f);
+  vd2 = vmovq_n_f32(0.0f);
+  vd3 = vmovq_n_f32(0.0f);
+
+  /*
+   * 積和のレイテンシを隠すために4本のアキュムレータで累積する
+   */
+  for (i = 0; i + 16 <= n; i += 16) {
+    vd0 = VFMA(vd0, vld1q_f32(s + i + 0), vld1q_f32(o + i + 0));
+    vd1 = VFMA(vd1, vld1q_f32(s + i + 4), vld1q_f32(o + i + 4));
+    vd2 = VFMA(vd2, vld1q_f32(s + i + 8), vld1q_f32(o + i + 8));
+    vd3 = VFMA(vd3, vld1q_f32(s + i + 12), vld1q_f32(o + i + 12));
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    vd0 = VFMA(vd0, vld1q_f32(s + i), vld1q_f32(o + i));
+  }
+
+  ret = hsum(vaddq_f32(vaddq_f32(vd0, vd1), vaddq_f32(vd2, vd3)));
+
+  for (; i < n; i++) {
+    ret += s[i] * o[i];
+  }
+
+  return ret;
+}
+
+static void
+product(float* d, float* s, float** o, int n, int m)
+{
+  int c;
+  int i;
+  float* p;
+
+  float32x4_t vs;
+  float32x4_t vd0;
+  float32x4_t vd1;
+  float32x4_t vd2;
+  float32x4_t vd3;
+
+  /*
+   * 出力行の16列分(4列x4レジスタ)をレジスタ上で累積する
+   */
+  for (c = 0; c + 16 <= m; c += 16) {
+    vd0 = vmovq_n_f32(0.0f);
+    vd1 = vmovq_n_f32(0.0f);
+    vd2 = vmovq_n_f32(0.0f);
+    vd3 = vmovq_n_f32(0.0f);
+
+    for (i = 0; i < n; i++) {
+      vs  = vmovq_n_f32(s[i]);
+      p   = o[i] + c;
+
+      vd0 = VFMA(vd0, vs, vld1q_f32(p + 0));
+      vd1 = VFMA(vd1, vs, vld1q_f32(p + 4));
+      vd2 = VFMA(vd2, vs, vld1q_f32(p + 8));
+      vd3 = VFMA(vd3, vs, vld1q_f32(p + 12));
+    }
+
+    vst1q_f32(d + c + 0, vd0);
+    vst1q_f32(d + c + 4, vd1);
+    vst1q_f32(d + c + 8, vd2);
+    vst1q_f32(d + c + 12, vd3);
+  }
+
+  for (; c + 4 <= m; c += 4) {
+    vd0 = vmovq_n_f32(0.0f);
+
+    for (i = 0; i < n; i++) {
+      vs  = vmovq_n_f32(s[i]);
+      vd0 = VFMA(vd0, vs, vld1q_f32(o[i] + c));
+    }
+
+    vst1q_f32(d + c, vd0);
+  }
+
+  for (; c < m; c++) {
+    d[c] = 0.0f;
+
+    for (i = 0; i < n; i++) {
+      d[c] += s[i] * o[i][c];
+    }
+  }
+}
+
+/*
+ * 4x8のマイクロカーネル(8レジスタで累積)
+ */
+static void
+gemm(int k, const float* a, const float* b, float* t)
+{
+  int p;
+  float32x4_t b0;
+  float32x4_t b1;
+  float32x4_t av;
+
+  float32x4_t c00, c01;
+  float32x4_t c10, c11;
+  float32x4_t c20, c21;
+  float32x4_t c30, c31;
+
+  c00 = c01 = vmovq_n_f32(0.0f);
+  c10 = c11 = vmovq_n_f32(0.0f);
+  c20 = c21 = vmovq_n_f32(0.0f);
+  c30 = c31 = vmovq_n_f32(0.0f);
+
+  for (p = 0; p < k; p++) {
+    b0  = vld1q_f32(b + 0);
+    b1  = vld1q_f32(b + 4);
+
+    av  = vmovq_n_f32(a[0]);
+    c00 = VFMA(c00, av, b0);
+    c01 = VFMA(c01, av, b1);
+
+    av  = vmovq_n_f32(a[1]);
+    c10 = VFMA(c10, av, b0);
+    c11 = VFMA(c11, av, b1);
+
+    av  = vmovq_n_f32(a[2]);
+    c20 = VFMA(c20, av, b0);
+    c21 = VFMA(c21, av, b1);
+
+    av  = vmovq_n_f32(a[3]);
+    c30 = VFMA(c30, av, b0);
+    c31 = VFMA(c31, av, b1);
+
+    a += 4;
+    b += 8;
+  }
+
+  vst1q_f32(t + 0, c00);
+  vst1q_f32(t + 4, c01);
+  vst1q_f32(t + 8, c10);
+  vst1q_f32(t + 12, c11);
+  vst1q_f32(t + 16, c20);
+  vst1q_f32(t + 20, c21);
+  vst1q_f32(t + 24, c30);
+  vst1q_f32(t + 28, c31);
+}
+
+/*
+ * 4x4の転置(レジスタ上で入れ替える)
+ */
+static void
+transpose(float** d, int dc, float** s, int sc)
+{
+  float32x4x2_t t01;
+  float32x4x2_t t23;
+
+  t01 = vtrnq_f32(vld1q_f32(s[0] + sc), vld1q_f32(s[1] + sc));
+  t23 = vtrnq_f32(vld1q_f32(s[2] + sc), vld1q_f32(s[3] + sc));
+
+  vst1q_f32(d[0] + dc, vcombine_f32(vget_low_f32(t01.val[0]),
+                                    vget_low_f32(t23.val[0])));
+  vst1q_f32(d[1] + dc, vcombine_f32(vget_low_f32(t01.val[1]),
+                                    vget_low_f32(t23.val[1])));
+  vst1q_f32(d[2] + dc, vcombine_f32(vget_high_f32(t01.val[0]),
+                                    vget_high_f32(t23.val[0])));
+  vst1q_f32(d[3] + dc, vcombine_f32(vget_high_f32(t01.val[1]),
+                                    vget_high_f32(t23.val[1])));
+}
+
+const kernel_t cmat_kernel_neon = {
+  CMAT_SIMD_NEON,
+  "neon",
+  4,
+  4,
+
+  add,
+  sub,
+  mul,
+  add_nt,
+  sub_nt,
+  mul_nt,
+  nmadd,
+  dot,
+  product,
+
+  4,          // mr
+  8,          // nr
+  128,        // mc
+  256,        // kc
+  4096,       // nc
+
+  gemm,
+
+  4,          // tw
+  transpose,
+
+  batch_product,
+  batch_det,
+  batch_inverse,
+};
+#endif /* defined(ENABLE_NEON) */
@@ -0,0 +1,178 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <string.h>
+
+#include "cmat.h"
+#include "kernel.h"
+#include "kernel_batch.h"
+
+static void
+add(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    d[i] = s[i] + o[i];
+  }
+}
+
+static void
+sub(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    d[i] = s[i] - o[i];
+  }
+}
+
+static void
+mul(float* d, float* s, float v, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    d[i] = s[i] * v;
+  }
+}
+
+/*
+ * 非テンポラルストア版
+ *  ストリーミングストアは無いので通常版をそのまま使う。
+ */
+#define add_nt        add
+#define sub_nt        sub
+#define mul_nt        mul
+
+static void
+nmadd(float* d, float* s, float v, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    d[i] -= s[i] * v;
+  }
+}
+
+static float
+dot(float* s, float* o, int n)
+{
+  float r0;
+  float r1;
+  float r2;
+  float r3;
+  int i;
+
+  r0 = 0.0f;
+  r1 = 0.0f;
+  r2 = 0.0f;
+  r3 = 0.0f;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    r0 += s[i + 0] * o[i + 0];
+    r1 += s[i + 1] * o[i + 1];
+    r2 += s[i + 2] * o[i + 2];
+    r3 += s[i + 3] * o[i + 3];
+  }
+
+  for (; i < n; i++) {
+    r0 += s[i] * o[i];
+  }
+
+  return (r0 + r1) + (r2 + r3);
+}
+
+static void
+product(float* d, float* s, float** o, int n, int m)
+{
+  int i;
+  int c;
+  float v;
+  float* p;
+
+  for (c = 0; c < m; c++) {
+    d[c] = 0.0f;
+  }
+
+  for (i = 0; i < n; i++) {
+    v = s[i];
+    p = o[i];
+
+    for (c = 0; c < m; c++) {
+      d[c] += v * p[c];
+    }
+  }
+}
+
+static void
+gemm(int k, const float* a, const float* b, float* t)
+{
+  float c[4][4];
+  int p;
+  int i;
+  int j;
+
+  memset(c, 0, sizeof(c));
+
+  for (p = 0; p < k; p++) {
+    for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+        c[i][j] += a[i] * b[j];
+      }
+    }
+
+    a += 4;
+    b += 4;
+  }
+
+  memcpy(t, c, sizeof(c));
+}
+
+static void
+transpose(float** d, int dc, float** s, int sc)
+{
+  int i;
+  int j;
+
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < 4; j++) {
+      d[j][dc + i] = s[i][sc + j];
+    }
+  }
+}
+
+const kernel_t cmat_kernel_scalar = {
+  CMAT_SIMD_SCALAR,
+  "scalar",
+  1,
+  4,
+
+  add,
+  sub,
+  mul,
+  add_nt,
+  sub_nt,
+  mul_nt,
+  nmadd,
+  dot,
+  product,
+
+  4,          // mr
+  4,          // nr
+  64,         // mc
+  256,        // kc
+  4096,       // nc
+
+  gemm,
+
+  4,          // tw
+  transpose,
+
+  batch_product,
+  batch_det,
+  batch_inverse,
+};
@@ -0,0 +1,356 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include "cmat.h"
+#include "kernel.h"
+
+#ifdef ENABLE_SSE42
+
+#ifndef __SSE4_2__
+#error "x86 SSE4.2 instruction set is not available."
+#endif /* !defined(__SSE4_2__) */
+
+#include <nmmintrin.h>
+
+#include "kernel_batch.h"
+
+static inline float
+hsum(__m128 v)
+{
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_movehdup_ps(v));
+
+  return _mm_cvtss_f32(v);
+}
+
+static void
+add(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(s + i), _mm_loadu_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] + o[i];
+  }
+}
+
+static void
+sub(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(d + i, _mm_sub_ps(_mm_loadu_ps(s + i), _mm_loadu_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] - o[i];
+  }
+}
+
+static void
+mul(float* d, float* s, float v, int n)
+{
+  int i;
+  __m128 vv;
+
+  vv = _mm_set1_ps(v);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(s + i), vv));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] * v;
+  }
+}
+
+/*
+ * 非テンポラルストア版(d, s, oは16バイト境界に揃っていること)
+ */
+static void
+add_nt(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_stream_ps(d + i, _mm_add_ps(_mm_load_ps(s + i), _mm_load_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] + o[i];
+  }
+
+  _mm_sfence();
+}
+
+static void
+sub_nt(float* d, float* s, float* o, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_stream_ps(d + i, _mm_sub_ps(_mm_load_ps(s + i), _mm_load_ps(o + i)));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] - o[i];
+  }
+
+  _mm_sfence();
+}
+
+static void
+mul_nt(float* d, float* s, float v, int n)
+{
+  int i;
+  __m128 vv;
+
+  vv = _mm_set1_ps(v);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_stream_ps(d + i, _mm_mul_ps(_mm_load_ps(s + i), vv));
+  }
+
+  for (; i < n; i++) {
+    d[i] = s[i] * v;
+  }
+
+  _mm_sfence();
+}
+
+static void
+nmadd(float* d, float* s, float v, int n)
+{
+  int i;
+  __m128 vv;
+
+  vv = _mm_set1_ps(v);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(d + i, _mm_sub_ps(_mm_loadu_ps(d + i),
+                                    _mm_mul_ps(_mm_loadu_ps(s + i), vv)));
+  }
+
+  for (; i < n; i++) {
+    d[i] -= s[i] * v;
+  }
+}
+
+static float
+dot(float* s, float* o, int n)
+{
+  float ret;
+  int i;
+  __m128 vd0;
+  __m128 vd1;
+  __m128 vd2;
+  __m128 vd3;
+
+  vd0 = _mm_setzero_ps();
+  vd1 = _mm_setzero_ps();
+  vd2 = _mm_setzero_ps();
+  vd3 = _mm_setzero_ps();
+
+  /*
+   * 加算の依存関係を断つために4本のアキュムレータで累積する
+   */
+  for (i = 0; i + 16 <= n; i += 16) {
+    vd0 = _mm_add_ps(vd0, _mm_mul_ps(_mm_loadu_ps(s + i + 0),
+                                     _mm_loadu_ps(o + i + 0)));
+    vd1 = _mm_add_ps(vd1, _mm_mul_ps(_mm_loadu_ps(s + i + 4),
+                                     _mm_loadu_ps(o + i + 4)));
+    vd2 = _mm_add_ps(vd2, _mm_mul_ps(_mm_loadu_ps(s + i + 8),
+                                     _mm_loadu_ps(o + i + 8)));
+    vd3 = _mm_add_ps(vd3, _mm_mul_ps(_mm_loadu_ps(s + i + 12),
+                                     _mm_loadu_ps(o + i + 12)));
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    vd0 = _mm_add_ps(vd0, _mm_mul_ps(_mm_loadu_ps(s + i), _mm_loadu_ps(o + i)));
+  }
+
+  ret = hsum(_mm_add_ps(_mm_add_ps(vd0, vd1), _mm_add_ps(vd2, vd3)));
+
+  for (; i < n; i++) {
+    ret += s[i] * o[i];
+  }
+
+  return ret;
+}
+
+static void
+product(float* d, float* s, float** o, int n, int m)
+{
+  int c;
+  int i;
+  float* p;
+
+  __m128 vs;
+  __m128 vd0;
+  __m128 vd1;
+  __m128 vd2;
+  __m128 vd3;
+
+  /*
+   * 出力行の16列分(4列x4レジスタ)をレジスタ上で累積する
+   */
+  for (c = 0; c + 16 <= m; c += 16) {
+    vd0 = _mm_setzero_ps();
+    vd1 = _mm_setzero_ps();
+    vd2 = _mm_setzero_ps();
+    vd3 = _mm_setzero_ps();
+
+    for (i = 0; i < n; i++) {
+      vs  = _mm_set1_ps(s[i]);
+      p   = o[i] + c;
+
+      vd0 = _mm_add_ps(vd0, _mm_mul_ps(vs, _mm_loadu_ps(p + 0)));
+      vd1 = _mm_add_ps(vd1, _mm_mul_ps(vs, _mm_loadu_ps(p + 4)));
+      vd2 = _mm_add_ps(vd2, _mm_mul_ps(vs, _mm_loadu_ps(p + 8)));
+      vd3 = _mm_add_ps(vd3, _mm_mul_ps(vs, _mm_loadu_ps(p + 12)));
+    }
+
+    _mm_storeu_ps(d + c + 0, vd0);
+    _mm_storeu_ps(d + c + 4, vd1);
+    _mm_storeu_ps(d + c + 8, vd2);
+    _mm_storeu_ps(d + c + 12, vd3);
+  }
+
+  for (; c + 4 <= m; c += 4) {
+    vd0 = _mm_setzero_ps();
+
+    for (i = 0; i < n; i++) {
+      vs  = _mm_set1_ps(s[i]);
+      vd0 = _mm_add_ps(vd0, _mm_mul_ps(vs, _mm_loadu_ps(o[i] + c)));
+    }
+
+    _mm_storeu_ps(d + c, vd0);
+  }
+
+  for (; c < m; c++) {
+    d[c] = 0.0f;
+
+    for (i = 0; i < n; i++) {
+      d[c] += s[i] * o[i][c];
+    }
+  }
+}
+
+/*
+ * 4x8のマイクロカーネル(8レジスタで累積)
+ */
+static void
+gemm(int k, const float* a, const float* b, float* t)
+{
+  int p;
+  __m128 b0;
+  __m128 b1;
+  __m128 av;
+
+  __m128 c00, c01;
+  __m128 c10, c11;
+  __m128 c20, c21;
+  __m128 c30, c31;
+
+  c00 = c01 = _mm_setzero_ps();
+  c10 = c11 = _mm_setzero_ps();
+  c20 = c21 = _mm_setzero_ps();
+  c30 = c31 = _mm_setzero_ps();
+
+  for (p = 0; p < k; p++) {
+    b0  = _mm_load_ps(b + 0);
+    b1  = _mm_load_ps(b + 4);
+
+    av  = _mm_set1_ps(a[0]);
+    c00 = _mm_add_ps(c00, _mm_mul_ps(av, b0));
+    c01 = _mm_add_ps(c01, _mm_mul_ps(av, b1));
+
+    av  = _mm_set1_ps(a[1]);
+    c10 = _mm_add_ps(c10, _mm_mul_ps(av, b0));
+    c11 = _mm_add_ps(c11, _mm_mul_ps(av, b1));
+
+    av  = _mm_set1_ps(a[2]);
+    c20 = _mm_add_ps(c20, _mm_mul_ps(av, b0));
+    c21 = _mm_add_ps(c21, _mm_mul_ps(av, b1));
+
+    av  = _mm_set1_ps(a[3]);
+    c30 = _mm_add_ps(c30, _mm_mul_ps(av, b0));
+    c31 = _mm_add_ps(c31, _mm_mul_ps(av, b1));
+
+    a += 4;
+    b += 8;
+  }
+
+  _mm_storeu_ps(t + 0, c00);
+  _mm_storeu_ps(t + 4, c01);
+  _mm_storeu_ps(t + 8, c10);
+  _mm_storeu_ps(t + 12, c11);
+  _mm_storeu_ps(t + 16, c20);
+  _mm_storeu_ps(t + 20, c21);
+  _mm_storeu_ps(t + 24, c30);
+  _mm_storeu_ps(t + 28, c31);
+}
+
+/*
+ * 4x4の転置(レジスタ上で入れ替える)
+ */
+static void
+transpose(float** d, int dc, float** s, int sc)
+{
+  __m128 r0;
+  __m128 r1;
+  __m128 r2;
+  __m128 r3;
+
+  r0 = _mm_loadu_ps(s[0] + sc);
+  r1 = _mm_loadu_ps(s[1] + sc);
+  r2 = _mm_loadu_ps(s[2] + sc);
+  r3 = _mm_loadu_ps(s[3] + sc);
+
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+  _mm_storeu_ps(d[0] + dc, r0);
+  _mm_storeu_ps(d[1] + dc, r1);
+  _mm_storeu_ps(d[2] + dc, r2);
+  _mm_storeu_ps(d[3] + dc, r3);
+}
+
+const kernel_t cmat_kernel_sse42 = {
+  CMAT_SIMD_SSE42,
+  "sse42",
+  4,
+  4,
+
+  add,
+  sub,
+  mul,
+  add_nt,
+  sub_nt,
+  mul_nt,
+  nmadd,
+  dot,
+  product,
+
+  4,          // mr
+  8,          // nr
+  128,        // mc
+  256,        // kc
+  4096,       // nc
+
+  gemm,
+
+  4,          // tw
+  transpose,
+
+  batch_product,
+  batch_det,
+  batch_inverse,
+};
+#endif /* defined(ENABLE_SSE42) */
@@ -0,0 +1,240 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * NUMAノードへの配置
+ *
+ *  libnumaには依存せず、ノードの構成はsysfs(/sys/devices/system/node)から
+ *  読み、領域の配置はmbind(2)、スレッドの固定はpthread_setaffinity_np()で
+ *  行う。いずれもヒントとして扱い、失敗しても演算の結果には影響しないので
+ *  エラーは無視する。
+ *
+ *  n個に分けた範囲(並列forのブロック、スケジューラのワーカ)のk番目は次の
+ *  ノードに割り当てる。
+ *
+ *   CMAT_NUMA_FIRST_TOUCH : k * nodes / n (連続したブロックを各ノードに)
+ *   CMAT_NUMA_ROW_BLOCKS  : 同上
+ *   CMAT_NUMA_INTERLEAVE  : k % nodes (各ノードに均等に)
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif /* defined(__linux__) */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif /* defined(__linux__) */
+
+#include "cmat.h"
+#include "numa.h"
+
+#define NODE_PATH           "/sys/devices/system/node"
+
+#define MAX_NODES           64
+#define MAX_CPUS            1024
+#define WORD_BITS           (8 * (int)sizeof(unsigned long))
+#define MASK_WORDS(n)       (((n) + WORD_BITS - 1) / WORD_BITS)
+
+#define TEST_BIT(m,i)       (((m)[(i) / WORD_BITS] >> ((i) % WORD_BITS)) & 1)
+#define SET_BIT(m,i)        ((m)[(i) / WORD_BITS] |= 1UL << ((i) % WORD_BITS))
+
+/*
+ * mbind(2)のモード (numaif.hに依存しないように定義する)
+ */
+#define MPOL_PREFERRED      1
+#define MPOL_INTERLEAVE     3
+
+typedef struct {
+  int n;                    // オンラインのノード数
+  int id[MAX_NODES];        // ノード番号
+  unsigned long cpu[MAX_NODES][MASK_WORDS(MAX_CPUS)];  // ノードのCPU
+} topo_t;
+
+static topo_t topo;
+static pthread_once_t topo_once = PTHREAD_ONCE_INIT;
+
+/*
+ * "0-3,8-11"形式の番号の一覧の読み込み (nbits未満の番号をmaskに立てる)
+ */
+static int
+read_list(const char* path, unsigned long* mask, int nbits)
+{
+  int ret;
+  FILE* fp;
+  long a;
+  long b;
+  long i;
+  int c;
+
+  ret = 0;
+  fp  = fopen(path, "r");
+
+  if (fp == NULL) {
+    ret = !0;
+
+  } else {
+    memset(mask, 0, sizeof(unsigned long) * MASK_WORDS(nbits));
+
+    while (fscanf(fp, "%ld", &a) == 1) {
+      b = a;
+      c = fgetc(fp);
+
+      if (c == '-') {
+        if (fscanf(fp, "%ld", &b) != 1) break;
+        c = fgetc(fp);
+      }
+
+      for (i = (a > 0)? a: 0; i <= b && i < nbits; i++) SET_BIT(mask, i);
+
+      if (c != ',') break;
+    }
+
+    fclose(fp);
+  }
+
+  return ret;
+}
+
+static void
+load_topology(void)
+{
+  unsigned long node[MASK_WORDS(MAX_NODES)];
+  char path[64];
+  int i;
+
+  topo.n = 0;
+
+  if (!read_list(NODE_PATH "/online", node, MAX_NODES)) {
+    for (i = 0; i < MAX_NODES; i++) {
+      if (!TEST_BIT(node, i)) continue;
+
+      sprintf(path, NODE_PATH "/node%d/cpulist", i);
+      if (read_list(path, topo.cpu[topo.n], MAX_CPUS)) continue;
+
+      topo.id[topo.n] = i;
+      topo.n++;
+    }
+  }
+}
+
+int
+cmat_numa_nodes(void)
+{
+  pthread_once(&topo_once, load_topology);
+
+  return (topo.n > 1)? topo.n: 1;
+}
+
+int
+cmat_numa_node_of(int policy, int k, int n)
+{
+  int ret;
+  int nn;
+
+  nn = cmat_numa_nodes();
+
+  switch (policy) {
+  case CMAT_NUMA_FIRST_TOUCH:
+  case CMAT_NUMA_ROW_BLOCKS:
+    ret = (int)(((long)k * nn) / n);
+    break;
+
+  case CMAT_NUMA_INTERLEAVE:
+    ret = k % nn;
+    break;
+
+  default:
+    ret = -1;
+    break;
+  }
+
+  return ret;
+}
+
+#if defined(__linux__) && defined(SYS_mbind)
+static void
+bind_pages(uintptr_t head, uintptr_t tail, int mode, unsigned long mask)
+{
+  if (head < tail) {
+    syscall(SYS_mbind, (void*)head, (unsigned long)(tail - head), mode,
+            &mask, (unsigned long)MAX_NODES + 1, 0);
+  }
+}
+#endif /* defined(__linux__) && defined(SYS_mbind) */
+
+void
+cmat_numa_place(void* ptr, size_t size, int policy)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  uintptr_t pg;
+  uintptr_t head;
+  uintptr_t tail;
+  unsigned long mask;
+  long np;
+  int nn;
+  int k;
+
+  nn = cmat_numa_nodes();
+
+  if (nn > 1 && (policy == CMAT_NUMA_INTERLEAVE ||
+                 policy == CMAT_NUMA_ROW_BLOCKS)) {
+    /* 領域に完全に含まれるページのみを対象にする */
+    pg   = (uintptr_t)sysconf(_SC_PAGESIZE);
+    head = (((uintptr_t)ptr + pg - 1) / pg) * pg;
+    tail = (((uintptr_t)ptr + size) / pg) * pg;
+
+    if (policy == CMAT_NUMA_INTERLEAVE) {
+      mask = 0;
+      for (k = 0; k < nn; k++) mask |= 1UL << topo.id[k];
+
+      bind_pages(head, tail, MPOL_INTERLEAVE, mask);
+
+    } else if (head < tail) {
+      np = (long)((tail - head) / pg);
+
+      for (k = 0; k < nn; k++) {
+        bind_pages(head + (((np * k) / nn) * pg),
+                   head + (((np * (k + 1)) / nn) * pg),
+                   MPOL_PREFERRED, 1UL << topo.id[k]);
+      }
+    }
+  }
+#endif /* defined(__linux__) && defined(SYS_mbind) */
+}
+
+void
+cmat_numa_pin(pthread_t th, int node)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  int k;
+  int i;
+
+  if (cmat_numa_nodes() > 1) {
+    CPU_ZERO(&set);
+
+    for (k = 0; k < topo.n; k++) {
+      if (node >= 0 && k != node) continue;
+
+      for (i = 0; i < MAX_CPUS && i < CPU_SETSIZE; i++) {
+        if (TEST_BIT(topo.cpu[k], i)) CPU_SET(i, &set);
+      }
+    }
+
+    pthread_setaffinity_np(th, sizeof(set), &set);
+  }
+#else /* defined(__linux__) */
+  (void)th;
+  (void)node;
+#endif /* defined(__linux__) */
+}
@@ -0,0 +1,45 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_MATRIX_NUMA_H__
+#define __CHEAP_MATRIX_NUMA_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * NUMAノードへの領域とスレッドの配置
+ *
+ * ノードはオンラインのノードを番号順に並べた0からの通し番号で表す。ノー
+ * ドが一つしか無い(または構成を取得できない)環境では配置は何もしない。
+ */
+
+/*
+ * オンラインのノード数(取得できない場合は1)
+ */
+int cmat_numa_nodes(void);
+
+/*
+ * n個に分けた範囲(またはワーカ)のk番目を割り当てるノード
+ *  CMAT_NUMA_NONEの場合は-1を返す。
+ */
+int cmat_numa_node_of(int policy, int k, int n);
+
+/*
+ * [ptr, ptr + size)のページの配置方針の設定
+ *  CMAT_NUMA_INTERLEAVEは全ノードにページ単位で交互に、CMAT_NUMA_ROW_
+ *  BLOCKSは領域をノード数で等分して先頭から順に各ノードに割り当てる。そ
+ *  れ以外の方針では何もしない(初回の書き込みを行ったスレッドのノードに
+ *  置かれる)。まだ書き込んでいない領域に対して呼び出すこと。
+ */
+void cmat_numa_place(void* ptr, size_t size, int policy);
+
+/*
+ * スレッドthをノードnodeのCPUに固定する(nodeが負の場合は固定を解除する)
+ */
+void cmat_numa_pin(pthread_t th, int node);
+
+#endif /* !defined(__CHEAP_MATRIX_NUMA_H__) */
@@ -0,0 +1,947 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * ワークスティーリング方式のスケジューラ
+ *
+ *  ワーカごとに両端キュー(deque)を持ち、自分のキューの末尾からタスクを取
+ *  り出して処理する。自分のキューが空になったら他のワーカのキューの先頭
+ *  (古い、大きなタスク)を盗む。並列forは範囲を二分して片方をキューに積み、
+ *  もう片方を自分で処理することを粒度に達するまで繰り返す。
+ *
+ *  キュー0はワーカ以外のスレッド(演算の呼び出し元)用の投入口で、複数の
+ *  スレッドで共有する。完了を待つスレッドは待ちの間も他のタスクを処理す
+ *  るので、ワーカの中から並列forを入れ子に呼び出してもスレッドが寝たまま
+ *  になることはない(OpenMPのfork/joinのような直列化が起きない)。
+ *
+ *  ワーカには二つの形態がある。
+ *
+ *   内部ワーカ : cmat_sched_new()で生成したスレッド。仕事が無い間は条件変
+ *                数で眠る。
+ *   外部ワーカ : cmat_sched_new_external()で渡したsubmit関数を介して、ホス
+ *                トのスレッドプールで実行されるジョブ。キューが空になった
+ *                ら戻るので、ホストのワーカを占有し続けることはない。
+ *
+ *  カレントコンテキストにNUMAの配置方針が指定されている場合、並列forは範
+ *  囲をスロット数の連続したブロックに分け、k番目のブロックをスロットkの
+ *  キューに直接積む(盗まれない限りワーカkが処理する)。行列の初期化と演算
+ *  で同じ分割になるので、cmat_sched_set_numa()でワーカを固定しておけば
+ *  各行は同じノードのワーカに割り当たる。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "cmat.h"
+#include "ctx.h"
+#include "parallel.h"
+#include "numa.h"
+
+#define DEQUE_CAPA          1024
+#define SPIN_COUNT          64
+#define SPLIT_FACTOR        4
+
+typedef struct {
+  cmat_range_fn_t range;    // 並列forの範囲処理 (rangeとfuncのどちらか)
+  void (*func)(void*);      // 単独のタスク
+  void* arg;
+
+  long i0;
+  long i1;
+  long grain;               // これ以下の範囲は分割しない
+
+  int* pending;             // 完了待ちのカウンタ(NULLの場合は待たない)
+} task_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  long top;                 // 盗む側 (古いタスク)
+  long bottom;              // 所有者側 (新しいタスク)
+  task_t buf[DEQUE_CAPA];
+} deque_t;
+
+typedef struct {
+  cmat_sched_t* sched;
+  int slot;                 // 使用するキューの番号
+  int busy;                 // 0:空き 1:外部ワーカとして投入済み 2:終了処理中
+} worker_t;
+
+struct __cmat_sched__ {
+  int nslots;               // キューの数 (投入口 + ワーカ数)
+  deque_t* dq;
+  worker_t* wk;
+
+  int nthreads;             // 内部ワーカのスレッド数
+  pthread_t* th;
+
+  void (*submit)(void (*job)(void*), void* arg, void* user);
+  void* user;
+
+  int queued;               // キューに積まれているタスクの数
+  int sleepers;             // 眠っている内部ワーカの数
+  int stop;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+/* 非同期演算用の既定のスケジューラ */
+static cmat_sched_t* default_sched = NULL;
+static pthread_once_t default_once = PTHREAD_ONCE_INIT;
+
+/* 現在のスレッドがワーカとして動作している場合のワーカ情報 */
+static __thread worker_t* self = NULL;
+
+/* タスクを実行中のスケジューラ(ワーカ以外のスレッドが手伝う場合) */
+static __thread cmat_sched_t* running = NULL;
+
+static void helper_job(void* arg);
+
+static int
+my_slot(cmat_sched_t* sched)
+{
+  return (self && self->sched == sched)? self->slot: 0;
+}
+
+/*
+ * 眠っている内部ワーカを起こす
+ */
+static void
+wake_workers(cmat_sched_t* sched)
+{
+  if (__atomic_load_n(&sched->sleepers, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&sched->lock);
+    pthread_cond_broadcast(&sched->cond);
+    pthread_mutex_unlock(&sched->lock);
+  }
+}
+
+/*
+ * 外部ワーカの投入 (空いている枠にn個まで)
+ */
+static void
+submit_helpers(cmat_sched_t* sched, int n)
+{
+  worker_t* w;
+  int i;
+  int z;
+
+  for (i = 1; n > 0 && i < sched->nslots; i++) {
+    w = sched->wk + i;
+    z = 0;
+
+    if (__atomic_compare_exchange_n(&w->busy, &z, 1, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      sched->submit(helper_job, w, sched->user);
+      n--;
+      continue;
+    }
+
+    /* 終了処理中のジョブは引き留めて処理を続けさせる */
+    z = 2;
+    if (__atomic_compare_exchange_n(&w->busy, &z, 1, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      n--;
+    }
+  }
+}
+
+static int
+push_task(cmat_sched_t* sched, int slot, task_t* t)
+{
+  int ret;
+  deque_t* q;
+
+  q = sched->dq + slot;
+
+  pthread_mutex_lock(&q->lock);
+
+  if (q->bottom - q->top >= DEQUE_CAPA) {
+    ret = !0;
+  } else {
+    q->buf[q->bottom % DEQUE_CAPA] = *t;
+    q->bottom++;
+    ret = 0;
+  }
+
+  pthread_mutex_unlock(&q->lock);
+
+  if (!ret) {
+    __atomic_add_fetch(&sched->queued, 1, __ATOMIC_SEQ_CST);
+    if (sched->nthreads > 0) wake_workers(sched);
+  }
+
+  return ret;
+}
+
+/*
+ * キューからの取り出し (ownerが!0の場合は末尾から、それ以外は先頭から)
+ */
+static int
+take_task(cmat_sched_t* sched, int slot, int owner, task_t* t)
+{
+  int ret;
+  deque_t* q;
+
+  ret = 0;
+  q   = sched->dq + slot;
+
+  pthread_mutex_lock(&q->lock);
+
+  if (q->bottom > q->top) {
+    if (owner) {
+      q->bottom--;
+      *t = q->buf[q->bottom % DEQUE_CAPA];
+    } else {
+      *t = q->buf[q->top % DEQUE_CAPA];
+      q->top++;
+    }
+
+    ret = !0;
+  }
+
+  pthread_mutex_unlock(&q->lock);
+
+  if (ret) __atomic_sub_fetch(&sched->queued, 1, __ATOMIC_SEQ_CST);
+
+  return ret;
+}
+
+static int
+find_task(cmat_sched_t* sched, int slot, task_t* t)
+{
+  int ret;
+  int i;
+
+  ret = 0;
+
+  if (__atomic_load_n(&sched->queued, __ATOMIC_SEQ_CST) > 0) {
+    ret = take_task(sched, slot, !0, t);
+
+    for (i = 1; !ret && i < sched->nslots; i++) {
+      ret = take_task(sched, (slot + i) % sched->nslots, 0, t);
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * タスクの実行
+ *  並列forの範囲は粒度に達するまで二分し、後半をキューに積む(キューが一
+ *  杯の場合は残りをまとめて処理する)。実行中はカレントコンテキストを外す
+ *  (呼び出し元の作業領域を使わないように)。
+ */
+static void
+run_task(cmat_sched_t* sched, task_t* t)
+{
+  cmat_sched_t* org;
+  cmat_ctx_t* ctx;
+  task_t sub;
+  long mid;
+  int slot;
+
+  slot    = my_slot(sched);
+  org     = running;
+  running = sched;
+  ctx     = cmat_ctx_enter(NULL);
+
+  if (t->func) {
+    t->func(t->arg);
+
+  } else {
+    while (t->i1 - t->i0 > t->grain) {
+      mid     = t->i0 + ((t->i1 - t->i0) / 2);
+      sub     = *t;
+      sub.i0  = mid;
+
+      __atomic_add_fetch(t->pending, 1, __ATOMIC_RELAXED);
+
+      if (push_task(sched, slot, &sub)) {
+        __atomic_sub_fetch(t->pending, 1, __ATOMIC_RELAXED);
+        break;
+      }
+
+      t->i1 = mid;
+    }
+
+    t->range(t->arg, t->i0, t->i1);
+  }
+
+  cmat_ctx_leave(ctx);
+  running = org;
+
+  if (t->pending) __atomic_sub_fetch(t->pending, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * 完了待ち(待ちの間は他のタスクを処理する)
+ */
+static void
+wait_tasks(cmat_sched_t* sched, int* pending)
+{
+  task_t t;
+
+  while (__atomic_load_n(pending, __ATOMIC_ACQUIRE) > 0) {
+    if (find_task(sched, my_slot(sched), &t)) {
+      run_task(sched, &t);
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+/*
+ * 内部ワーカのメインループ
+ */
+static void*
+worker_main(void* arg)
+{
+  worker_t* w;
+  cmat_sched_t* sched;
+  task_t t;
+  int idle;
+
+  w     = (worker_t*)arg;
+  sched = w->sched;
+  self  = w;
+  idle  = 0;
+
+  while (!__atomic_load_n(&sched->stop, __ATOMIC_ACQUIRE)) {
+    if (find_task(sched, w->slot, &t)) {
+      run_task(sched, &t);
+      idle = 0;
+
+    } else if (++idle < SPIN_COUNT) {
+      sched_yield();
+
+    } else {
+      pthread_mutex_lock(&sched->lock);
+      __atomic_add_fetch(&sched->sleepers, 1, __ATOMIC_SEQ_CST);
+
+      while (__atomic_load_n(&sched->queued, __ATOMIC_SEQ_CST) == 0 &&
+             !__atomic_load_n(&sched->stop, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&sched->cond, &sched->lock);
+      }
+
+      __atomic_sub_fetch(&sched->sleepers, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&sched->lock);
+      idle = 0;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * 外部ワーカのジョブ(キューが空になるまで処理して戻る)
+ */
+static void
+helper_job(void* arg)
+{
+  worker_t* w;
+  worker_t* org;
+  task_t t;
+  int idle;
+  int st;
+
+  w    = (worker_t*)arg;
+  org  = self;
+  self = w;
+
+  while (1) {
+    idle = 0;
+
+    while (idle < SPIN_COUNT) {
+      if (find_task(w->sched, w->slot, &t)) {
+        run_task(w->sched, &t);
+        idle = 0;
+      } else {
+        idle++;
+        sched_yield();
+      }
+    }
+
+    /*
+     * 終了処理
+     *   最後の探索の後に積まれたタスクの投入側はbusyのCASに失敗して新たな
+     *   ジョブを投入しないので、終了処理中(2)にしてからキューを確認し直す。
+     *   投入側が1に戻した場合も処理を続ける。0に戻した後はschedに触れない
+     *   (破棄待ちが解除されるため)。
+     */
+    __atomic_store_n(&w->busy, 2, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&w->sched->queued, __ATOMIC_SEQ_CST) > 0) {
+      __atomic_store_n(&w->busy, 1, __ATOMIC_SEQ_CST);
+      continue;
+    }
+
+    st = 2;
+    if (__atomic_compare_exchange_n(&w->busy, &st, 0, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      break;
+    }
+  }
+
+  self = org;
+}
+
+cmat_sched_t*
+cmat_sched_current(void)
+{
+  cmat_sched_t* ret;
+
+  ret = cmat_ctx_sched();
+
+  if (ret == NULL) ret = (self)? self->sched: running;
+
+  return ret;
+}
+
+int
+cmat_sched_size(cmat_sched_t* sched)
+{
+  return sched->nslots;
+}
+
+/*
+ * 範囲を連続したnb個のブロックに分け、k番目(k >= 1)をスロットkのキュー
+ * に積む (積めなかった分を含めて残りの範囲をtに残す)
+ */
+static void
+spread_task(cmat_sched_t* sched, task_t* t, int nb)
+{
+  task_t sub;
+  long n;
+  int k;
+
+  n = t->i1 - t->i0;
+
+  for (k = nb - 1; k > 0; k--) {
+    sub    = *t;
+    sub.i0 = t->i0 + ((n * k) / nb);
+
+    __atomic_add_fetch(t->pending, 1, __ATOMIC_RELAXED);
+
+    if (push_task(sched, k, &sub)) {
+      __atomic_sub_fetch(t->pending, 1, __ATOMIC_RELAXED);
+      break;
+    }
+
+    t->i1 = sub.i0;
+  }
+}
+
+void
+cmat_parallel_for(long n, int nt, cmat_range_fn_t fn, void* arg)
+{
+  cmat_sched_t* sched;
+  task_t t;
+  int pending;
+  int numa;
+  long nc;
+  long c;
+
+  sched = (nt > 1 && n > 1)? cmat_sched_current(): NULL;
+  numa  = (cmat_ctx_numa() != CMAT_NUMA_NONE);
+
+  if (nt <= 1 || n <= 1) {
+    fn(arg, 0, n);
+
+  } else if (sched) {
+    pending   = 1;
+
+    t.range   = fn;
+    t.func    = NULL;
+    t.arg     = arg;
+    t.i0      = 0;
+    t.i1      = n;
+    t.grain   = n / ((long)nt * SPLIT_FACTOR);
+    t.pending = &pending;
+
+    if (t.grain < 1) t.grain = 1;
+
+    if (numa && sched->nthreads > 0 && my_slot(sched) == 0) {
+      nc = (nt < sched->nslots)? nt: sched->nslots;
+      spread_task(sched, &t, (int)((nc < n)? nc: n));
+    }
+
+    if (sched->submit) submit_helpers(sched, nt - 1);
+
+    run_task(sched, &t);
+    wait_tasks(sched, &pending);
+
+  } else if (numa) {
+    /* OpenMP (スレッドcにc番目の連続した範囲を固定で割り当てる) */
+    nc = (nt < n)? nt: n;
+
+#pragma omp parallel for schedule(static, 1) num_threads(nt)
+    for (c = 0; c < nc; c++) {
+      fn(arg, (n * c) / nc, (n * (c + 1)) / nc);
+    }
+
+  } else {
+    /* OpenMP (ntの各スレッドに数個ずつの範囲を動的に割り当てる) */
+    nc = (long)nt * SPLIT_FACTOR;
+    if (nc > n) nc = n;
+
+#pragma omp parallel for schedule(dynamic) num_threads(nt)
+    for (c = 0; c < nc; c++) {
+      fn(arg, (n * c) / nc, (n * (c + 1)) / nc);
+    }
+  }
+}
+
+void
+cmat_task_spawn(cmat_task_group_t* grp, void (*fn)(void*), void* arg)
+{
+  cmat_sched_t* sched;
+  task_t t;
+
+  sched = cmat_sched_current();
+
+  t.range   = NULL;
+  t.func    = fn;
+  t.arg     = arg;
+  t.i0      = 0;
+  t.i1      = 1;
+  t.grain   = 1;
+  t.pending = &grp->pending;
+
+  __atomic_add_fetch(&grp->pending, 1, __ATOMIC_RELAXED);
+
+  if (sched == NULL || push_task(sched, my_slot(sched), &t)) {
+    /* スケジューラが無い(またはキューが一杯の)場合はその場で実行する */
+    fn(arg);
+    __atomic_sub_fetch(&grp->pending, 1, __ATOMIC_RELEASE);
+
+  } else if (sched->submit) {
+    submit_helpers(sched, 1);
+  }
+}
+
+void
+cmat_task_wait(cmat_task_group_t* grp)
+{
+  cmat_sched_t* sched;
+
+  sched = cmat_sched_current();
+
+  if (sched) {
+    wait_tasks(sched, &grp->pending);
+  } else {
+    while (__atomic_load_n(&grp->pending, __ATOMIC_ACQUIRE) > 0) {
+      sched_yield();
+    }
+  }
+}
+
+int
+cmat_sched_post(cmat_sched_t* sched, void (*fn)(void*), void* arg)
+{
+  int ret;
+  task_t t;
+
+  t.range   = NULL;
+  t.func    = fn;
+  t.arg     = arg;
+  t.i0      = 0;
+  t.i1      = 1;
+  t.grain   = 1;
+  t.pending = NULL;
+
+  ret = push_task(sched, my_slot(sched), &t);
+
+  if (!ret && sched->submit) submit_helpers(sched, 1);
+
+  return ret;
+}
+
+int
+cmat_sched_help(cmat_sched_t* sched)
+{
+  int ret;
+  task_t t;
+
+  ret = find_task(sched, my_slot(sched), &t);
+  if (ret) run_task(sched, &t);
+
+  return ret;
+}
+
+int
+cmat_sched_has_workers(cmat_sched_t* sched)
+{
+  return (sched->nthreads > 0 || sched->submit != NULL);
+}
+
+static void
+create_default(void)
+{
+  long ncpu;
+
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (cmat_sched_new((ncpu > 1)? (int)ncpu - 1: 1, &default_sched)) {
+    default_sched = NULL;
+  }
+}
+
+cmat_sched_t*
+cmat_sched_default(void)
+{
+  pthread_once(&default_once, create_default);
+
+  return default_sched;
+}
+
+static int
+alloc_sched(int nslots, cmat_sched_t** dst)
+{
+  int ret;
+  cmat_sched_t* obj;
+  int i;
+
+  ret = 0;
+  obj = (cmat_sched_t*)malloc(sizeof(cmat_sched_t));
+
+  if (obj == NULL) {
+    ret = CMAT_ERR_NOMEM;
+
+  } else {
+    memset(obj, 0, sizeof(cmat_sched_t));
+
+    obj->nslots = nslots;
+    obj->dq     = (deque_t*)malloc(sizeof(deque_t) * nslots);
+    obj->wk     = (worker_t*)malloc(sizeof(worker_t) * nslots);
+
+    if (obj->dq == NULL || obj->wk == NULL) {
+      if (obj->dq) free(obj->dq);
+      if (obj->wk) free(obj->wk);
+      free(obj);
+
+      ret = CMAT_ERR_NOMEM;
+    }
+  }
+
+  if (!ret) {
+    for (i = 0; i < nslots; i++) {
+      pthread_mutex_init(&obj->dq[i].lock, NULL);
+      obj->dq[i].top    = 0;
+      obj->dq[i].bottom = 0;
+
+      obj->wk[i].sched  = obj;
+      obj->wk[i].slot   = i;
+      obj->wk[i].busy   = 0;
+    }
+
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_cond_init(&obj->cond, NULL);
+
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+static void
+free_sched(cmat_sched_t* ptr)
+{
+  int i;
+
+  for (i = 0; i < ptr->nslots; i++) {
+    pthread_mutex_destroy(&ptr->dq[i].lock);
+  }
+
+  pthread_mutex_destroy(&ptr->lock);
+  pthread_cond_destroy(&ptr->cond);
+
+  if (ptr->th) free(ptr->th);
+  free(ptr->dq);
+  free(ptr->wk);
+  free(ptr);
+}
+
+/*
+ * 内部ワーカの停止
+ */
+static void
+stop_workers(cmat_sched_t* ptr, int n)
+{
+  int i;
+
+  pthread_mutex_lock(&ptr->lock);
+  __atomic_store_n(&ptr->stop, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&ptr->cond);
+  pthread_mutex_unlock(&ptr->lock);
+
+  for (i = 0; i < n; i++) {
+    pthread_join(ptr->th[i], NULL);
+  }
+}
+
+/**
+ * スケジューラの生成(内部ワーカ)
+ *
+ * @param nthreads  生成するワーカスレッドの数(0の場合はオンラインのCPU数
+ *                  - 1)
+ * @param dst       生成したスケジューラの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 演算の呼び出し元のスレッドもタスクを処理するので、並列度は
+ *       nthreads + 1になる。cmat_ctx_set_sched()でコンテキストに設定して
+ *       使用する。
+ */
+int
+cmat_sched_new(int nthreads, cmat_sched_t** dst)
+{
+  int ret;
+  cmat_sched_t* obj;
+  long ncpu;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+  i   = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (nthreads < 0) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  if (!ret && nthreads == 0) {
+    ncpu     = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpu > 1)? (int)ncpu - 1: 0;
+  }
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ret = alloc_sched(nthreads + 1, &obj);
+  }
+
+  if (!ret && nthreads > 0) {
+    obj->th = (pthread_t*)malloc(sizeof(pthread_t) * nthreads);
+    if (obj->th == NULL) ret = CMAT_ERR_NOMEM;
+  }
+
+  /*
+   * start workers
+   */
+  if (!ret) {
+    obj->nthreads = nthreads;
+
+    for (i = 0; i < nthreads; i++) {
+      if (pthread_create(obj->th + i, NULL, worker_main, obj->wk + (i + 1))) {
+        ret = CMAT_ERR_NOMEM;
+        break;
+      }
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = obj;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (obj) {
+      stop_workers(obj, i);
+      free_sched(obj);
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * スケジューラの生成(外部ワーカ)
+ *
+ * @param nworkers  同時に投入する外部ワーカの最大数
+ * @param submit    ホストのスレッドプールへのジョブの投入関数
+ * @param user      submitに渡す任意のポインタ
+ * @param dst       生成したスケジューラの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note スレッドは生成しない。並列に処理するタスクが生じると、submit(job,
+ *       arg, user)でホストのスレッドプールにジョブを投入する。ホストは任
+ *       意のスレッドでjob(arg)を必ず一度呼び出すこと(cmat_sched_destroy()
+ *       は投入したジョブが戻るのを待つ)。ジョブはキューが空になると戻る。
+ *       ジョブの実行が遅れても呼び出し元のスレッドが残りのタスクを処理す
+ *       るので、演算はジョブの実行を待たずに完了する。
+ */
+int
+cmat_sched_new_external(int nworkers,
+                        void (*submit)(void (*job)(void*), void* arg,
+                                       void* user),
+                        void* user, cmat_sched_t** dst)
+{
+  int ret;
+  cmat_sched_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (submit == NULL || dst == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (nworkers < 1) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ret = alloc_sched(nworkers + 1, &obj);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    obj->submit = submit;
+    obj->user   = user;
+
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * スケジューラの削除
+ *
+ * @param ptr   削除するスケジューラ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note 内部ワーカを停止し、投入済みの外部ワーカのジョブが戻るのを待つ。
+ *       ptrを設定したコンテキストで演算を行っている間に呼び出してはなら
+ *       ない。
+ */
+int
+cmat_sched_destroy(cmat_sched_t* ptr)
+{
+  int ret;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * stop workers
+   */
+  if (!ret) {
+    stop_workers(ptr, ptr->nthreads);
+
+    for (i = 1; i < ptr->nslots; i++) {
+      while (__atomic_load_n(&ptr->wk[i].busy, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+      }
+    }
+
+    free_sched(ptr);
+  }
+
+  return ret;
+}
+
+/**
+ * ワーカスレッドのNUMAノードへの固定
+ *
+ * @param ptr     対象のスケジューラ
+ * @param policy  配置方針(CMAT_NUMA_*)
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note スロットk(ワーカk)を、並列forのk番目のブロックを置く方針に合わせ
+ *       たノードのCPUに固定する(CMAT_NUMA_FIRST_TOUCHとCMAT_NUMA_ROW_
+ *       BLOCKSではノードの順に連続して、CMAT_NUMA_INTERLEAVEでは各ノード
+ *       に交互に割り当てる)。CMAT_NUMA_NONEで固定を解除する。呼び出し元
+ *       のスレッド(スロット0)は固定しないので、必要な場合は先頭のノード
+ *       に固定しておくこと。外部ワーカのスケジューラ、およびノードが一つ
+ *       しか無い環境では何もしない。
+ */
+int
+cmat_sched_set_numa(cmat_sched_t* ptr, int policy)
+{
+  int ret;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = CMAT_ERR_BADDR;
+      break;
+    }
+
+    if (policy < CMAT_NUMA_NONE || policy > CMAT_NUMA_ROW_BLOCKS) {
+      ret = CMAT_ERR_INVAL;
+      break;
+    }
+  } while (0);
+
+  /*
+   * pin workers
+   */
+  if (!ret) {
+    for (i = 0; i < ptr->nthreads; i++) {
+      cmat_numa_pin(ptr->th[i], cmat_numa_node_of(policy, i + 1, ptr->nslots));
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,74 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_MATRIX_PARALLEL_H__
+#define __CHEAP_MATRIX_PARALLEL_H__
+
+/*
+ * 並列実行の基本操作
+ *
+ * カレントコンテキストにスケジューラ(cmat_sched_t)が設定されている場合、
+ * またはスケジューラのワーカ上で実行している場合はそのスケジューラで、そ
+ * れ以外はOpenMPで並列に処理する(OpenMPを使わずにビルドした場合は逐次に
+ * 処理する)。
+ */
+
+/* [i0, i1)の範囲を処理する関数 */
+typedef void (*cmat_range_fn_t)(void* arg, long i0, long i1);
+
+/*
+ * [0, n)の範囲をfnで分割して処理する
+ *  ntは並列化に使うスレッド数(cmat_ctx_threads()の戻り値)で、1以下の場
+ *  合は呼び出し元のスレッドでfn(arg, 0, n)を実行する。全ての範囲の処理が
+ *  終わるまで戻らない。
+ */
+void cmat_parallel_for(long n, int nt, cmat_range_fn_t fn, void* arg);
+
+/*
+ * タスクの生成と完了待ち
+ *  fn(arg)をタスクとしてスケジューラに投入し、grpで完了を待ち合わせる。
+ *  スケジューラが無い場合はその場で実行する。grpは0で初期化しておくこと。
+ *  完了を待つスレッドは待ちの間も他のタスクを処理する。
+ */
+typedef struct {
+  int pending;
+} cmat_task_group_t;
+
+void cmat_task_spawn(cmat_task_group_t* grp, void (*fn)(void*), void* arg);
+void cmat_task_wait(cmat_task_group_t* grp);
+
+/*
+ * 現在のスレッドで使用するスケジューラ(無い場合はNULL)とその並列度
+ */
+cmat_sched_t* cmat_sched_current(void);
+int cmat_sched_size(cmat_sched_t* sched);
+
+/*
+ * 待ち合わせを行わないタスクの投入
+ *  fn(arg)をschedの投入口に積み、ワーカを起こして直ちに戻る。キューが一
+ *  杯の場合は!0を返す(タスクは投入されない)。
+ */
+int cmat_sched_post(cmat_sched_t* sched, void (*fn)(void*), void* arg);
+
+/*
+ * schedのキューからタスクを一つ取り出して実行する(無い場合は0を返す)
+ */
+int cmat_sched_help(cmat_sched_t* sched);
+
+/*
+ * schedが投入されたタスクを呼び出し元と独立に処理できるか(内部ワーカま
+ * たは外部ワーカを持つか)
+ */
+int cmat_sched_has_workers(cmat_sched_t* sched);
+
+/*
+ * ライブラリ既定のスケジューラ(最初の呼び出しで生成する。生成できなかっ
+ * た場合はNULL)
+ *  ワーカ数はオンラインのCPU数 - 1(最低1)で、プロセスの終了まで存続する。
+ */
+cmat_sched_t* cmat_sched_default(void);
+
+#endif /* !defined(__CHEAP_MATRIX_PARALLEL_H__) */
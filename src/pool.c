@@ -0,0 +1,279 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * 行列オブジェクト用のメモリプール
+ *
+ *  プールから確保する領域は2のべき乗の大きさのサイズクラスに切り上げ、解放
+ *  時にはクラスごとのフリーリストに戻す。同じ形状の行列の生成と削除を繰り返
+ *  す場合、二回目以降はフリーリストの領域が再利用されるのでmalloc()は発生し
+ *  ない。
+ *
+ *  各領域の先頭にはHEADER_SIZEバイトのヘッダを置き、使用中の領域を双方向リ
+ *  ストで管理する(cmat_pool_reset()で一括して回収するため)。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmat.h"
+#include "pool.h"
+
+#define ALIGN_BYTES         64
+#define HEADER_SIZE         64
+#define MIN_CLASS           6
+#define NUM_CLASSES         48
+
+typedef struct __block__ {
+  struct __block__* prev;
+  struct __block__* next;
+  int cls;
+} block_t;
+
+struct __cmat_pool__ {
+  block_t* free[NUM_CLASSES];
+  block_t* live;
+};
+
+#define BLOCK(p)            ((block_t*)((char*)(p) - HEADER_SIZE))
+#define PAYLOAD(b)          ((void*)((char*)(b) + HEADER_SIZE))
+#define CLASS_SIZE(c)       ((size_t)1 << (c))
+
+static int
+size_class(size_t size)
+{
+  int ret;
+
+  ret = MIN_CLASS;
+  while (ret < NUM_CLASSES - 1 && CLASS_SIZE(ret) < size) ret++;
+
+  return (CLASS_SIZE(ret) < size)? -1: ret;
+}
+
+static void
+link_live(cmat_pool_t* pool, block_t* b)
+{
+  b->prev = NULL;
+  b->next = pool->live;
+
+  if (pool->live) pool->live->prev = b;
+  pool->live = b;
+}
+
+static void
+unlink_live(cmat_pool_t* pool, block_t* b)
+{
+  if (b->prev) {
+    b->prev->next = b->next;
+  } else {
+    pool->live = b->next;
+  }
+
+  if (b->next) b->next->prev = b->prev;
+}
+
+static void
+free_list(block_t* b)
+{
+  block_t* nx;
+
+  while (b) {
+    nx = b->next;
+    free(b);
+    b  = nx;
+  }
+}
+
+/*
+ * 領域の確保
+ *  確保した領域は常にALIGN_BYTES境界に揃う。poolがNULLの場合はプールを介
+ *  さずに直接確保する。
+ */
+void*
+cmat_mem_alloc(cmat_pool_t* pool, size_t size)
+{
+  void* ret;
+  block_t* b;
+  int cls;
+
+  if (pool == NULL) {
+    if (posix_memalign(&ret, ALIGN_BYTES, (size > 0)? size: 1)) ret = NULL;
+
+  } else do {
+    ret = NULL;
+    cls = size_class(size);
+    if (cls < 0) break;
+
+    b = pool->free[cls];
+
+    if (b) {
+      pool->free[cls] = b->next;
+
+    } else {
+      if (posix_memalign((void**)&b, ALIGN_BYTES,
+                         HEADER_SIZE + CLASS_SIZE(cls))) break;
+
+      b->cls = cls;
+    }
+
+    link_live(pool, b);
+    ret = PAYLOAD(b);
+  } while (0);
+
+  return ret;
+}
+
+/*
+ * 領域の解放
+ */
+void
+cmat_mem_free(cmat_pool_t* pool, void* ptr)
+{
+  block_t* b;
+
+  if (pool == NULL) {
+    free(ptr);
+
+  } else if (ptr != NULL) {
+    b = BLOCK(ptr);
+
+    unlink_live(pool, b);
+
+    b->next = pool->free[b->cls];
+    pool->free[b->cls] = b;
+  }
+}
+
+/**
+ * メモリプールの生成
+ *
+ * @param dst   生成したプールの格納先のポインタ
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note プールはスレッドセーフではない。複数のスレッドから同じプールを
+ *       使用する場合は呼び出し側で排他を行うこと。
+ */
+int
+cmat_pool_new(cmat_pool_t** dst)
+{
+  int ret;
+  cmat_pool_t* obj;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  obj = NULL;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    obj = (cmat_pool_t*)malloc(sizeof(cmat_pool_t));
+    if (obj == NULL) ret = CMAT_ERR_NOMEM;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    memset(obj, 0, sizeof(cmat_pool_t));
+    *dst = obj;
+  }
+
+  return ret;
+}
+
+/**
+ * メモリプールの一括回収
+ *
+ * @param ptr   対象のプール
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note プールから生成した全ての行列オブジェクトの領域をフリーリストに戻す。
+ *       以降、それらのオブジェクトは(cmat_destroy()を含めて)使用できない。
+ */
+int
+cmat_pool_reset(cmat_pool_t* ptr)
+{
+  int ret;
+  block_t* b;
+  block_t* nx;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * move live blocks to free lists
+   */
+  if (!ret) {
+    for (b = ptr->live; b != NULL; b = nx) {
+      nx = b->next;
+
+      b->next = ptr->free[b->cls];
+      ptr->free[b->cls] = b;
+    }
+
+    ptr->live = NULL;
+  }
+
+  return ret;
+}
+
+/**
+ * メモリプールの削除
+ *
+ * @param ptr   削除するプール
+ *
+ * @return エラーコード(0で正常終了)
+ *
+ * @note プールから生成した行列オブジェクトの領域も全て解放される。
+ */
+int
+cmat_pool_destroy(cmat_pool_t* ptr)
+{
+  int ret;
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) ret = CMAT_ERR_BADDR;
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    free_list(ptr->live);
+
+    for (i = 0; i < NUM_CLASSES; i++) {
+      free_list(ptr->free[i]);
+    }
+
+    free(ptr);
+  }
+
+  return ret;
+}
@@ -0,0 +1,22 @@
+﻿/*
+ * Cheap maxtrix library for C
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_MATRIX_POOL_H__
+#define __CHEAP_MATRIX_POOL_H__
+
+#include <stddef.h>
+
+/*
+ * 行列オブジェクトの領域確保・解放
+ *
+ * 確保した領域は64バイト(キャッシュライン)境界に揃う。poolがNULLの場合は
+ * プールを介さずに確保・解放する。プールから確保した領域は必ず同じプール
+ * を指定して解放すること。
+ */
+void* cmat_mem_alloc(cmat_pool_t* pool, size_t size);
+void cmat_mem_free(cmat_pool_t* pool, void* ptr);
+
+#endif /* !defined(__CHEAP_MATRIX_POOL_H__) */
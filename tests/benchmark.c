@@ -110,6 +110,30 @@ bench_product(tmmes_t* tm)
   cmat_destroy(m2);
 }
 
+void
+bench_product_large(tmmes_t* tm)
+{
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+  int i;
+
+  cmat_new(NULL, 1000, 1000, &m1);
+  cmat_new(NULL, 1000, 1000, &m2);
+
+  start_timer(tm);
+
+  for (i = 0; i < 5; i++) {
+    cmat_product(m1, m2, &m3);
+    cmat_destroy(m3);
+  }
+
+  stop_timer(tm);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+}
+
 void
 bench_det(tmmes_t* tm)
 {
@@ -141,6 +165,29 @@ bench_det(tmmes_t* tm)
   cmat_destroy(m);
 }
 
+void
+bench_dot(tmmes_t* tm)
+{
+  cmat_t* m1;
+  cmat_t* m2;
+  float dot;
+  int i;
+
+  cmat_new(NULL, 1000, 1000, &m1);
+  cmat_new(NULL, 500, 2000, &m2);
+
+  start_timer(tm);
+
+  for (i = 0; i < 200; i++) {
+    cmat_dot(m1, m2, &dot);
+  }
+
+  stop_timer(tm);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+}
+
 void
 bench_inverse(tmmes_t* tm)
 {
@@ -173,7 +220,60 @@ bench_inverse(tmmes_t* tm)
   cmat_destroy(m1);
 }
 
+void
+bench_inverse4(tmmes_t* tm)
+{
+  cmat_t* m;
+  int i;
+  float v[] = {
+    4, 1, 0, 2,
+    1, 5, 1, 0,
+    0, 1, 6, 1,
+    2, 0, 1, 7
+  };
+
+  cmat_new(v, 4, 4, &m);
+
+  start_timer(tm);
+
+  for (i = 0; i < 1000000; i++) {
+    cmat_inverse(m, NULL);
+  }
+
+  stop_timer(tm);
+
+  cmat_destroy(m);
+}
+
+void
+bench_batch_inverse(tmmes_t* tm)
+{
+  cmat_batch_t* b1;
+  cmat_batch_t* b2;
+  float* val;
+  int i;
+
+  val = (float*)malloc(sizeof(float) * 100000 * 16);
+
+  srand(0);
+  for (i = 0; i < 100000 * 16; i++) {
+    val[i] = (float)rand() / RAND_MAX + (((i % 16) % 5 == 0)? 4.0f: 0.0f);
+  }
+
+  cmat_batch_new(val, 100000, 4, 4, &b1);
+
+  start_timer(tm);
+
+  for (i = 0; i < 20; i++) {
+    cmat_batch_inverse(b1, &b2);
+    cmat_batch_destroy(b2);
+  }
 
+  stop_timer(tm);
+
+  cmat_batch_destroy(b1);
+  free(val);
+}
 
 int
 main(int argc, char* argv[])
@@ -192,11 +292,23 @@ main(int argc, char* argv[])
   bench_product(&tm);
   printf("product %10.2f msec\n", tm.tm / 1000000.0);
 
+  bench_product_large(&tm);
+  printf("prod1k  %10.2f msec\n", tm.tm / 1000000.0);
+
   bench_det(&tm);
   printf("det     %10.2f msec\n", tm.tm / 1000000.0);
 
+  bench_dot(&tm);
+  printf("dot     %10.2f msec\n", tm.tm / 1000000.0);
+
   bench_inverse(&tm);
   printf("inverse %10.2f msec\n", tm.tm / 1000000.0);
 
+  bench_inverse4(&tm);
+  printf("inv4x4  %10.2f msec\n", tm.tm / 1000000.0);
+
+  bench_batch_inverse(&tm);
+  printf("binv4x4 %10.2f msec\n", tm.tm / 1000000.0);
+
   return 0;
 }
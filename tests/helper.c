@@ -0,0 +1,41 @@
+#include <stdlib.h>
+#include "helper.h"
+
+float*
+random_values(int n)
+{
+  float* ret;
+  int i;
+
+  ret = (float*)malloc(sizeof(float) * n);
+
+  for (i = 0; i < n; i++) {
+    ret[i] = (float)((rand() % 19) - 9);
+  }
+
+  return ret;
+}
+
+cmat_t*
+random_matrix(int rows, int cols)
+{
+  cmat_t* ret;
+  float* val;
+
+  val = random_values(rows * cols);
+
+  cmat_new(val, rows, cols, &ret);
+  free(val);
+
+  return ret;
+}
+
+int
+is_equal(cmat_t* m1, cmat_t* m2)
+{
+  int res;
+
+  cmat_compare(m1, m2, &res);
+
+  return (res == 0);
+}
@@ -0,0 +1,21 @@
+#ifndef __TEST_HELPER_H__
+#define __TEST_HELPER_H__
+
+#include "cmat.h"
+
+/*
+ * テスト用の乱数の値 (-9〜9の整数値をn個、呼び出し側でfree()すること)
+ */
+float* random_values(int n);
+
+/*
+ * 乱数の値で初期化した行列
+ */
+cmat_t* random_matrix(int rows, int cols);
+
+/*
+ * 二つの行列が同じ形状・同じ値か
+ */
+int is_equal(cmat_t* m1, cmat_t* m2);
+
+#endif /* !defined(__TEST_HELPER_H__) */
@@ -9,6 +9,7 @@ extern void init_test_add();
 extern void init_test_sub();
 extern void init_test_mul();
 extern void init_test_product();
+extern void init_test_gemm();
 extern void init_test_transpose();
 extern void init_test_det();
 extern void init_test_dot();
@@ -16,6 +17,17 @@ extern void init_test_inverse();
 extern void init_test_lu_decomp();
 extern void init_test_permute_row();
 extern void init_test_permute_column();
+extern void init_test_batch();
+extern void init_test_pool();
+extern void init_test_into();
+extern void init_test_view();
+extern void init_test_wrap();
+extern void init_test_transview();
+extern void init_test_ctx();
+extern void init_test_sched();
+extern void init_test_async();
+extern void init_test_graph();
+extern void init_test_numa();
 
 int
 main(int argc, char* argv[])
@@ -30,6 +42,7 @@ main(int argc, char* argv[])
   init_test_sub();
   init_test_mul();
   init_test_product();
+  init_test_gemm();
   init_test_transpose();
   init_test_det();
   init_test_dot();
@@ -37,6 +50,17 @@ main(int argc, char* argv[])
   init_test_lu_decomp();
   init_test_permute_row();
   init_test_permute_column();
+  init_test_batch();
+  init_test_pool();
+  init_test_into();
+  init_test_view();
+  init_test_wrap();
+  init_test_transview();
+  init_test_ctx();
+  init_test_sched();
+  init_test_async();
+  init_test_graph();
+  init_test_numa();
 
   CU_console_run_tests();
   CU_cleanup_registry();
@@ -1,6 +1,8 @@
 ﻿#include <CUnit/CUnit.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "cmat.h"
 
 static void
@@ -72,6 +74,217 @@ test_normal_2(void)
   cmat_destroy(m);
 }
 
+static int
+check_rows(cmat_t* m, int n)
+{
+  int ret;
+  int i;
+  int j;
+
+  ret = !0;
+
+  for (i = 0; ret && i < n; i++) {
+    for (j = 0; j < m->cols; j++) {
+      if (CMAT_ROW(m, i)[j] != (float)((i * m->cols) + j)) {
+        ret = 0;
+        break;
+      }
+    }
+  }
+
+  return ret;
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_t* m;
+  cmat_t* c;
+  cmat_t* t;
+  cmat_t* tt;
+  float r[16];
+  float* p0;
+  float* p1;
+  int res;
+  int i;
+  int j;
+
+  /*
+   * 既存の行を移動せずに拡張する
+   */
+  cmat_new(NULL, 0, 16, &m);
+
+  p0 = NULL;
+  p1 = NULL;
+
+  for (i = 0; i < 20000; i++) {
+    for (j = 0; j < 16; j++) r[j] = (float)((i * 16) + j);
+
+    CU_ASSERT(cmat_append(m, r) == 0);
+
+    if (i == 5000) {
+      p0 = CMAT_ROW(m, 0);
+      p1 = CMAT_ROW(m, 5000);
+    }
+  }
+
+  CU_ASSERT(m->rows == 20000);
+  CU_ASSERT(m->flags & CMAT_FLAG_SEGMENTED);
+  CU_ASSERT(CMAT_ROW(m, 0) == p0);
+  CU_ASSERT(CMAT_ROW(m, 5000) == p1);
+  CU_ASSERT(check_rows(m, m->rows));
+
+  /*
+   * 演算・複製・転置
+   */
+  CU_ASSERT(cmat_clone(m, &c) == 0);
+  CU_ASSERT(cmat_append(c, r) == 0);
+  CU_ASSERT(c->rows == 20001 && m->rows == 20000);
+  CU_ASSERT(check_rows(c, 20000));
+  CU_ASSERT(memcmp(CMAT_ROW(c, 20000), r, sizeof(r)) == 0);
+  cmat_destroy(c);
+
+  CU_ASSERT(cmat_transpose(m, &t) == 0);
+  CU_ASSERT(cmat_transpose(t, &tt) == 0);
+  CU_ASSERT(cmat_compare(m, tt, &res) == 0);
+  CU_ASSERT(res == 0);
+  cmat_destroy(t);
+  cmat_destroy(tt);
+
+  CU_ASSERT(cmat_add(m, m, &c) == 0);
+  CU_ASSERT(cmat_mul(m, 2.0f, NULL) == 0);
+  CU_ASSERT(cmat_compare(m, c, &res) == 0);
+  CU_ASSERT(res == 0);
+  CU_ASSERT(cmat_mul(m, 0.5f, NULL) == 0);
+  cmat_destroy(c);
+
+  /*
+   * 一つの領域にまとめ直す
+   */
+  CU_ASSERT(cmat_compact(m) == 0);
+  CU_ASSERT(!(m->flags & CMAT_FLAG_SEGMENTED));
+  CU_ASSERT(m->capa == m->rows);
+  CU_ASSERT(check_rows(m, m->rows));
+
+  for (i = 0; i < m->rows; i++) {
+    if (CMAT_ROW(m, i) != m->tbl + ((size_t)i * m->stride)) break;
+  }
+
+  CU_ASSERT(i == m->rows);
+
+  /* 連続化の後も追加できる */
+  CU_ASSERT(cmat_append(m, r) == 0);
+  CU_ASSERT(m->flags & CMAT_FLAG_SEGMENTED);
+  CU_ASSERT(check_rows(m, 20000));
+
+  cmat_destroy(m);
+}
+
+static void
+test_normal_4(void)
+{
+  cmat_t* m;
+  float r[] = {1, 2, 3};
+
+  /*
+   * 小さい行列は一つの領域のまま拡張し、連続化は何もしない
+   */
+  cmat_new(NULL, 0, 3, &m);
+
+  CU_ASSERT(cmat_append(m, r) == 0);
+  CU_ASSERT(!(m->flags & CMAT_FLAG_SEGMENTED));
+  CU_ASSERT(cmat_compact(m) == 0);
+  CU_ASSERT(m->rows == 1 && CMAT_ROW(m, 0)[2] == 3.0f);
+
+  cmat_destroy(m);
+}
+
+static void
+test_normal_5(void)
+{
+  cmat_t* m;
+  float* p0;
+  float src[] = {
+    1, 2, 3, 0,
+    4, 5, 6, 0,
+    7, 8, 9, 0,
+  };
+  float ans[] = {
+    1, 2, 3,
+    4, 5, 6,
+    7, 8, 9,
+    1, 2, 3,
+  };
+  int res;
+
+  /*
+   * 容量の予約と複数行の追加
+   */
+  cmat_new(NULL, 0, 3, &m);
+
+  CU_ASSERT(cmat_reserve(m, 100) == 0);
+  CU_ASSERT(m->capa >= 100 && m->rows == 0);
+
+  CU_ASSERT(cmat_append_rows(m, src, 3, 4) == 0);
+  CU_ASSERT(m->rows == 3);
+  p0 = CMAT_ROW(m, 0);
+
+  CU_ASSERT(cmat_append(m, src) == 0);
+  CU_ASSERT(CMAT_ROW(m, 0) == p0);
+  CU_ASSERT(cmat_check(m, ans, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  /* 予約済みの容量より小さい指定は何もしない */
+  CU_ASSERT(cmat_reserve(m, 10) == 0);
+  CU_ASSERT(m->capa >= 100 && CMAT_ROW(m, 0) == p0);
+
+  /*
+   * 余剰な容量の解放
+   */
+  CU_ASSERT(cmat_shrink_to_fit(m) == 0);
+  CU_ASSERT(m->capa == m->rows);
+  CU_ASSERT(cmat_check(m, ans, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  cmat_destroy(m);
+}
+
+static void
+test_normal_6(void)
+{
+  cmat_t* m;
+  cmat_t* c;
+  float* src;
+  int n;
+  int i;
+
+  /*
+   * 並列化・セグメント化が行われる大きさでの一括追加
+   */
+  n   = 50000;
+  src = (float*)malloc(sizeof(float) * n * 16);
+
+  for (i = 0; i < n * 16; i++) src[i] = (float)i;
+
+  cmat_new(NULL, 0, 16, &m);
+
+  CU_ASSERT(cmat_append_rows(m, src, 10000, 16) == 0);
+  CU_ASSERT(cmat_clone(m, &c) == 0);
+  CU_ASSERT(cmat_append_rows(m, src + (10000 * 16), n - 10000, 16) == 0);
+  CU_ASSERT(m->rows == n && c->rows == 10000);
+  CU_ASSERT(check_rows(m, n));
+  CU_ASSERT(check_rows(c, 10000));
+
+  CU_ASSERT(cmat_shrink_to_fit(m) == 0);
+  CU_ASSERT(!(m->flags & CMAT_FLAG_SEGMENTED));
+  CU_ASSERT(m->capa == n);
+  CU_ASSERT(check_rows(m, n));
+
+  cmat_destroy(c);
+  cmat_destroy(m);
+  free(src);
+}
+
 static void
 test_error_1(void)
 {
@@ -94,6 +307,40 @@ test_error_2(void)
   CU_ASSERT(err == CMAT_ERR_BADDR);
 }
 
+static void
+test_error_3(void)
+{
+  CU_ASSERT(cmat_compact(NULL) == CMAT_ERR_BADDR);
+}
+
+static void
+test_error_4(void)
+{
+  cmat_t* m;
+  cmat_t* t;
+  float r[] = {1, 2, 3};
+
+  cmat_new(NULL, 0, 3, &m);
+  cmat_transpose_view(m, &t);
+
+  CU_ASSERT(cmat_append_rows(NULL, r, 1, 3) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_append_rows(m, NULL, 1, 3) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_append_rows(m, r, -1, 3) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_append_rows(m, r, 1, 2) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_append_rows(t, r, 1, 3) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_append_rows(m, r, 0, 3) == 0);
+  CU_ASSERT(m->rows == 0);
+
+  CU_ASSERT(cmat_reserve(NULL, 10) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_reserve(m, -1) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_reserve(t, 10) == CMAT_ERR_INVAL);
+
+  CU_ASSERT(cmat_shrink_to_fit(NULL) == CMAT_ERR_BADDR);
+
+  cmat_destroy(t);
+  cmat_destroy(m);
+}
+
 void
 init_test_append()
 {
@@ -102,6 +349,12 @@ init_test_append()
   suite = CU_add_suite("append row", NULL, NULL);
   CU_add_test(suite, "append#1", test_normal_1);
   CU_add_test(suite, "append#2", test_normal_2);
+  CU_add_test(suite, "append#3", test_normal_3);
+  CU_add_test(suite, "append#4", test_normal_4);
+  CU_add_test(suite, "append#5", test_normal_5);
+  CU_add_test(suite, "append#6", test_normal_6);
   CU_add_test(suite, "append#E1", test_error_1);
   CU_add_test(suite, "append#E2", test_error_2);
+  CU_add_test(suite, "append#E3", test_error_3);
+  CU_add_test(suite, "append#E4", test_error_4);
 }
@@ -0,0 +1,447 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "cmat.h"
+#include "helper.h"
+
+static void
+on_complete(cmat_future_t* fut, int res, void* user)
+{
+  int* p;
+
+  p = (int*)user;
+  p[0]++;
+  p[1] = res;
+}
+
+static void
+on_complete_destroy(cmat_future_t* fut, int res, void* user)
+{
+  cmat_future_destroy(fut);
+  __atomic_store_n((int*)user, 1, __ATOMIC_RELEASE);
+}
+
+static void
+on_complete_slow(cmat_future_t* fut, int res, void* user)
+{
+  int i;
+
+  for (i = 0; i < 1000; i++) sched_yield();
+  __atomic_store_n((int*)user, 1, __ATOMIC_RELEASE);
+}
+
+static void
+on_complete_notify(cmat_future_t* fut, int res, void* user)
+{
+  __atomic_store_n((int*)user, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * ホスト側のスレッドプールの代わり(投入されたジョブごとにスレッドを起動)
+ */
+typedef struct {
+  void (*job)(void*);
+  void* arg;
+  int* live;
+} host_job_t;
+
+static void*
+host_thread(void* arg)
+{
+  host_job_t* hj;
+
+  hj = (host_job_t*)arg;
+  hj->job(hj->arg);
+  __atomic_sub_fetch(hj->live, 1, __ATOMIC_RELEASE);
+  free(hj);
+
+  return NULL;
+}
+
+static void
+host_submit(void (*job)(void*), void* arg, void* user)
+{
+  host_job_t* hj;
+  pthread_t th;
+
+  hj       = (host_job_t*)malloc(sizeof(host_job_t));
+  hj->job  = job;
+  hj->arg  = arg;
+  hj->live = (int*)user;
+
+  __atomic_add_fetch(hj->live, 1, __ATOMIC_RELAXED);
+  pthread_create(&th, NULL, host_thread, hj);
+  pthread_detach(th);
+}
+
+static void
+test_normal_1(void)
+{
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c1;
+  cmat_t* c2;
+  cmat_t* lu1;
+  cmat_t* lu2;
+  cmat_future_t* f1;
+  cmat_future_t* f2;
+  cmat_future_t* f3;
+  int piv1[120];
+  int piv2[120];
+  int done;
+  int res;
+  int i;
+
+  /*
+   * 既定のスケジューラで実行
+   */
+  a = random_matrix(120, 120);
+  b = random_matrix(120, 120);
+
+  CU_ASSERT(cmat_product_async(NULL, a, b, &c1, &f1) == 0);
+  CU_ASSERT(cmat_inverse_async(NULL, a, &c2, &f2) == 0);
+  CU_ASSERT(cmat_lu_decomp_async(NULL, a, &lu1, piv1, &f3) == 0);
+
+  do {
+    CU_ASSERT(cmat_future_poll(f1, &done) == 0);
+    if (!done) sched_yield();
+  } while (!done);
+
+  res = -1;
+  CU_ASSERT(cmat_future_wait(f1, &res) == 0);
+  CU_ASSERT(res == 0);
+  CU_ASSERT(cmat_future_wait(f2, &res) == 0);
+  CU_ASSERT(res == 0);
+  CU_ASSERT(cmat_future_wait(f3, NULL) == 0);
+
+  cmat_product(a, b, &lu2);
+  CU_ASSERT(is_equal(c1, lu2));
+  cmat_destroy(lu2);
+
+  cmat_inverse(a, &lu2);
+  CU_ASSERT(is_equal(c2, lu2));
+  cmat_destroy(lu2);
+
+  cmat_lu_decomp(a, &lu2, piv2);
+  CU_ASSERT(is_equal(lu1, lu2));
+  for (i = 0; i < 120; i++) CU_ASSERT(piv1[i] == piv2[i]);
+  cmat_destroy(lu2);
+
+  CU_ASSERT(cmat_future_destroy(f1) == 0);
+  CU_ASSERT(cmat_future_destroy(f2) == 0);
+  CU_ASSERT(cmat_future_destroy(f3) == 0);
+
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+  cmat_destroy(lu1);
+  cmat_destroy(a);
+  cmat_destroy(b);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  cmat_t* a;
+  cmat_t* c1;
+  cmat_t* c2;
+  cmat_future_t* fut[4];
+  cmat_t* dst[4];
+  int cnt[2];
+  int flag;
+  int res;
+  int i;
+
+  float val[] = {
+    1, 2,
+    2, 4,
+  };
+
+  cmat_sched_new(2, &sched);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  /*
+   * 複数の演算を同時に実行
+   */
+  a = random_matrix(60, 60);
+  cmat_inverse(a, &c2);
+
+  for (i = 0; i < 4; i++) {
+    CU_ASSERT(cmat_inverse_async(ctx, a, dst + i, fut + i) == 0);
+  }
+
+  for (i = 0; i < 4; i++) {
+    CU_ASSERT(cmat_future_wait(fut[i], &res) == 0);
+    CU_ASSERT(res == 0);
+    CU_ASSERT(is_equal(dst[i], c2));
+
+    cmat_future_destroy(fut[i]);
+    cmat_destroy(dst[i]);
+  }
+
+  /*
+   * 完了時のコールバック(完了後の設定はその場で呼び出される)
+   */
+  cnt[0] = 0;
+  cnt[1] = -1;
+
+  CU_ASSERT(cmat_product_async(ctx, a, a, &c1, fut) == 0);
+  cmat_future_wait(fut[0], NULL);
+  CU_ASSERT(cmat_future_set_callback(fut[0], on_complete, cnt) == 0);
+  CU_ASSERT(cnt[0] == 1);
+  CU_ASSERT(cnt[1] == 0);
+  cmat_future_destroy(fut[0]);
+  cmat_destroy(c1);
+
+  /* コールバックの中でハンドルを削除する */
+  flag = 0;
+  CU_ASSERT(cmat_inverse_async(ctx, a, &c1, fut) == 0);
+  CU_ASSERT(cmat_future_set_callback(fut[0], on_complete_destroy,
+                                     &flag) == 0);
+  while (!__atomic_load_n(&flag, __ATOMIC_ACQUIRE)) sched_yield();
+  cmat_destroy(c1);
+
+  /*
+   * 演算のエラーは完了待ちで返る
+   */
+  cmat_destroy(a);
+  cmat_new(val, 2, 2, &a);
+
+  c1 = NULL;
+  CU_ASSERT(cmat_inverse_async(ctx, a, &c1, fut) == 0);
+  CU_ASSERT(cmat_future_wait(fut[0], &res) == 0);
+  CU_ASSERT(res == CMAT_ERR_NREGL);
+  CU_ASSERT(c1 == NULL);
+  cmat_future_destroy(fut[0]);
+
+  cmat_destroy(a);
+  cmat_destroy(c2);
+  cmat_ctx_destroy(ctx);
+  cmat_sched_destroy(sched);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  cmat_pool_t* pool;
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c[3];
+  cmat_t* d;
+  cmat_future_t* fut[3];
+  float* val;
+  int piv1[80];
+  int piv2[80];
+  int flag;
+  int res;
+  int i;
+
+  cmat_sched_new(2, &sched);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  /*
+   * 同じプールから確保した行列の演算を同時に実行
+   *  (結果は呼び出し元のスレッドで同じプールから確保される)
+   */
+  cmat_pool_new(&pool);
+  val = (float*)malloc(sizeof(float) * 80 * 80);
+
+  for (i = 0; i < 80 * 80; i++) val[i] = (float)((rand() % 19) - 9);
+  cmat_pool_alloc(pool, val, 80, 80, &a);
+
+  for (i = 0; i < 80 * 80; i++) val[i] = (float)((rand() % 19) - 9);
+  cmat_pool_alloc(pool, val, 80, 80, &b);
+
+  CU_ASSERT(cmat_product_async(ctx, a, b, c + 0, fut + 0) == 0);
+  CU_ASSERT(cmat_inverse_async(ctx, a, c + 1, fut + 1) == 0);
+  CU_ASSERT(cmat_lu_decomp_async(ctx, b, c + 2, piv1, fut + 2) == 0);
+
+  for (i = 0; i < 3; i++) {
+    CU_ASSERT(cmat_future_wait(fut[i], &res) == 0);
+    CU_ASSERT(res == 0);
+    cmat_future_destroy(fut[i]);
+  }
+
+  cmat_product(a, b, &d);
+  CU_ASSERT(is_equal(c[0], d));
+  cmat_destroy(d);
+
+  cmat_inverse(a, &d);
+  CU_ASSERT(is_equal(c[1], d));
+  cmat_destroy(d);
+
+  cmat_lu_decomp(b, &d, piv2);
+  CU_ASSERT(is_equal(c[2], d));
+  for (i = 0; i < 80; i++) CU_ASSERT(piv1[i] == piv2[i]);
+  cmat_destroy(d);
+
+  for (i = 0; i < 3; i++) cmat_destroy(c[i]);
+
+  /* プールから確保した行列の置き換えは行えない */
+  CU_ASSERT(cmat_product_async(ctx, a, b, NULL, fut) == CMAT_ERR_INVAL);
+
+  /* 置き換えを行う逆行列(共有は投入時に解かれる) */
+  cmat_clone(a, &d);
+  CU_ASSERT(cmat_inverse_async(ctx, d, NULL, fut) == 0);
+  CU_ASSERT(cmat_future_wait(fut[0], &res) == 0);
+  CU_ASSERT(res == 0);
+  cmat_future_destroy(fut[0]);
+
+  cmat_inverse(a, c);
+  CU_ASSERT(is_equal(c[0], d));
+  cmat_destroy(c[0]);
+  cmat_destroy(d);
+
+  /*
+   * 完了待ちはコールバックから戻るまで待つ
+   */
+  flag = 0;
+  CU_ASSERT(cmat_product_async(ctx, a, b, &d, fut) == 0);
+  CU_ASSERT(cmat_future_set_callback(fut[0], on_complete_slow, &flag) == 0);
+  CU_ASSERT(cmat_future_wait(fut[0], NULL) == 0);
+  CU_ASSERT(__atomic_load_n(&flag, __ATOMIC_ACQUIRE) == 1);
+  cmat_future_destroy(fut[0]);
+  cmat_destroy(d);
+
+  free(val);
+  cmat_destroy(a);
+  cmat_destroy(b);
+  cmat_pool_destroy(pool);
+  cmat_ctx_destroy(ctx);
+  cmat_sched_destroy(sched);
+}
+
+static void
+test_normal_4(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c;
+  cmat_t* d;
+  cmat_future_t* fut;
+  time_t t0;
+  int live;
+  int flag;
+  int done;
+  int i;
+  int j;
+
+  live = 0;
+  cmat_sched_new_external(1, host_submit, &live, &sched);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+
+  a = random_matrix(4, 4);
+  b = random_matrix(4, 4);
+  cmat_product(a, b, &d);
+
+  /*
+   * 外部ワーカのジョブが戻る前後に次の演算を投入し、完了待ちを行わずに
+   * コールバックのみで完了を確認する(投入したタスクが取り残されない)
+   */
+  for (i = 0; i < 200; i++) {
+    flag = 0;
+    CU_ASSERT(cmat_product_async(ctx, a, b, &c, &fut) == 0);
+    CU_ASSERT(cmat_future_set_callback(fut, on_complete_notify,
+                                       &flag) == 0);
+
+    t0 = time(NULL);
+    while (!__atomic_load_n(&flag, __ATOMIC_ACQUIRE)) {
+      if (time(NULL) - t0 > 5) break;
+      sched_yield();
+    }
+
+    CU_ASSERT(__atomic_load_n(&flag, __ATOMIC_ACQUIRE) == 1);
+    cmat_future_destroy(fut);
+    CU_ASSERT(is_equal(c, d));
+    cmat_destroy(c);
+
+    for (j = 0; j < i % 100; j++) sched_yield();
+  }
+
+  /*
+   * 完了の確認のみで待つ(確認の度にキューのタスクを一つ処理する)
+   */
+  for (i = 0; i < 200; i++) {
+    CU_ASSERT(cmat_product_async(ctx, a, b, &c, &fut) == 0);
+
+    t0 = time(NULL);
+    do {
+      CU_ASSERT(cmat_future_poll(fut, &done) == 0);
+      if (time(NULL) - t0 > 5) break;
+    } while (!done);
+
+    CU_ASSERT(done);
+    cmat_future_destroy(fut);
+    CU_ASSERT(is_equal(c, d));
+    cmat_destroy(c);
+
+    for (j = 0; j < i % 100; j++) sched_yield();
+  }
+
+  cmat_destroy(a);
+  cmat_destroy(b);
+  cmat_destroy(d);
+  cmat_ctx_destroy(ctx);
+  cmat_sched_destroy(sched);
+
+  while (__atomic_load_n(&live, __ATOMIC_ACQUIRE) > 0) sched_yield();
+}
+
+static void
+test_error_1(void)
+{
+  cmat_future_t* fut;
+  cmat_t* m;
+  cmat_t* d;
+  int i;
+
+  cmat_new(NULL, 2, 2, &m);
+
+  CU_ASSERT(cmat_product_async(NULL, NULL, m, &d, &fut) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_product_async(NULL, m, NULL, &d, &fut) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_product_async(NULL, m, m, &d, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_inverse_async(NULL, NULL, &d, &fut) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_inverse_async(NULL, m, &d, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_lu_decomp_async(NULL, NULL, &d, NULL, &fut) ==
+            CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_lu_decomp_async(NULL, m, &d, NULL, NULL) == CMAT_ERR_BADDR);
+
+  CU_ASSERT(cmat_future_wait(NULL, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_future_poll(NULL, &i) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_future_set_callback(NULL, on_complete, NULL) ==
+            CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_future_destroy(NULL) == CMAT_ERR_BADDR);
+
+  CU_ASSERT(cmat_inverse_async(NULL, m, &d, &fut) == 0);
+  CU_ASSERT(cmat_future_poll(fut, NULL) == CMAT_ERR_BADDR);
+  cmat_future_destroy(fut);
+
+  cmat_destroy(m);
+}
+
+void
+init_test_async()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("asynchronous operation", NULL, NULL);
+  CU_add_test(suite, "async#1", test_normal_1);
+  CU_add_test(suite, "async#2", test_normal_2);
+  CU_add_test(suite, "async#3", test_normal_3);
+  CU_add_test(suite, "async#4", test_normal_4);
+  CU_add_test(suite, "async#E1", test_error_1);
+}
@@ -0,0 +1,272 @@
+﻿#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cmat.h"
+#include "helper.h"
+
+#define N(x)        (sizeof(x) / sizeof(*x))
+#define COUNT       5000
+
+static float
+rel_error(float v, float ans)
+{
+  return fabsf(v - ans) / fmaxf(1.0f, fabsf(ans));
+}
+
+static void
+test_normal_1(void)
+{
+  cmat_batch_t* b1;
+  cmat_batch_t* b2;
+  cmat_batch_t* b3;
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+  float* v1;
+  float* v2;
+  float val[CMAT_BATCH_MAX_DIM * CMAT_BATCH_MAX_DIM];
+  float err;
+  int rows;
+  int cols;
+  int i;
+  int j;
+
+  /*
+   * 積の検算(cmat_product()との比較)
+   */
+  srand(3);
+
+  for (rows = 1; rows <= 5; rows++) {
+    cols = 6 - rows;
+    v1   = random_values(COUNT * rows * cols);
+    v2   = random_values(COUNT * cols * rows);
+
+    CU_ASSERT(cmat_batch_new(v1, COUNT, rows, cols, &b1) == 0);
+    CU_ASSERT(cmat_batch_new(v2, COUNT, cols, rows, &b2) == 0);
+    CU_ASSERT(cmat_batch_product(b1, b2, &b3) == 0);
+
+    CU_ASSERT(b3->n == COUNT);
+    CU_ASSERT(b3->rows == rows);
+    CU_ASSERT(b3->cols == rows);
+
+    err = 0.0f;
+
+    for (i = 0; i < COUNT; i++) {
+      cmat_new(v1 + (i * rows * cols), rows, cols, &m1);
+      cmat_new(v2 + (i * rows * cols), cols, rows, &m2);
+      cmat_product(m1, m2, &m3);
+
+      cmat_batch_get(b3, i, val);
+
+      for (j = 0; j < rows * rows; j++) {
+        err = fmaxf(err, rel_error(val[j], CMAT_ROW(m3, j / rows)[j % rows]));
+      }
+
+      cmat_destroy(m1);
+      cmat_destroy(m2);
+      cmat_destroy(m3);
+    }
+
+    CU_ASSERT(err < 1e-6);
+
+    /* 出力先を省略した場合 */
+    CU_ASSERT(cmat_batch_product(b1, b2, NULL) == 0);
+    CU_ASSERT(b1->rows == rows && b1->cols == rows);
+
+    for (j = 0; j < rows * rows; j++) {
+      CU_ASSERT(memcmp(b1->tbl + (j * b1->stride),
+                       b3->tbl + (j * b3->stride), sizeof(float) * COUNT) == 0);
+    }
+
+    cmat_batch_destroy(b1);
+    cmat_batch_destroy(b2);
+    cmat_batch_destroy(b3);
+
+    free(v1);
+    free(v2);
+  }
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_batch_t* b1;
+  cmat_batch_t* b2;
+  cmat_t* m;
+  float* v;
+  float val[16];
+  float* det;
+  float ans;
+  float err1;
+  float err2;
+  int sz;
+  int i;
+  int j;
+
+  /*
+   * 行列式・逆行列の検算(cmat_det(), cmat_inverse()との比較)
+   */
+  srand(5);
+
+  det = (float*)malloc(sizeof(float) * COUNT);
+
+  for (sz = 1; sz <= 4; sz++) {
+    v = random_values(COUNT * sz * sz);
+
+    /* 正則でない行列を含まないように対角成分を大きくする */
+    for (i = 0; i < COUNT; i++) {
+      for (j = 0; j < sz; j++) v[(i * sz * sz) + (j * sz) + j] += 40.0f;
+    }
+
+    cmat_batch_new(v, COUNT, sz, sz, &b1);
+
+    CU_ASSERT(cmat_batch_det(b1, det) == 0);
+    CU_ASSERT(cmat_batch_inverse(b1, &b2) == 0);
+
+    err1 = 0.0f;
+    err2 = 0.0f;
+
+    for (i = 0; i < COUNT; i++) {
+      cmat_new(v + (i * sz * sz), sz, sz, &m);
+
+      cmat_det(m, &ans);
+      err1 = fmaxf(err1, fabsf(det[i] - ans) / fmaxf(1.0f, fabsf(ans)));
+
+      cmat_inverse(m, NULL);
+      cmat_batch_get(b2, i, val);
+
+      for (j = 0; j < sz * sz; j++) {
+        err2 = fmaxf(err2, rel_error(val[j], CMAT_ROW(m, j / sz)[j % sz]));
+      }
+
+      cmat_destroy(m);
+    }
+
+    CU_ASSERT(err1 < 1e-5);
+    CU_ASSERT(err2 < 1e-5);
+
+    cmat_batch_destroy(b1);
+    cmat_batch_destroy(b2);
+
+    free(v);
+  }
+
+  free(det);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_batch_t* b1;
+  cmat_batch_t* b2;
+  float v[] = {
+    1, 2, 3,
+    4, 5, 6,
+
+    7, 8, 9,
+    10, 11, 12,
+  };
+
+  float ans[] = {
+    7, 10,
+    8, 11,
+    9, 12,
+  };
+
+  float val[6];
+
+  /*
+   * 転置と要素の設定・取得
+   */
+  cmat_batch_new(v, 2, 2, 3, &b1);
+
+  CU_ASSERT(cmat_batch_transpose(b1, &b2) == 0);
+  CU_ASSERT(b2->rows == 3 && b2->cols == 2);
+
+  CU_ASSERT(cmat_batch_get(b2, 1, val) == 0);
+  CU_ASSERT(memcmp(val, ans, sizeof(ans)) == 0);
+
+  CU_ASSERT(cmat_batch_set(b2, 0, ans) == 0);
+  CU_ASSERT(cmat_batch_transpose(b2, NULL) == 0);
+  CU_ASSERT(b2->rows == 2 && b2->cols == 3);
+
+  CU_ASSERT(cmat_batch_get(b2, 0, val) == 0);
+  CU_ASSERT(memcmp(val, v + 6, sizeof(float) * 6) == 0);
+
+  cmat_batch_destroy(b1);
+  cmat_batch_destroy(b2);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_batch_t* b;
+
+  CU_ASSERT(cmat_batch_new(NULL, -1, 3, 3, &b) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_batch_new(NULL, 10, 0, 3, &b) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_batch_new(NULL, 10, 3, CMAT_BATCH_MAX_DIM + 1, &b) ==
+                                                            CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_batch_new(NULL, 10, 3, 3, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_batch_destroy(NULL) == CMAT_ERR_BADDR);
+}
+
+static void
+test_error_2(void)
+{
+  cmat_batch_t* b1;
+  cmat_batch_t* b2;
+  cmat_batch_t* b3;
+  float det[10];
+
+  cmat_batch_new(NULL, 10, 2, 3, &b1);
+  cmat_batch_new(NULL, 10, 2, 3, &b2);
+  cmat_batch_new(NULL, 10, 5, 5, &b3);
+
+  CU_ASSERT(cmat_batch_product(b1, b2, NULL) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_batch_det(b1, det) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_batch_det(b3, det) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_batch_inverse(b3, NULL) == CMAT_ERR_BSIZE);
+
+  cmat_batch_destroy(b1);
+  cmat_batch_destroy(b2);
+  cmat_batch_destroy(b3);
+}
+
+static void
+test_error_3(void)
+{
+  cmat_batch_t* b;
+  cmat_batch_t* d;
+  float v[] = {
+    1, 2,
+    3, 4,
+
+    1, 2,
+    2, 4,
+  };
+
+  cmat_batch_new(v, 2, 2, 2, &b);
+
+  d = NULL;
+  CU_ASSERT(cmat_batch_inverse(b, &d) == CMAT_ERR_NREGL);
+  CU_ASSERT(d == NULL);
+
+  cmat_batch_destroy(b);
+}
+
+void
+init_test_batch()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("batch", NULL, NULL);
+  CU_add_test(suite, "batch#1", test_normal_1);
+  CU_add_test(suite, "batch#2", test_normal_2);
+  CU_add_test(suite, "batch#3", test_normal_3);
+  CU_add_test(suite, "batch#E1", test_error_1);
+  CU_add_test(suite, "batch#E2", test_error_2);
+  CU_add_test(suite, "batch#E3", test_error_3);
+}
@@ -60,6 +60,187 @@ test_normal_2(void)
   cmat_destroy(m2);
 }
 
+static void
+test_normal_3(void)
+{
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+  float* tbl;
+  int res;
+  float v[] = {
+    1, 2, 3,
+    4, 5, 6,
+  };
+
+  float ans[] = {
+    2, 4, 6,
+    8, 10, 12,
+  };
+
+  /*
+   * 複製は値をコピーせずに領域を共有し、書き込み時に複製する
+   */
+  cmat_new(v, 2, 3, &m1);
+  cmat_clone(m1, &m2);
+  cmat_clone(m2, &m3);
+
+  CU_ASSERT(m2->tbl == m1->tbl);
+  CU_ASSERT(m3->tbl == m1->tbl);
+
+  CU_ASSERT(cmat_mul(m2, 2.0f, NULL) == 0);
+  CU_ASSERT(m2->tbl != m1->tbl);
+
+  cmat_check(m1, v, &res);
+  CU_ASSERT(res == 0);
+  cmat_check(m2, ans, &res);
+  CU_ASSERT(res == 0);
+  cmat_check(m3, v, &res);
+  CU_ASSERT(res == 0);
+
+  /* 元の行列への書き込み(複製より先に削除) */
+  CU_ASSERT(cmat_add(m1, m1, NULL) == 0);
+  CU_ASSERT(m1->tbl != m3->tbl);
+
+  cmat_check(m1, ans, &res);
+  CU_ASSERT(res == 0);
+  cmat_check(m3, v, &res);
+  CU_ASSERT(res == 0);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+
+  cmat_check(m3, v, &res);
+  CU_ASSERT(res == 0);
+
+  /* 他の参照が無くなった後の書き込みは複製を伴わない */
+  tbl = m3->tbl;
+  CU_ASSERT(cmat_mul(m3, 2.0f, NULL) == 0);
+  CU_ASSERT(m3->tbl == tbl);
+
+  cmat_check(m3, ans, &res);
+  CU_ASSERT(res == 0);
+
+  cmat_destroy(m3);
+}
+
+static void
+test_normal_4(void)
+{
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+  cmat_t* v;
+  int piv[] = {1, 0};
+  int res;
+  float v1[] = {
+    1, 2,
+    3, 4,
+  };
+
+  float v2[] = {
+    3, 4,
+    1, 2,
+  };
+
+  float v3[] = {
+    1, 2,
+    3, 4,
+    5, 6,
+  };
+
+  /*
+   * 行の入れ替えと行の追加
+   */
+  cmat_new(v1, 2, 2, &m1);
+  cmat_clone(m1, &m2);
+  cmat_clone(m1, &m3);
+
+  CU_ASSERT(cmat_permute_row(m2, piv) == 0);
+  cmat_check(m2, v2, &res);
+  CU_ASSERT(res == 0);
+
+  CU_ASSERT(cmat_append(m3, v3 + 4) == 0);
+  cmat_check(m3, v3, &res);
+  CU_ASSERT(res == 0);
+
+  cmat_check(m1, v1, &res);
+  CU_ASSERT(res == 0);
+
+  cmat_destroy(m2);
+  cmat_destroy(m3);
+
+  /*
+   * ビュー経由の書き込みは複製に影響しない
+   */
+  cmat_clone(m1, &m2);
+
+  CU_ASSERT(cmat_view(m1, 0, 0, 1, 2, &v) == 0);
+  CU_ASSERT(m1->tbl != m2->tbl);
+  cmat_mul(v, 0.0f, NULL);
+
+  cmat_check(m2, v1, &res);
+  CU_ASSERT(res == 0);
+
+  /* ビューを作成した行列の複製は値をコピーする */
+  cmat_clone(m1, &m3);
+  CU_ASSERT(m3->tbl != m1->tbl);
+
+  cmat_mul(v, 2.0f, NULL);
+  CU_ASSERT(CMAT_ROW(m3, 0)[0] == 0.0f);
+
+  cmat_destroy(v);
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+  cmat_destroy(m3);
+}
+
+static void
+test_normal_5(void)
+{
+  cmat_t* m1;
+  cmat_t* m2;
+  int res;
+  float v[] = {
+    1, 2, 3,
+    4, 5, 6,
+  };
+
+  float ans[] = {
+    1, 4,
+    2, 5,
+    3, 6,
+  };
+
+  /*
+   * 形状の変わる演算と明示的な共有の解除
+   */
+  cmat_new(v, 2, 3, &m1);
+  cmat_clone(m1, &m2);
+
+  CU_ASSERT(cmat_transpose(m1, NULL) == 0);
+  cmat_check(m1, ans, &res);
+  CU_ASSERT(res == 0);
+  cmat_check(m2, v, &res);
+  CU_ASSERT(res == 0);
+
+  /* 元の行列を先に削除しても複製は有効 */
+  cmat_destroy(m1);
+
+  cmat_clone(m2, &m1);
+  CU_ASSERT(cmat_unshare(m1) == 0);
+  CU_ASSERT(m1->tbl != m2->tbl);
+
+  CMAT_ROW(m1, 0)[0] = 0.0f;
+  CU_ASSERT(CMAT_ROW(m2, 0)[0] == 1.0f);
+
+  CU_ASSERT(cmat_unshare(m2) == 0);
+  CU_ASSERT(cmat_unshare(NULL) == CMAT_ERR_BADDR);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+}
+
 static void
 test_error_e1(void)
 {
@@ -96,6 +277,9 @@ init_test_clone()
   suite = CU_add_suite("clone object", NULL, NULL);
   CU_add_test(suite, "clone#1", test_normal_1);
   CU_add_test(suite, "clone#2", test_normal_2);
+  CU_add_test(suite, "clone#3", test_normal_3);
+  CU_add_test(suite, "clone#4", test_normal_4);
+  CU_add_test(suite, "clone#5", test_normal_5);
   CU_add_test(suite, "new#E1", test_error_e1);
   CU_add_test(suite, "new#E2", test_error_e2);
 }
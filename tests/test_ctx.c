@@ -0,0 +1,248 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cmat.h"
+#include "helper.h"
+
+/*
+ * コンテキストを指定した演算と指定しない演算の結果の比較
+ */
+static void
+check_ops(cmat_ctx_t* ctx, int n)
+{
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c1;
+  cmat_t* c2;
+  float d1;
+  float d2;
+
+  a = random_matrix(n, n);
+  b = random_matrix(n, n);
+
+  CU_ASSERT(cmat_add_ctx(ctx, a, b, &c1) == 0);
+  cmat_add(a, b, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  CU_ASSERT(cmat_sub_ctx(ctx, a, b, &c1) == 0);
+  cmat_sub(a, b, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  CU_ASSERT(cmat_mul_ctx(ctx, a, 3.0f, &c1) == 0);
+  cmat_mul(a, 3.0f, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  CU_ASSERT(cmat_product_ctx(ctx, a, b, &c1) == 0);
+  cmat_product(a, b, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+
+  CU_ASSERT(cmat_gemm_ctx(ctx, CMAT_NOTRANS, CMAT_NOTRANS,
+                          1.0f, a, b, 0.0f, c1) == 0);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  CU_ASSERT(cmat_transpose_ctx(ctx, a, &c1) == 0);
+  cmat_transpose(a, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  CU_ASSERT(cmat_dot_ctx(ctx, a, b, &d1) == 0);
+  cmat_dot(a, b, &d2);
+  CU_ASSERT(d1 == d2);
+
+  cmat_destroy(a);
+  cmat_destroy(b);
+}
+
+static void
+test_normal_1(void)
+{
+  cmat_ctx_t* ctx;
+
+  /*
+   * 既定値
+   */
+  CU_ASSERT(cmat_ctx_new(&ctx) == 0);
+  check_ops(ctx, 5);
+  check_ops(ctx, 150);
+
+  /*
+   * 常に逐次実行
+   */
+  CU_ASSERT(cmat_ctx_set_threads(ctx, 1) == 0);
+  check_ops(ctx, 5);
+  check_ops(ctx, 150);
+
+  /*
+   * 小さな行列でも並列化する
+   */
+  CU_ASSERT(cmat_ctx_set_threads(ctx, 4) == 0);
+  CU_ASSERT(cmat_ctx_set_parallel_min(ctx, 0) == 0);
+  check_ops(ctx, 5);
+  check_ops(ctx, 150);
+
+  /* 既定の閾値に戻す */
+  CU_ASSERT(cmat_ctx_set_parallel_min(ctx, -1) == 0);
+  check_ops(ctx, 5);
+
+  CU_ASSERT(cmat_ctx_destroy(ctx) == 0);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_ctx_t* ctx;
+  cmat_t* a;
+  cmat_t* inv1;
+  cmat_t* inv2;
+  cmat_t* lu;
+  float d1;
+  float d2;
+  int piv[80];
+
+  float val[] = {
+    2, 1, 1,
+    1, 3, 2,
+    1, 0, 0,
+  };
+
+  float ans[] = {
+     0,  0,  1,
+    -2,  1,  3,
+     3, -1, -5,
+  };
+
+  int res;
+
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_threads(ctx, 2);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  /*
+   * 逆行列・LU分解・行列式
+   */
+  cmat_new(val, 3, 3, &a);
+
+  CU_ASSERT(cmat_inverse_ctx(ctx, a, &inv1) == 0);
+  CU_ASSERT(cmat_check(inv1, ans, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  CU_ASSERT(cmat_det_ctx(ctx, a, &d1) == 0);
+  CU_ASSERT(d1 == -1.0f);
+
+  cmat_destroy(inv1);
+  cmat_destroy(a);
+
+  a = random_matrix(80, 80);
+
+  CU_ASSERT(cmat_inverse_ctx(ctx, a, &inv1) == 0);
+  cmat_inverse(a, &inv2);
+  CU_ASSERT(is_equal(inv1, inv2));
+  cmat_destroy(inv2);
+
+  cmat_new(NULL, 80, 80, &inv2);
+  CU_ASSERT(cmat_inverse_into_ctx(ctx, a, inv2) == 0);
+  CU_ASSERT(is_equal(inv1, inv2));
+  cmat_destroy(inv2);
+  cmat_destroy(inv1);
+
+  CU_ASSERT(cmat_lu_decomp_ctx(ctx, a, &lu, piv) == 0);
+  cmat_det_ctx(ctx, a, &d1);
+  cmat_det(a, &d2);
+  CU_ASSERT(d1 == d2);
+  cmat_destroy(lu);
+
+  cmat_destroy(a);
+  cmat_ctx_destroy(ctx);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_ctx_t* ctx;
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c1;
+  cmat_t* c2;
+
+  /*
+   * 出力先を指定する演算
+   */
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  a = random_matrix(40, 30);
+  b = random_matrix(30, 40);
+
+  cmat_new(NULL, 40, 40, &c1);
+  CU_ASSERT(cmat_product_into_ctx(ctx, a, b, c1) == 0);
+  cmat_product(a, b, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+
+  CU_ASSERT(cmat_add_into_ctx(ctx, c1, c2, c1) == 0);
+  CU_ASSERT(cmat_sub_into_ctx(ctx, c1, c2, c1) == 0);
+  CU_ASSERT(is_equal(c1, c2));
+
+  CU_ASSERT(cmat_mul_into_ctx(ctx, c2, 2.0f, c1) == 0);
+  CU_ASSERT(cmat_add(c2, c2, NULL) == 0);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  cmat_new(NULL, 30, 40, &c1);
+  CU_ASSERT(cmat_transpose_into_ctx(ctx, a, c1) == 0);
+  cmat_transpose(a, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  cmat_destroy(a);
+  cmat_destroy(b);
+  cmat_ctx_destroy(ctx);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_ctx_t* ctx;
+  cmat_t* m;
+  cmat_t* d;
+
+  CU_ASSERT(cmat_ctx_new(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_ctx_destroy(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_ctx_set_threads(NULL, 1) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_ctx_set_parallel_min(NULL, 1) == CMAT_ERR_BADDR);
+
+  cmat_ctx_new(&ctx);
+  cmat_new(NULL, 2, 2, &m);
+
+  CU_ASSERT(cmat_ctx_set_threads(ctx, -1) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_add_ctx(NULL, m, m, &d) == CMAT_ERR_BADDR);
+
+  /* 演算自体のエラーはそのまま返る */
+  CU_ASSERT(cmat_add_ctx(ctx, NULL, m, &d) == CMAT_ERR_BADDR);
+
+  cmat_destroy(m);
+  cmat_ctx_destroy(ctx);
+}
+
+void
+init_test_ctx()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("execution context", NULL, NULL);
+  CU_add_test(suite, "ctx#1", test_normal_1);
+  CU_add_test(suite, "ctx#2", test_normal_2);
+  CU_add_test(suite, "ctx#3", test_normal_3);
+  CU_add_test(suite, "ctx#E1", test_error_1);
+}
@@ -0,0 +1,240 @@
+﻿#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cmat.h"
+#include "helper.h"
+
+#define N(x)        (sizeof(x) / sizeof(*x))
+
+/*
+ * 比較用の素朴な積和 (c = alpha * op(a) * op(b) + beta * c)
+ */
+static void
+gemm_ref(int ta, int tb, float alpha, cmat_t* a, cmat_t* b,
+         float beta, float* c, int m, int n, int k)
+{
+  double sum;
+  float av;
+  float bv;
+  int i;
+  int j;
+  int p;
+
+  for (i = 0; i < m; i++) {
+    for (j = 0; j < n; j++) {
+      sum = 0.0;
+
+      for (p = 0; p < k; p++) {
+        av   = (ta)? CMAT_ROW(a, p)[i]: CMAT_ROW(a, i)[p];
+        bv   = (tb)? CMAT_ROW(b, j)[p]: CMAT_ROW(b, p)[j];
+        sum += (double)av * bv;
+      }
+
+      c[(i * n) + j] = (float)((alpha * sum) + (beta * c[(i * n) + j]));
+    }
+  }
+}
+
+static float
+max_error(cmat_t* c, float* ans)
+{
+  float ret;
+  float d;
+  int i;
+  int j;
+
+  ret = 0.0f;
+
+  for (i = 0; i < c->rows; i++) {
+    for (j = 0; j < c->cols; j++) {
+      d = fabsf(CMAT_ROW(c, i)[j] - ans[(i * c->cols) + j]) /
+                                fmaxf(1.0f, fabsf(ans[(i * c->cols) + j]));
+      if (d > ret) ret = d;
+    }
+  }
+
+  return ret;
+}
+
+static void
+test_normal_1(void)
+{
+  static const int size[][3] = {
+    {1, 1, 1}, {3, 4, 5}, {7, 2, 9}, {17, 33, 9}, {100, 100, 100},
+    {150, 70, 260},
+  };
+
+  static const float coef[][2] = {
+    {1.0f, 0.0f}, {1.0f, 1.0f}, {-2.0f, 0.5f}, {0.0f, 3.0f},
+  };
+
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c;
+  float* va;
+  float* vb;
+  float* vc;
+  int m;
+  int n;
+  int k;
+  int ta;
+  int tb;
+  int err;
+  int i;
+  int j;
+
+  srand(7);
+
+  for (i = 0; i < N(size); i++) {
+    m = size[i][0];
+    n = size[i][1];
+    k = size[i][2];
+
+    for (j = 0; j < N(coef) * 4; j++) {
+      ta = (j & 1)? CMAT_TRANS: CMAT_NOTRANS;
+      tb = (j & 2)? CMAT_TRANS: CMAT_NOTRANS;
+
+      va = random_values(m * k);
+      vb = random_values(k * n);
+      vc = random_values(m * n);
+
+      if (ta) cmat_new(va, k, m, &a); else cmat_new(va, m, k, &a);
+      if (tb) cmat_new(vb, n, k, &b); else cmat_new(vb, k, n, &b);
+      cmat_new(vc, m, n, &c);
+
+      err = cmat_gemm(ta, tb, coef[j / 4][0], a, b, coef[j / 4][1], c);
+      gemm_ref(ta, tb, coef[j / 4][0], a, b, coef[j / 4][1], vc, m, n, k);
+
+      CU_ASSERT(err == 0);
+      CU_ASSERT(max_error(c, vc) < 1e-5);
+
+      cmat_destroy(a);
+      cmat_destroy(b);
+      cmat_destroy(c);
+
+      free(va);
+      free(vb);
+      free(vc);
+    }
+  }
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_t* a;
+  cmat_t* b;
+  float* va;
+  float* vb;
+  float* ans;
+  int err;
+
+  /*
+   * 出力先とオペランドが同じオブジェクトの場合
+   */
+  srand(11);
+
+  va  = random_values(40 * 40);
+  vb  = random_values(40 * 40);
+  ans = (float*)malloc(sizeof(float) * 40 * 40);
+
+  cmat_new(va, 40, 40, &a);
+  cmat_new(vb, 40, 40, &b);
+
+  memcpy(ans, va, sizeof(float) * 40 * 40);
+  gemm_ref(CMAT_TRANS, CMAT_NOTRANS, 1.0f, a, b, 2.0f, ans, 40, 40, 40);
+
+  err = cmat_gemm(CMAT_TRANS, CMAT_NOTRANS, 1.0f, a, b, 2.0f, a);
+
+  CU_ASSERT(err == 0);
+  CU_ASSERT(max_error(a, ans) < 1e-5);
+
+  cmat_destroy(a);
+  cmat_destroy(b);
+
+  free(va);
+  free(vb);
+  free(ans);
+}
+
+static void
+test_error_1(void)
+{
+  int err;
+  cmat_t* m;
+
+  cmat_new(NULL, 2, 2, &m);
+
+  err = cmat_gemm(CMAT_NOTRANS, CMAT_NOTRANS, 1.0f, NULL, m, 0.0f, m);
+  CU_ASSERT(err == CMAT_ERR_BADDR);
+
+  err = cmat_gemm(CMAT_NOTRANS, CMAT_NOTRANS, 1.0f, m, NULL, 0.0f, m);
+  CU_ASSERT(err == CMAT_ERR_BADDR);
+
+  err = cmat_gemm(CMAT_NOTRANS, CMAT_NOTRANS, 1.0f, m, m, 0.0f, NULL);
+  CU_ASSERT(err == CMAT_ERR_BADDR);
+
+  cmat_destroy(m);
+}
+
+static void
+test_error_2(void)
+{
+  int err;
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+
+  cmat_new(NULL, 2, 3, &m1);
+  cmat_new(NULL, 2, 3, &m2);
+  cmat_new(NULL, 2, 2, &m3);
+
+  err = cmat_gemm(CMAT_NOTRANS, CMAT_NOTRANS, 1.0f, m1, m2, 0.0f, m3);
+  CU_ASSERT(err == CMAT_ERR_SHAPE);
+
+  err = cmat_gemm(CMAT_TRANS, CMAT_NOTRANS, 1.0f, m1, m2, 0.0f, m3);
+  CU_ASSERT(err == CMAT_ERR_SHAPE);
+
+  err = cmat_gemm(CMAT_NOTRANS, CMAT_TRANS, 1.0f, m1, m2, 0.0f, m3);
+  CU_ASSERT(err == 0);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+  cmat_destroy(m3);
+}
+
+static void
+test_error_3(void)
+{
+  int err;
+  cmat_t* m;
+
+  cmat_new(NULL, 2, 2, &m);
+
+  err = cmat_gemm(2, CMAT_NOTRANS, 1.0f, m, m, 0.0f, m);
+  CU_ASSERT(err == CMAT_ERR_INVAL);
+
+  err = cmat_gemm(CMAT_NOTRANS, -1, 1.0f, m, m, 0.0f, m);
+  CU_ASSERT(err == CMAT_ERR_INVAL);
+
+  err = cmat_gemm(CMAT_NOTRANS, CMAT_NOTRANS, NAN, m, m, 0.0f, m);
+  CU_ASSERT(err == CMAT_ERR_INVAL);
+
+  cmat_destroy(m);
+}
+
+void
+init_test_gemm()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("gemm", NULL, NULL);
+  CU_add_test(suite, "gemm#1", test_normal_1);
+  CU_add_test(suite, "gemm#2", test_normal_2);
+  CU_add_test(suite, "gemm#E1", test_error_1);
+  CU_add_test(suite, "gemm#E2", test_error_2);
+  CU_add_test(suite, "gemm#E3", test_error_3);
+}
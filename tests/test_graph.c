@@ -0,0 +1,288 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cmat.h"
+#include "helper.h"
+
+/*
+ * ((a * b) + c)^T の逆行列と (a * b) + c を直接求める
+ */
+static void
+calc_direct(cmat_t* a, cmat_t* b, cmat_t* c, cmat_t** s, cmat_t** inv)
+{
+  cmat_t* t;
+
+  cmat_product(a, b, s);
+  cmat_add(*s, c, NULL);
+  cmat_transpose(*s, &t);
+  cmat_inverse(t, inv);
+  cmat_destroy(t);
+}
+
+static void
+test_normal_1(void)
+{
+  cmat_graph_t* g;
+  cmat_t* a[2];
+  cmat_t* b;
+  cmat_t* c;
+  cmat_t* s1;
+  cmat_t* s2;
+  cmat_t* inv1;
+  cmat_t* inv2;
+  int ia;
+  int ib;
+  int ic;
+  int ip;
+  int is;
+  int it;
+  int ii;
+  int i;
+
+  /*
+   * 記録
+   */
+  CU_ASSERT(cmat_graph_new(&g) == 0);
+  CU_ASSERT(cmat_graph_input(g, 40, 30, &ia) == 0);
+  CU_ASSERT(cmat_graph_input(g, 30, 40, &ib) == 0);
+  CU_ASSERT(cmat_graph_input(g, 40, 40, &ic) == 0);
+  CU_ASSERT(cmat_graph_product(g, ia, ib, &ip) == 0);
+  CU_ASSERT(cmat_graph_add(g, ip, ic, &is) == 0);
+  CU_ASSERT(cmat_graph_transpose(g, is, &it) == 0);
+  CU_ASSERT(cmat_graph_inverse(g, it, &ii) == 0);
+
+  a[0] = random_matrix(40, 30);
+  a[1] = random_matrix(40, 30);
+  b    = random_matrix(30, 40);
+  c    = random_matrix(40, 40);
+
+  cmat_new(NULL, 40, 40, &s1);
+  cmat_new(NULL, 40, 40, &inv1);
+
+  CU_ASSERT(cmat_graph_bind(g, ib, b) == 0);
+  CU_ASSERT(cmat_graph_bind(g, ic, c) == 0);
+  CU_ASSERT(cmat_graph_bind(g, is, s1) == 0);
+  CU_ASSERT(cmat_graph_bind(g, ii, inv1) == 0);
+
+  /*
+   * 入力を入れ替えながら繰り返し実行
+   */
+  for (i = 0; i < 4; i++) {
+    CU_ASSERT(cmat_graph_bind(g, ia, a[i % 2]) == 0);
+    CU_ASSERT(cmat_graph_execute(NULL, g) == 0);
+
+    calc_direct(a[i % 2], b, c, &s2, &inv2);
+    CU_ASSERT(is_equal(s1, s2));
+    CU_ASSERT(is_equal(inv1, inv2));
+    cmat_destroy(s2);
+    cmat_destroy(inv2);
+  }
+
+  /*
+   * 出力の束縛を外すと再計画される(中間結果はグラフのバッファに置く)
+   */
+  CU_ASSERT(cmat_graph_bind(g, is, NULL) == 0);
+  cmat_graph_bind(g, ia, a[0]);
+  CU_ASSERT(cmat_graph_execute(NULL, g) == 0);
+
+  calc_direct(a[0], b, c, &s2, &inv2);
+  CU_ASSERT(is_equal(inv1, inv2));
+  cmat_destroy(s2);
+  cmat_destroy(inv2);
+
+  CU_ASSERT(cmat_graph_destroy(g) == 0);
+
+  cmat_destroy(a[0]);
+  cmat_destroy(a[1]);
+  cmat_destroy(b);
+  cmat_destroy(c);
+  cmat_destroy(s1);
+  cmat_destroy(inv1);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  cmat_graph_t* g;
+  cmat_t* x;
+  cmat_t* m[4];
+  cmat_t* out;
+  cmat_t* ans;
+  cmat_t* t;
+  int in[4];
+  int id[4];
+  int sum;
+  int k;
+  int i;
+
+  cmat_sched_new(3, &sched);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  /*
+   * 独立した4本の鎖 (m[i] * 2 - m[i]) * m[i] を足し合わせる
+   *  同じ形状の中間結果が多数あるのでバッファが使い回される
+   */
+  cmat_graph_new(&g);
+
+  for (i = 0; i < 4; i++) {
+    m[i] = random_matrix(24, 24);
+
+    cmat_graph_input(g, 24, 24, in + i);
+    cmat_graph_bind(g, in[i], m[i]);
+
+    CU_ASSERT(cmat_graph_mul(g, in[i], 2.0f, &k) == 0);
+    CU_ASSERT(cmat_graph_sub(g, k, in[i], &k) == 0);
+    CU_ASSERT(cmat_graph_product(g, k, in[i], id + i) == 0);
+  }
+
+  cmat_graph_add(g, id[0], id[1], &sum);
+  cmat_graph_add(g, sum, id[2], &sum);
+  cmat_graph_add(g, sum, id[3], &sum);
+
+  cmat_new(NULL, 24, 24, &out);
+  cmat_graph_bind(g, sum, out);
+
+  for (k = 0; k < 3; k++) {
+    CU_ASSERT(cmat_graph_execute(ctx, g) == 0);
+  }
+
+  ans = NULL;
+  for (i = 0; i < 4; i++) {
+    cmat_mul(m[i], 2.0f, &x);
+    cmat_sub(x, m[i], NULL);
+    cmat_product(x, m[i], &t);
+    cmat_destroy(x);
+
+    if (ans) {
+      cmat_add(ans, t, NULL);
+      cmat_destroy(t);
+    } else {
+      ans = t;
+    }
+  }
+
+  CU_ASSERT(is_equal(out, ans));
+
+  for (i = 0; i < 4; i++) cmat_destroy(m[i]);
+  cmat_destroy(out);
+  cmat_destroy(ans);
+  cmat_graph_destroy(g);
+  cmat_ctx_destroy(ctx);
+  cmat_sched_destroy(sched);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_graph_t* g;
+  cmat_t* m;
+  cmat_t* out;
+  int in;
+  int id;
+  int tr;
+
+  float val[] = {
+    1, 2,
+    2, 4,
+  };
+
+  float ans[] = {
+    1, 2,
+    2, 4,
+  };
+
+  int res;
+
+  /*
+   * 結果を取り出さない(束縛されていない)ノードは実行しない
+   */
+  cmat_new(val, 2, 2, &m);
+  cmat_new(NULL, 2, 2, &out);
+
+  cmat_graph_new(&g);
+  cmat_graph_input(g, 2, 2, &in);
+  cmat_graph_inverse(g, in, &id);
+  cmat_graph_transpose(g, in, &tr);
+  cmat_graph_bind(g, in, m);
+  cmat_graph_bind(g, tr, out);
+
+  CU_ASSERT(cmat_graph_execute(NULL, g) == 0);
+  CU_ASSERT(cmat_check(out, ans, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  /*
+   * 演算のエラーは実行の戻り値になる
+   */
+  cmat_graph_bind(g, tr, NULL);
+  cmat_graph_bind(g, id, out);
+  CU_ASSERT(cmat_graph_execute(NULL, g) == CMAT_ERR_NREGL);
+
+  cmat_graph_destroy(g);
+  cmat_destroy(m);
+  cmat_destroy(out);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_graph_t* g;
+  cmat_t* m;
+  int a;
+  int b;
+  int c;
+
+  CU_ASSERT(cmat_graph_new(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_graph_destroy(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_graph_execute(NULL, NULL) == CMAT_ERR_BADDR);
+
+  cmat_graph_new(&g);
+
+  CU_ASSERT(cmat_graph_input(NULL, 2, 2, &a) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_graph_input(g, 2, 2, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_graph_input(g, 0, 2, &a) == CMAT_ERR_BSIZE);
+
+  cmat_graph_input(g, 2, 3, &a);
+  cmat_graph_input(g, 3, 3, &b);
+
+  /* 形状の不一致 */
+  CU_ASSERT(cmat_graph_add(g, a, b, &c) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_graph_product(g, b, a, &c) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_graph_inverse(g, a, &c) == CMAT_ERR_SHAPE);
+
+  /* 存在しないノード */
+  CU_ASSERT(cmat_graph_add(g, a, 5, &c) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_graph_mul(g, -1, 1.0f, &c) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_graph_transpose(NULL, a, &c) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_graph_product(g, a, b, NULL) == CMAT_ERR_BADDR);
+
+  /* 束縛 */
+  cmat_new(NULL, 3, 3, &m);
+  CU_ASSERT(cmat_graph_bind(NULL, a, m) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_graph_bind(g, 7, m) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_graph_bind(g, a, m) == CMAT_ERR_SHAPE);
+
+  /* 入力が束縛されていない */
+  CU_ASSERT(cmat_graph_inverse(g, b, &c) == 0);
+  CU_ASSERT(cmat_graph_bind(g, c, m) == 0);
+  CU_ASSERT(cmat_graph_execute(NULL, g) == CMAT_ERR_INVAL);
+
+  cmat_destroy(m);
+  cmat_graph_destroy(g);
+}
+
+void
+init_test_graph()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("operation graph", NULL, NULL);
+  CU_add_test(suite, "graph#1", test_normal_1);
+  CU_add_test(suite, "graph#2", test_normal_2);
+  CU_add_test(suite, "graph#3", test_normal_3);
+  CU_add_test(suite, "graph#E1", test_error_1);
+}
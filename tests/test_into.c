@@ -0,0 +1,198 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cmat.h"
+#include "helper.h"
+
+static void
+test_normal_1(void)
+{
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c;
+  cmat_t* d;
+  cmat_t* ans;
+  float* v1;
+  float* v2;
+  int i;
+
+  /*
+   * 要素ごとの演算(出力先の再利用と自身への書き込み)
+   */
+  srand(13);
+
+  v1 = random_values(37 * 29);
+  v2 = random_values(37 * 29);
+
+  cmat_new(v1, 37, 29, &a);
+  cmat_new(v2, 37, 29, &b);
+  cmat_new(NULL, 37, 29, &c);
+  cmat_new(v1, 37, 29, &d);
+
+  for (i = 0; i < 3; i++) {
+    CU_ASSERT(cmat_add_into(a, b, c) == 0);
+    cmat_add(a, b, &ans);
+    CU_ASSERT(is_equal(c, ans));
+    cmat_destroy(ans);
+
+    CU_ASSERT(cmat_sub_into(a, b, c) == 0);
+    cmat_sub(a, b, &ans);
+    CU_ASSERT(is_equal(c, ans));
+    cmat_destroy(ans);
+
+    CU_ASSERT(cmat_mul_into(a, 1.5f, c) == 0);
+    cmat_mul(a, 1.5f, &ans);
+    CU_ASSERT(is_equal(c, ans));
+    cmat_destroy(ans);
+  }
+
+  CU_ASSERT(cmat_add_into(d, b, d) == 0);
+  cmat_add(a, b, &ans);
+  CU_ASSERT(is_equal(d, ans));
+  cmat_destroy(ans);
+
+  cmat_destroy(a);
+  cmat_destroy(b);
+  cmat_destroy(c);
+  cmat_destroy(d);
+
+  free(v1);
+  free(v2);
+}
+
+static void
+test_normal_2(void)
+{
+  static const int size[][3] = {
+    {3, 3, 3}, {4, 4, 4}, {5, 7, 3}, {64, 48, 80},
+  };
+
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c;
+  cmat_t* t;
+  cmat_t* ans;
+  float* v1;
+  float* v2;
+  int i;
+
+  /*
+   * 積と転置
+   */
+  srand(17);
+
+  for (i = 0; i < (int)(sizeof(size) / sizeof(*size)); i++) {
+    v1 = random_values(size[i][0] * size[i][1]);
+    v2 = random_values(size[i][1] * size[i][2]);
+
+    cmat_new(v1, size[i][0], size[i][1], &a);
+    cmat_new(v2, size[i][1], size[i][2], &b);
+    cmat_new(NULL, size[i][0], size[i][2], &c);
+    cmat_new(NULL, size[i][1], size[i][0], &t);
+
+    CU_ASSERT(cmat_product_into(a, b, c) == 0);
+    cmat_product(a, b, &ans);
+    CU_ASSERT(is_equal(c, ans));
+    cmat_destroy(ans);
+
+    CU_ASSERT(cmat_transpose_into(a, t) == 0);
+    cmat_transpose(a, &ans);
+    CU_ASSERT(is_equal(t, ans));
+    cmat_destroy(ans);
+
+    cmat_destroy(a);
+    cmat_destroy(b);
+    cmat_destroy(c);
+    cmat_destroy(t);
+
+    free(v1);
+    free(v2);
+  }
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_t* a;
+  cmat_t* c;
+  cmat_t* ans;
+  float* v;
+  int sz;
+  int i;
+
+  /*
+   * 逆行列
+   */
+  srand(19);
+
+  for (sz = 2; sz <= 12; sz += 5) {
+    v = random_values(sz * sz);
+    for (i = 0; i < sz; i++) v[(i * sz) + i] += 40.0f;
+
+    cmat_new(v, sz, sz, &a);
+    cmat_new(NULL, sz, sz, &c);
+
+    CU_ASSERT(cmat_inverse_into(a, c) == 0);
+    cmat_inverse(a, &ans);
+    CU_ASSERT(is_equal(c, ans));
+
+    CU_ASSERT(cmat_inverse_into(a, a) == 0);
+    CU_ASSERT(is_equal(a, ans));
+    cmat_destroy(ans);
+
+    cmat_destroy(a);
+    cmat_destroy(c);
+
+    free(v);
+  }
+}
+
+static void
+test_error_1(void)
+{
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+
+  cmat_new(NULL, 2, 3, &m1);
+  cmat_new(NULL, 3, 2, &m2);
+  cmat_new(NULL, 2, 2, &m3);
+
+  CU_ASSERT(cmat_add_into(m1, m1, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_add_into(m1, m1, m2) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_sub_into(m1, m2, m1) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_mul_into(m1, 1.0f, m3) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_mul_into(m1, NAN, m1) == CMAT_ERR_INVAL);
+
+  CU_ASSERT(cmat_product_into(m1, m2, m1) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_product_into(m1, m2, m2) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_product_into(m1, m1, m3) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_product_into(m2, m1, m3) == CMAT_ERR_SHAPE);
+
+  CU_ASSERT(cmat_transpose_into(m3, m3) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_transpose_into(m1, m1) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_transpose_into(m1, m3) == CMAT_ERR_SHAPE);
+
+  CU_ASSERT(cmat_inverse_into(m1, m3) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_inverse_into(m3, m1) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_inverse_into(NULL, m3) == CMAT_ERR_BADDR);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+  cmat_destroy(m3);
+}
+
+void
+init_test_into()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("into", NULL, NULL);
+  CU_add_test(suite, "into#1", test_normal_1);
+  CU_add_test(suite, "into#2", test_normal_2);
+  CU_add_test(suite, "into#3", test_normal_3);
+  CU_add_test(suite, "into#E1", test_error_1);
+}
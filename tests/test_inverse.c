@@ -165,6 +165,42 @@ test_error_2(void)
   CU_ASSERT(err == CMAT_ERR_SHAPE);
 }
 
+static void
+test_error_3(void)
+{
+  int err;
+  float v1[] = {
+    1, 2, 3,
+    2, 4, 6,
+    7, 8, 9
+  };
+
+  float v2[] = {
+    1, 2, 3, 4,
+    5, 6, 7, 8,
+    2, 4, 6, 8,
+    0, 1, 0, 1
+  };
+
+  cmat_t* m;
+  cmat_t* d;
+
+  d = NULL;
+
+  cmat_new(v1, 3, 3, &m);
+  err = cmat_inverse(m, &d);
+  cmat_destroy(m);
+
+  CU_ASSERT(err == CMAT_ERR_NREGL);
+  CU_ASSERT(d == NULL);
+
+  cmat_new(v2, 4, 4, &m);
+  err = cmat_inverse(m, NULL);
+  cmat_destroy(m);
+
+  CU_ASSERT(err == CMAT_ERR_NREGL);
+}
+
 void
 init_test_inverse()
 {
@@ -175,4 +211,5 @@ init_test_inverse()
   CU_add_test(suite, "inverse#2", test_normal_2);
   CU_add_test(suite, "inverse#E1", test_error_1);
   CU_add_test(suite, "inverse#E2", test_error_2);
+  CU_add_test(suite, "inverse#E3", test_error_3);
 }
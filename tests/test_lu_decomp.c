@@ -2,6 +2,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "cmat.h"
 #include "test_lu_decomp.h"
 
@@ -200,6 +202,115 @@ test_normal_3(void)
   }
 }
 
+/*
+ * 比較用の非ブロック版LU分解 (cmat_lu_decomp()と同じピボット選択を行う)
+ */
+static void
+lu_decomp_ref(float* a, int n, float thr, int* piv)
+{
+  float* tmp;
+  float max;
+  float t;
+  int i;
+  int j;
+  int k;
+
+  tmp = (float*)malloc(sizeof(float) * n);
+
+  for (i = 0; i < n; i++) piv[i] = i;
+
+  for (i = 0; i < n; i++) {
+    max = fabsf(a[(i * n) + i]);
+    k   = i;
+
+    for (j = i + 1; j < n; j++) {
+      if (fabsf(a[(j * n) + i]) - max > thr) {
+        max = fabsf(a[(j * n) + i]);
+        k   = j;
+      }
+    }
+
+    if (k != i) {
+      memcpy(tmp, a + (i * n), sizeof(float) * n);
+      memcpy(a + (i * n), a + (k * n), sizeof(float) * n);
+      memcpy(a + (k * n), tmp, sizeof(float) * n);
+      SWAP(piv[i], piv[k], int);
+    }
+
+    if (a[(i * n) + i] == 0.0) continue;
+
+    for (j = i + 1; j < n; j++) {
+      t = (a[(j * n) + i] /= a[(i * n) + i]);
+
+      for (k = i + 1; k < n; k++) {
+        a[(j * n) + k] -= t * a[(i * n) + k];
+      }
+    }
+  }
+
+  free(tmp);
+}
+
+/*
+ * ブロック化LU分解の検算(大きな行列)
+ */
+static void
+test_normal_4(void)
+{
+  static const int size[] = {150, 300, 521};
+
+  cmat_t* m1;
+  cmat_t* m2;
+  float* val;
+  float* ans;
+  int piv1[521];
+  int piv2[521];
+  float err;
+  float d;
+  int n;
+  int i;
+  int j;
+
+  srand(2);
+
+  for (i = 0; i < N(size) * 2; i++) {
+    n   = size[i % N(size)];
+    val = (float*)malloc(sizeof(float) * n * n);
+    ans = (float*)malloc(sizeof(float) * n * n);
+
+    for (j = 0; j < n * n; j++) {
+      val[j] = ((float)rand() / RAND_MAX) * 2.0f - 1.0f;
+    }
+
+    /* 後半は先頭列の対角成分が0となるケース(消去を行わない列)を含める */
+    if (i >= N(size)) {
+      for (j = 0; j < n; j++) val[j * n] = (j == 0)? 0.0f: 5e-5f;
+    }
+
+    memcpy(ans, val, sizeof(float) * n * n);
+    lu_decomp_ref(ans, n, 1e-4, piv2);
+
+    cmat_new(val, n, n, &m1);
+
+    CU_ASSERT(cmat_lu_decomp(m1, &m2, piv1) == 0);
+
+    err = 0.0f;
+    for (j = 0; j < n * n; j++) {
+      d = fabsf(CMAT_ROW(m2, j / n)[j % n] - ans[j]) / fmaxf(1.0f, fabsf(ans[j]));
+      if (d > err) err = d;
+    }
+
+    CU_ASSERT(err < 1e-3);
+    CU_ASSERT(memcmp(piv1, piv2, sizeof(int) * n) == 0);
+
+    cmat_destroy(m1);
+    cmat_destroy(m2);
+
+    free(val);
+    free(ans);
+  }
+}
+
 static void
 test_error_1(void)
 {
@@ -247,6 +358,7 @@ init_test_lu_decomp()
   CU_add_test(suite, "LU decomp#1", test_normal_1);
   CU_add_test(suite, "LU decomp#2", test_normal_2);
   CU_add_test(suite, "LU decomp#3", test_normal_3);
+  CU_add_test(suite, "LU decomp#4", test_normal_4);
   CU_add_test(suite, "LU decomp#E1", test_error_1);
   //CU_add_test(suite, "LU decomp#E2", test_error_2);
 }
@@ -1,6 +1,7 @@
 ﻿#include <CUnit/CUnit.h>
 
 #include <stdio.h>
+#include <stdint.h>
 #include "cmat.h"
 #include "test_add.h"
 
@@ -78,6 +79,35 @@ test_normal_3(void)
   cmat_destroy(m);
 }
 
+static void
+test_normal_4(void)
+{
+  int err;
+  cmat_t* m;
+  int i;
+
+  /*
+   * 列数がパディング単位の倍数の場合は余分なパディングは付かず、全ての
+   * 行がベクトル幅の境界に揃う
+   */
+  m   = NULL;
+  err = cmat_new(NULL, 5, 32, &m);
+
+  CU_ASSERT(err == 0);
+  CU_ASSERT(m != NULL);
+
+  if (m != NULL) {
+    CU_ASSERT(m->stride == 32);
+    CU_ASSERT(m->flags & CMAT_FLAG_ALIGNED);
+
+    for (i = 0; i < m->rows; i++) {
+      CU_ASSERT(((uintptr_t)m->row[i] % 64) == 0);
+    }
+  }
+
+  cmat_destroy(m);
+}
+
 
 static void
 test_error_e1(void)
@@ -130,6 +160,7 @@ init_test_new()
   CU_add_test(suite, "new#1", test_normal_1);
   CU_add_test(suite, "new#2", test_normal_2);
   CU_add_test(suite, "new#3", test_normal_3);
+  CU_add_test(suite, "new#4", test_normal_4);
   CU_add_test(suite, "new#E1", test_error_e1);
   CU_add_test(suite, "new#E2", test_error_e2);
   CU_add_test(suite, "new#E3", test_error_e3);
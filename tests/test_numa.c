@@ -0,0 +1,171 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cmat.h"
+#include "helper.h"
+
+/*
+ * 配置方針を指定して生成・演算した結果と指定しない場合の結果の比較
+ *  (値テーブルが配置の対象になる大きさ)
+ */
+static void
+check_policy(cmat_ctx_t* ctx, int policy)
+{
+  float* val;
+  cmat_t* a1;
+  cmat_t* a2;
+  cmat_t* z1;
+  cmat_t* z2;
+  cmat_t* c1;
+  cmat_t* c2;
+
+  CU_ASSERT(cmat_ctx_set_numa(ctx, policy) == 0);
+
+  val = random_values(640 * 512);
+
+  CU_ASSERT(cmat_new_ctx(ctx, val, 640, 512, &a1) == 0);
+  cmat_new(val, 640, 512, &a2);
+  CU_ASSERT(is_equal(a1, a2));
+
+  CU_ASSERT(cmat_new_ctx(ctx, NULL, 640, 512, &z1) == 0);
+  cmat_new(NULL, 640, 512, &z2);
+  CU_ASSERT(is_equal(z1, z2));
+
+  CU_ASSERT(cmat_add_ctx(ctx, a1, z1, &c1) == 0);
+  CU_ASSERT(is_equal(c1, a2));
+  cmat_destroy(c1);
+
+  CU_ASSERT(cmat_transpose_ctx(ctx, a1, &c1) == 0);
+  cmat_transpose(a2, &c2);
+  CU_ASSERT(is_equal(c1, c2));
+  cmat_destroy(c1);
+  cmat_destroy(c2);
+
+  CU_ASSERT(cmat_mul_into_ctx(ctx, a2, 3.0f, z1) == 0);
+  cmat_mul(a2, 3.0f, &c2);
+  CU_ASSERT(is_equal(z1, c2));
+  cmat_destroy(c2);
+
+  cmat_destroy(a1);
+  cmat_destroy(a2);
+  cmat_destroy(z1);
+  cmat_destroy(z2);
+  free(val);
+}
+
+static void
+test_normal_1(void)
+{
+  cmat_ctx_t* ctx;
+
+  /*
+   * OpenMP (またはOpenMP無しの逐次実行)
+   */
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  check_policy(ctx, CMAT_NUMA_FIRST_TOUCH);
+  check_policy(ctx, CMAT_NUMA_INTERLEAVE);
+  check_policy(ctx, CMAT_NUMA_ROW_BLOCKS);
+  check_policy(ctx, CMAT_NUMA_NONE);
+
+  cmat_ctx_destroy(ctx);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  int policy;
+
+  /*
+   * ワーカを固定したスケジューラ
+   */
+  cmat_sched_new(3, &sched);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  for (policy = CMAT_NUMA_NONE; policy <= CMAT_NUMA_ROW_BLOCKS; policy++) {
+    CU_ASSERT(cmat_sched_set_numa(sched, policy) == 0);
+    check_policy(ctx, policy);
+  }
+
+  CU_ASSERT(cmat_sched_set_numa(sched, CMAT_NUMA_NONE) == 0);
+
+  cmat_ctx_destroy(ctx);
+  cmat_sched_destroy(sched);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_ctx_t* ctx;
+  cmat_t* m1;
+  cmat_t* m2;
+
+  float val[] = {
+    1, 2, 3,
+    4, 5, 6,
+  };
+
+  int res;
+
+  /*
+   * 配置の対象にならない小さな行列
+   */
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_numa(ctx, CMAT_NUMA_ROW_BLOCKS);
+
+  CU_ASSERT(cmat_new_ctx(ctx, val, 2, 3, &m1) == 0);
+  CU_ASSERT(cmat_check(m1, val, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  CU_ASSERT(cmat_product_ctx(ctx, m1, m1, &m2) == CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_transpose_ctx(ctx, m1, &m2) == 0);
+  CU_ASSERT(m2->rows == 3 && m2->cols == 2);
+
+  cmat_destroy(m1);
+  cmat_destroy(m2);
+  cmat_ctx_destroy(ctx);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  cmat_t* m;
+
+  cmat_ctx_new(&ctx);
+  cmat_sched_new(1, &sched);
+
+  CU_ASSERT(cmat_ctx_set_numa(NULL, CMAT_NUMA_INTERLEAVE) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_ctx_set_numa(ctx, -1) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_ctx_set_numa(ctx, 4) == CMAT_ERR_INVAL);
+
+  CU_ASSERT(cmat_sched_set_numa(NULL, CMAT_NUMA_NONE) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_sched_set_numa(sched, -1) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_sched_set_numa(sched, 4) == CMAT_ERR_INVAL);
+
+  CU_ASSERT(cmat_new_ctx(NULL, NULL, 2, 2, &m) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_new_ctx(ctx, NULL, 0, 0, &m) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_new_ctx(ctx, NULL, 2, 2, NULL) == CMAT_ERR_BADDR);
+
+  cmat_sched_destroy(sched);
+  cmat_ctx_destroy(ctx);
+}
+
+void
+init_test_numa()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("numa placement", NULL, NULL);
+  CU_add_test(suite, "numa#1", test_normal_1);
+  CU_add_test(suite, "numa#2", test_normal_2);
+  CU_add_test(suite, "numa#3", test_normal_3);
+  CU_add_test(suite, "numa#E1", test_error_1);
+}
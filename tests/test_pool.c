@@ -0,0 +1,131 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmat.h"
+
+static void
+test_normal_1(void)
+{
+  cmat_pool_t* pool;
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+  float* tbl;
+  float v1[] = {
+    1, 2, 3,
+    4, 5, 6,
+  };
+
+  float v2[] = {
+    2, 4, 6,
+    8, 10, 12,
+  };
+
+  /*
+   * プールからの生成と演算結果の確保
+   */
+  CU_ASSERT(cmat_pool_new(&pool) == 0);
+  CU_ASSERT(cmat_pool_alloc(pool, v1, 2, 3, &m1) == 0);
+  CU_ASSERT(m1->pool == pool);
+  CU_ASSERT(m1->rows == 2 && m1->cols == 3);
+
+  CU_ASSERT(cmat_add(m1, m1, &m2) == 0);
+  CU_ASSERT(m2->pool == pool);
+  CU_ASSERT(memcmp(CMAT_ROW(m2, 0), v2, sizeof(float) * 3) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(m2, 1), v2 + 3, sizeof(float) * 3) == 0);
+
+  CU_ASSERT(cmat_destroy(m2) == 0);
+
+  /* 解放した領域は同じ形状の行列で再利用される */
+  cmat_pool_alloc(pool, NULL, 16, 16, &m2);
+  tbl = m2->tbl;
+  cmat_destroy(m2);
+
+  cmat_pool_alloc(pool, NULL, 16, 16, &m2);
+  CU_ASSERT(m2->tbl == tbl);
+  cmat_destroy(m2);
+
+  CU_ASSERT(cmat_clone(m1, &m3) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(m3, 1), v1 + 3, sizeof(float) * 3) == 0);
+
+  /* 出力先を省略した場合 */
+  CU_ASSERT(cmat_transpose(m3, NULL) == 0);
+  CU_ASSERT(m3->rows == 3 && m3->cols == 2);
+  CU_ASSERT(m3->pool == pool);
+
+  cmat_destroy(m1);
+  cmat_destroy(m3);
+
+  CU_ASSERT(cmat_pool_destroy(pool) == 0);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_pool_t* pool;
+  cmat_t* m;
+  float* tbl;
+  float v[] = {1, 2, 3, 4};
+  int i;
+
+  /*
+   * 一括回収と行の追加
+   */
+  cmat_pool_new(&pool);
+
+  cmat_pool_alloc(pool, NULL, 0, 4, &m);
+
+  for (i = 0; i < 100; i++) {
+    CU_ASSERT(cmat_append(m, v) == 0);
+  }
+
+  CU_ASSERT(m->rows == 100);
+  CU_ASSERT(memcmp(CMAT_ROW(m, 0), v, sizeof(v)) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(m, 99), v, sizeof(v)) == 0);
+
+  CU_ASSERT(cmat_pool_reset(pool) == 0);
+
+  /* 回収後は以前の領域が再利用される */
+  cmat_pool_alloc(pool, NULL, 16, 16, &m);
+  tbl = m->tbl;
+
+  cmat_pool_reset(pool);
+  cmat_pool_alloc(pool, NULL, 16, 16, &m);
+  CU_ASSERT(m->tbl == tbl);
+
+  /* 回収していないオブジェクトはプールの削除時に解放される */
+  CU_ASSERT(cmat_pool_destroy(pool) == 0);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_pool_t* pool;
+  cmat_t* m;
+
+  CU_ASSERT(cmat_pool_new(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_pool_reset(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_pool_destroy(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_pool_alloc(NULL, NULL, 2, 2, &m) == CMAT_ERR_BADDR);
+
+  cmat_pool_new(&pool);
+
+  CU_ASSERT(cmat_pool_alloc(pool, NULL, -1, 2, &m) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_pool_alloc(pool, NULL, 2, 0, &m) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_pool_alloc(pool, NULL, 2, 2, NULL) == CMAT_ERR_BADDR);
+
+  cmat_pool_destroy(pool);
+}
+
+void
+init_test_pool()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("pool", NULL, NULL);
+  CU_add_test(suite, "pool#1", test_normal_1);
+  CU_add_test(suite, "pool#2", test_normal_2);
+  CU_add_test(suite, "pool#E1", test_error_1);
+}
@@ -1,6 +1,8 @@
 ﻿#include <CUnit/CUnit.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "cmat.h"
 #include "test_product.h"
 
@@ -104,6 +106,88 @@ test_normal_2(void)
   }
 }
 
+static void
+calc_product(float* a, float* b, int m, int k, int n, float* dst)
+{
+  int i;
+  int j;
+  int c;
+
+  memset(dst, 0, sizeof(float) * m * n);
+
+  for (i = 0; i < m; i++) {
+    for (j = 0; j < k; j++) {
+      for (c = 0; c < n; c++) {
+        dst[(i * n) + c] += a[(i * k) + j] * b[(j * n) + c];
+      }
+    }
+  }
+}
+
+/*
+ * GEMMエンジンのブロック境界をまたぐ大きさでの検算
+ *  (要素は小さな整数なので積和は誤差なく求まる)
+ */
+static void
+test_normal_3(void)
+{
+  static const int shape[][3] = {
+    { 40,  40,  40},
+    {150, 130, 170},
+    { 73, 301,  65},
+    {  7, 500,  97},
+    {300,   5, 260},
+  };
+
+  cmat_t* m1;
+  cmat_t* m2;
+  cmat_t* m3;
+  float* v1;
+  float* v2;
+  float* ans;
+  int m;
+  int n;
+  int k;
+  int i;
+  int j;
+  int res;
+
+  srand(1);
+
+  for (i = 0; i < N(shape); i++) {
+    m   = shape[i][0];
+    k   = shape[i][1];
+    n   = shape[i][2];
+
+    v1  = (float*)malloc(sizeof(float) * m * k);
+    v2  = (float*)malloc(sizeof(float) * k * n);
+    ans = (float*)malloc(sizeof(float) * m * n);
+
+    for (j = 0; j < m * k; j++) v1[j] = (float)((rand() % 17) - 8);
+    for (j = 0; j < k * n; j++) v2[j] = (float)((rand() % 17) - 8);
+
+    calc_product(v1, v2, m, k, n, ans);
+
+    cmat_new(v1, m, k, &m1);
+    cmat_new(v2, k, n, &m2);
+
+    cmat_product(m1, m2, &m3);
+    cmat_check(m3, ans, &res);
+
+    CU_ASSERT(res == 0);
+    CU_ASSERT(m3->rows == m);
+    CU_ASSERT(m3->cols == n);
+
+    cmat_destroy(m1);
+    cmat_destroy(m2);
+    cmat_destroy(m3);
+
+    free(v1);
+    free(v2);
+    free(ans);
+  }
+}
+
 static void
 test_error_1(void)
 {
@@ -163,6 +247,7 @@ init_test_product()
   suite = CU_add_suite("product", NULL, NULL);
   CU_add_test(suite, "product#1", test_normal_1);
   CU_add_test(suite, "product#2", test_normal_2);
+  CU_add_test(suite, "product#3", test_normal_3);
   CU_add_test(suite, "product#E1", test_error_1);
   CU_add_test(suite, "product#E2", test_error_2);
   CU_add_test(suite, "product#E3", test_error_3);
@@ -0,0 +1,282 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "cmat.h"
+#include "helper.h"
+
+/*
+ * スケジューラで並列化される大きさの行列積と通常の行列積の結果の比較
+ */
+static int
+check_product(cmat_ctx_t* ctx, int n)
+{
+  int ret;
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c1;
+  cmat_t* c2;
+
+  a = random_matrix(n, n);
+  b = random_matrix(n, n);
+
+  ret = (cmat_product_ctx(ctx, a, b, &c1) == 0);
+  cmat_product(a, b, &c2);
+
+  if (ret) {
+    ret = is_equal(c1, c2);
+    cmat_destroy(c1);
+  }
+
+  cmat_destroy(c2);
+  cmat_destroy(a);
+  cmat_destroy(b);
+
+  return ret;
+}
+
+/*
+ * 一つのスケジューラを共有して演算を行うアプリケーションのスレッド
+ */
+typedef struct {
+  cmat_sched_t* sched;
+  int ok;
+} caller_t;
+
+static void*
+caller_thread(void* arg)
+{
+  caller_t* c;
+  cmat_ctx_t* ctx;
+  int i;
+
+  c = (caller_t*)arg;
+
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, c->sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  c->ok = !0;
+  for (i = 0; i < 8; i++) {
+    if (!check_product(ctx, 40 + i)) c->ok = 0;
+  }
+
+  cmat_ctx_destroy(ctx);
+
+  return NULL;
+}
+
+/*
+ * ホスト側のスレッドプールの代わり
+ *  投入されたジョブごとにスレッドを起動する(deferが!0の場合は溜めておき、
+ *  run_deferred()で呼び出し元のスレッドで実行する)。
+ */
+typedef struct {
+  void (*job)(void*);
+  void* arg;
+  int* live;
+} host_job_t;
+
+typedef struct {
+  int live;
+  int submitted;
+  int defer;
+
+  pthread_mutex_t lock;
+  host_job_t queue[64];
+  int n;
+} host_t;
+
+static void*
+host_thread(void* arg)
+{
+  host_job_t* hj;
+
+  hj = (host_job_t*)arg;
+  hj->job(hj->arg);
+  __atomic_sub_fetch(hj->live, 1, __ATOMIC_RELEASE);
+  free(hj);
+
+  return NULL;
+}
+
+static void
+host_submit(void (*job)(void*), void* arg, void* user)
+{
+  host_t* host;
+  host_job_t* hj;
+  pthread_t th;
+
+  host = (host_t*)user;
+  __atomic_add_fetch(&host->submitted, 1, __ATOMIC_RELAXED);
+
+  if (host->defer) {
+    pthread_mutex_lock(&host->lock);
+    host->queue[host->n].job = job;
+    host->queue[host->n].arg = arg;
+    host->n++;
+    pthread_mutex_unlock(&host->lock);
+
+  } else {
+    hj       = (host_job_t*)malloc(sizeof(host_job_t));
+    hj->job  = job;
+    hj->arg  = arg;
+    hj->live = &host->live;
+
+    __atomic_add_fetch(&host->live, 1, __ATOMIC_RELAXED);
+    pthread_create(&th, NULL, host_thread, hj);
+    pthread_detach(th);
+  }
+}
+
+static void
+run_deferred(host_t* host)
+{
+  int i;
+
+  for (i = 0; i < host->n; i++) {
+    host->queue[i].job(host->queue[i].arg);
+  }
+
+  host->n = 0;
+}
+
+static void
+test_normal_1(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  pthread_t th[4];
+  caller_t caller[4];
+  int i;
+
+  /*
+   * 内部ワーカ
+   */
+  CU_ASSERT(cmat_sched_new(3, &sched) == 0);
+  CU_ASSERT(cmat_ctx_new(&ctx) == 0);
+  CU_ASSERT(cmat_ctx_set_sched(ctx, sched) == 0);
+  CU_ASSERT(cmat_ctx_set_parallel_min(ctx, 0) == 0);
+
+  CU_ASSERT(check_product(ctx, 5));
+  CU_ASSERT(check_product(ctx, 70));
+
+  /*
+   * 複数のスレッドが同じスケジューラに同時に投入する
+   */
+  for (i = 0; i < 4; i++) {
+    caller[i].sched = sched;
+    caller[i].ok    = 0;
+    pthread_create(th + i, NULL, caller_thread, caller + i);
+  }
+
+  for (i = 0; i < 4; i++) {
+    pthread_join(th[i], NULL);
+    CU_ASSERT(caller[i].ok);
+  }
+
+  cmat_ctx_destroy(ctx);
+  CU_ASSERT(cmat_sched_destroy(sched) == 0);
+
+  /*
+   * 既定のワーカ数
+   */
+  CU_ASSERT(cmat_sched_new(0, &sched) == 0);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  CU_ASSERT(check_product(ctx, 40));
+
+  cmat_ctx_destroy(ctx);
+  CU_ASSERT(cmat_sched_destroy(sched) == 0);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_sched_t* sched;
+  cmat_ctx_t* ctx;
+  host_t host;
+
+  memset(&host, 0, sizeof(host));
+  pthread_mutex_init(&host.lock, NULL);
+
+  /*
+   * 外部ワーカ(ホストのスレッドで実行)
+   */
+  CU_ASSERT(cmat_sched_new_external(3, host_submit, &host, &sched) == 0);
+  cmat_ctx_new(&ctx);
+  cmat_ctx_set_sched(ctx, sched);
+  cmat_ctx_set_parallel_min(ctx, 0);
+
+  CU_ASSERT(check_product(ctx, 5));
+  CU_ASSERT(check_product(ctx, 70));
+  CU_ASSERT(host.submitted > 0);
+
+  /* 投入済みのジョブが戻るのを待ってから削除する */
+  CU_ASSERT(cmat_sched_destroy(sched) == 0);
+  while (__atomic_load_n(&host.live, __ATOMIC_ACQUIRE) > 0) sched_yield();
+
+  /*
+   * ホストがジョブをすぐに実行しない場合も演算は呼び出し元で完了する
+   *  (実行されていないジョブの枠には重ねて投入しない)
+   */
+  host.defer     = !0;
+  host.submitted = 0;
+
+  CU_ASSERT(cmat_sched_new_external(2, host_submit, &host, &sched) == 0);
+  cmat_ctx_set_sched(ctx, sched);
+
+  CU_ASSERT(check_product(ctx, 30));
+  CU_ASSERT(check_product(ctx, 30));
+  CU_ASSERT(host.submitted > 0);
+  CU_ASSERT(host.n <= 2);
+
+  run_deferred(&host);
+
+  /* スレッド数の指定は投入する外部ワーカの数を制限する */
+  host.submitted = 0;
+  cmat_ctx_set_threads(ctx, 2);
+
+  CU_ASSERT(check_product(ctx, 30));
+  CU_ASSERT(host.n <= 1);
+
+  run_deferred(&host);
+  CU_ASSERT(cmat_sched_destroy(sched) == 0);
+
+  cmat_ctx_destroy(ctx);
+  pthread_mutex_destroy(&host.lock);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_sched_t* sched;
+  host_t host;
+
+  CU_ASSERT(cmat_sched_new(1, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_sched_new(-1, &sched) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_sched_new_external(1, NULL, NULL, &sched) ==
+            CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_sched_new_external(1, host_submit, &host, NULL) ==
+            CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_sched_new_external(0, host_submit, &host, &sched) ==
+            CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_sched_destroy(NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_ctx_set_sched(NULL, NULL) == CMAT_ERR_BADDR);
+}
+
+void
+init_test_sched()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("scheduler", NULL, NULL);
+  CU_add_test(suite, "sched#1", test_normal_1);
+  CU_add_test(suite, "sched#2", test_normal_2);
+  CU_add_test(suite, "sched#E1", test_error_1);
+}
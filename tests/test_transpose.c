@@ -1,6 +1,8 @@
 ﻿#include <CUnit/CUnit.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "cmat.h"
 #include "test_transpose.h"
 
@@ -79,6 +81,126 @@ test_normal_2(void)
   }
 }
 
+static float*
+create_values(int n)
+{
+  float* ret;
+  int i;
+
+  ret = (float*)malloc(sizeof(float) * n);
+
+  for (i = 0; i < n; i++) {
+    ret[i] = (float)i;
+  }
+
+  return ret;
+}
+
+static int
+is_transposed(cmat_t* ptr, float* val, int rows, int cols)
+{
+  int r;
+  int c;
+
+  if (ptr->rows != cols || ptr->cols != rows) return 0;
+
+  for (r = 0; r < rows; r++) {
+    for (c = 0; c < cols; c++) {
+      if (CMAT_ROW(ptr, c)[r] != val[(r * cols) + c]) return 0;
+    }
+  }
+
+  return !0;
+}
+
+static void
+test_normal_3(void)
+{
+  static const int shape[][2] = {
+    {130, 130}, {200, 131}, {300, 7}, {7, 300}, {65, 1}, {1, 65},
+  };
+
+  cmat_t* m1;
+  cmat_t* m2;
+  float* val;
+  int res;
+  int i;
+
+  /*
+   * タイルの端数を含む大きさ(転置先の確保とその場での転置)
+   */
+  for (i = 0; i < N(shape); i++) {
+    val = create_values(shape[i][0] * shape[i][1]);
+    cmat_new(val, shape[i][0], shape[i][1], &m1);
+
+    CU_ASSERT(cmat_transpose(m1, &m2) == 0);
+    CU_ASSERT(is_transposed(m2, val, shape[i][0], shape[i][1]));
+
+    CU_ASSERT(cmat_transpose(m1, NULL) == 0);
+    CU_ASSERT(is_transposed(m1, val, shape[i][0], shape[i][1]));
+
+    /* 元に戻す */
+    CU_ASSERT(cmat_transpose(m1, NULL) == 0);
+    CU_ASSERT(m1->rows == shape[i][0] && m1->cols == shape[i][1]);
+    CU_ASSERT(cmat_check(m1, val, &res) == 0);
+    CU_ASSERT(res == 0);
+
+    cmat_destroy(m1);
+    cmat_destroy(m2);
+    free(val);
+  }
+}
+
+static void
+test_normal_4(void)
+{
+  cmat_t* m;
+  cmat_t* v;
+  float* val;
+  int piv[] = {2, 0, 1};
+  int res;
+
+  float ans1[] = {
+     0,  1,  2,  3,  4,
+     5,  6, 11, 16,  9,
+    10,  7, 12, 17, 14,
+    15,  8, 13, 18, 19,
+    20, 21, 22, 23, 24,
+  };
+
+  float tmp[6];
+
+  /*
+   * ビュー(正方)のその場での転置
+   */
+  val = create_values(25);
+  cmat_new(val, 5, 5, &m);
+  cmat_view(m, 1, 1, 3, 3, &v);
+
+  CU_ASSERT(cmat_transpose(v, NULL) == 0);
+  CU_ASSERT(cmat_check(m, ans1, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  cmat_destroy(v);
+  cmat_destroy(m);
+
+  /*
+   * 行を入れ替えた矩形行列(その場での転置は行わない)
+   */
+  cmat_new(val, 3, 2, &m);
+  cmat_permute_row(m, piv);
+
+  memcpy(tmp + 0, CMAT_ROW(m, 0), sizeof(float) * 2);
+  memcpy(tmp + 2, CMAT_ROW(m, 1), sizeof(float) * 2);
+  memcpy(tmp + 4, CMAT_ROW(m, 2), sizeof(float) * 2);
+
+  CU_ASSERT(cmat_transpose(m, NULL) == 0);
+  CU_ASSERT(is_transposed(m, tmp, 3, 2));
+
+  cmat_destroy(m);
+  free(val);
+}
+
 static void
 test_error_1(void)
 {
@@ -115,6 +237,8 @@ init_test_transpose()
   suite = CU_add_suite("transpose", NULL, NULL);
   CU_add_test(suite, "transpose#1", test_normal_1);
   CU_add_test(suite, "transpose#2", test_normal_2);
+  CU_add_test(suite, "transpose#3", test_normal_3);
+  CU_add_test(suite, "transpose#4", test_normal_4);
   CU_add_test(suite, "transpose#E1", test_error_1);
   CU_add_test(suite, "transpose#E2", test_error_2);
 }
@@ -0,0 +1,282 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmat.h"
+#include "helper.h"
+
+static void
+test_normal_1(void)
+{
+  cmat_t* m;
+  cmat_t* t;
+  cmat_t* p;
+  float val[] = {
+    1, 2, 3,
+    4, 5, 6,
+  };
+
+  float ans1[] = {
+    1, 4,
+    2, 5,
+    3, 6,
+  };
+
+  float ans2[] = {
+    17, 22, 27,
+    22, 29, 36,
+    27, 36, 45,
+  };
+
+  float ans3[] = {
+    14, 32,
+    32, 77,
+  };
+
+  int res;
+
+  /*
+   * 転置ビューの形状と値
+   */
+  cmat_new(val, 2, 3, &m);
+
+  CU_ASSERT(cmat_transpose_view(m, &t) == 0);
+  CU_ASSERT(t->rows == 3 && t->cols == 2);
+  CU_ASSERT(t->flags & CMAT_FLAG_VIEW);
+  CU_ASSERT(t->flags & CMAT_FLAG_TRANS);
+  CU_ASSERT(CMAT_ROW(t, 1) == CMAT_ROW(m, 1));
+
+  CU_ASSERT(cmat_check(t, ans1, &res) == 0);
+  CU_ASSERT(res == 0);
+
+  /*
+   * A^T * A, A * A^T
+   */
+  CU_ASSERT(cmat_product(t, m, &p) == 0);
+  CU_ASSERT(p->rows == 3 && p->cols == 3);
+  CU_ASSERT(cmat_check(p, ans2, &res) == 0);
+  CU_ASSERT(res == 0);
+  cmat_destroy(p);
+
+  CU_ASSERT(cmat_product(m, t, &p) == 0);
+  CU_ASSERT(p->rows == 2 && p->cols == 2);
+  CU_ASSERT(cmat_check(p, ans3, &res) == 0);
+  CU_ASSERT(res == 0);
+  cmat_destroy(p);
+
+  cmat_destroy(t);
+  cmat_destroy(m);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* at;
+  cmat_t* bt;
+  cmat_t* ta;
+  cmat_t* tb;
+  cmat_t* tt;
+  cmat_t* p1;
+  cmat_t* p2;
+
+  /*
+   * GEMMエンジンを通る大きさでの転置済み行列との比較
+   */
+  a = random_matrix(70, 45);
+  b = random_matrix(70, 30);
+
+  cmat_transpose(a, &at);
+  cmat_transpose(b, &bt);
+  cmat_transpose_view(a, &ta);
+  cmat_transpose_view(b, &tb);
+
+  /* A^T * B */
+  CU_ASSERT(cmat_product(ta, b, &p1) == 0);
+  cmat_product(at, b, &p2);
+  CU_ASSERT(is_equal(p1, p2));
+  cmat_destroy(p1);
+  cmat_destroy(p2);
+
+  /* B^T * A */
+  CU_ASSERT(cmat_product(tb, a, &p1) == 0);
+  cmat_product(bt, a, &p2);
+  CU_ASSERT(is_equal(p1, p2));
+  cmat_destroy(p2);
+
+  /* 転置ビューへの出力 (B^T * A = (A^T * B)^T) */
+  cmat_new(NULL, 45, 30, &p2);
+  cmat_transpose_view(p2, &tt);
+  CU_ASSERT(cmat_product_into(tb, a, tt) == 0);
+  CU_ASSERT(is_equal(p1, tt));
+
+  cmat_destroy(tt);
+  cmat_destroy(p1);
+  cmat_destroy(p2);
+  cmat_destroy(at);
+  cmat_destroy(bt);
+  cmat_destroy(ta);
+  cmat_destroy(tb);
+  cmat_destroy(a);
+  cmat_destroy(b);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_t* a;
+  cmat_t* at;
+  cmat_t* ta;
+  cmat_t* s1;
+  cmat_t* s2;
+  float d1;
+  float d2;
+
+  a = random_matrix(40, 37);
+  cmat_transpose(a, &at);
+  cmat_transpose_view(a, &ta);
+
+  /*
+   * 和・差・スカラー積(転置の有無の混在を含む)
+   */
+  CU_ASSERT(cmat_add(ta, at, &s1) == 0);
+  cmat_mul(at, 2.0f, &s2);
+  CU_ASSERT(is_equal(s1, s2));
+  cmat_destroy(s1);
+
+  CU_ASSERT(cmat_mul(ta, 2.0f, &s1) == 0);
+  CU_ASSERT(is_equal(s1, s2));
+  cmat_destroy(s1);
+
+  CU_ASSERT(cmat_sub(s2, ta, &s1) == 0);
+  CU_ASSERT(is_equal(s1, at));
+  cmat_destroy(s1);
+  cmat_destroy(s2);
+
+  /*
+   * ドット積
+   */
+  cmat_dot(a, a, &d1);
+
+  CU_ASSERT(cmat_dot(ta, ta, &d2) == 0);
+  CU_ASSERT(d1 == d2);
+
+  CU_ASSERT(cmat_dot(ta, at, &d2) == 0);
+  CU_ASSERT(d1 == d2);
+
+  /*
+   * 複製と転置
+   */
+  CU_ASSERT(cmat_clone(ta, &s1) == 0);
+  CU_ASSERT(!(s1->flags & CMAT_FLAG_TRANS));
+  CU_ASSERT(is_equal(s1, at));
+  cmat_destroy(s1);
+
+  CU_ASSERT(cmat_transpose(ta, &s1) == 0);
+  CU_ASSERT(is_equal(s1, a));
+  cmat_destroy(s1);
+
+  /*
+   * 転置ビューへの書き込みは元の行列に反映される
+   */
+  CU_ASSERT(cmat_add(ta, at, NULL) == 0);
+  cmat_mul(at, 2.0f, &s2);
+  cmat_transpose(s2, &s1);
+  CU_ASSERT(is_equal(a, s1));
+  cmat_destroy(s1);
+  cmat_destroy(s2);
+
+  cmat_destroy(ta);
+  cmat_destroy(at);
+  cmat_destroy(a);
+}
+
+static void
+test_normal_4(void)
+{
+  cmat_t* a;
+  cmat_t* b;
+  cmat_t* c;
+  cmat_t* tc;
+  cmat_t* ta;
+  cmat_t* p;
+  cmat_t* pt;
+
+  /*
+   * cmat_gemm()の転置指定との組み合わせ
+   */
+  a = random_matrix(33, 21);
+  b = random_matrix(33, 18);
+
+  cmat_transpose_view(a, &ta);
+  cmat_product(ta, b, &p);
+  cmat_transpose(p, &pt);
+
+  /* CMAT_TRANSと転置ビューの組み合わせは元の行列そのものになる */
+  cmat_new(NULL, 21, 18, &c);
+  CU_ASSERT(cmat_gemm(CMAT_TRANS, CMAT_NOTRANS, 1.0f, ta, b, 0.0f, c) ==
+            CMAT_ERR_SHAPE);
+  CU_ASSERT(cmat_gemm(CMAT_NOTRANS, CMAT_NOTRANS, 1.0f, ta, b, 0.0f, c) == 0);
+  CU_ASSERT(is_equal(c, p));
+  cmat_destroy(c);
+
+  /* 転置ビューへの出力 */
+  cmat_new(NULL, 18, 21, &c);
+  cmat_transpose_view(c, &tc);
+  CU_ASSERT(cmat_gemm(CMAT_TRANS, CMAT_NOTRANS, 1.0f, a, b, 0.0f, tc) == 0);
+  CU_ASSERT(is_equal(c, pt));
+
+  cmat_destroy(tc);
+  cmat_destroy(c);
+  cmat_destroy(p);
+  cmat_destroy(pt);
+  cmat_destroy(ta);
+  cmat_destroy(a);
+  cmat_destroy(b);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_t* m;
+  cmat_t* t;
+  cmat_t* v;
+  float val[] = {1, 2, 3, 4};
+  int piv[] = {1, 0};
+
+  cmat_new(val, 2, 2, &m);
+
+  CU_ASSERT(cmat_transpose_view(NULL, &t) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_transpose_view(m, NULL) == CMAT_ERR_BADDR);
+
+  /*
+   * 転置ビューでは使用できない操作
+   */
+  cmat_transpose_view(m, &t);
+
+  CU_ASSERT(cmat_append(t, val) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_view(t, 0, 0, 1, 1, &v) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_inverse(t, &v) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_inverse_into(m, t) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_lu_decomp(t, &v, piv) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_permute_row(t, piv) == CMAT_ERR_INVAL);
+  CU_ASSERT(cmat_permute_column(t, piv) == CMAT_ERR_INVAL);
+
+  cmat_destroy(t);
+  cmat_destroy(m);
+}
+
+void
+init_test_transview()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("transpose_view", NULL, NULL);
+  CU_add_test(suite, "transpose_view#1", test_normal_1);
+  CU_add_test(suite, "transpose_view#2", test_normal_2);
+  CU_add_test(suite, "transpose_view#3", test_normal_3);
+  CU_add_test(suite, "transpose_view#4", test_normal_4);
+  CU_add_test(suite, "transpose_view#E1", test_error_1);
+}
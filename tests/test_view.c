@@ -0,0 +1,172 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmat.h"
+
+static float v[] = {
+   1,  2,  3,  4,  5,
+   6,  7,  8,  9, 10,
+  11, 12, 13, 14, 15,
+  16, 17, 18, 19, 20,
+};
+
+static void
+test_normal_1(void)
+{
+  cmat_t* m;
+  cmat_t* w;
+  cmat_t* c;
+  int i;
+
+  /*
+   * ビューの生成と参照
+   */
+  cmat_new(v, 4, 5, &m);
+
+  CU_ASSERT(cmat_view(m, 1, 2, 2, 3, &w) == 0);
+  CU_ASSERT(w->rows == 2 && w->cols == 3);
+  CU_ASSERT(w->flags & CMAT_FLAG_VIEW);
+
+  CU_ASSERT(memcmp(CMAT_ROW(w, 0), v + 7, sizeof(float) * 3) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(w, 1), v + 12, sizeof(float) * 3) == 0);
+
+  /* 値はコピーされない */
+  CU_ASSERT(CMAT_ROW(w, 0) == CMAT_ROW(m, 1) + 2);
+
+  /* ビューの複製は独立した行列になる */
+  CU_ASSERT(cmat_clone(w, &c) == 0);
+  CU_ASSERT(!(c->flags & CMAT_FLAG_VIEW));
+
+  for (i = 0; i < 2; i++) {
+    CU_ASSERT(memcmp(CMAT_ROW(c, i), CMAT_ROW(w, i), sizeof(float) * 3) == 0);
+  }
+
+  /* ビューを削除しても元の行列は残る */
+  CU_ASSERT(cmat_destroy(w) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(m, 3), v + 15, sizeof(float) * 5) == 0);
+
+  cmat_destroy(c);
+  cmat_destroy(m);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_t* m;
+  cmat_t* w1;
+  cmat_t* w2;
+  cmat_t* p;
+  float ans1[] = {14, 16, 18};
+  float ans2[] = {
+    1, 2, 3, 4, 5,
+    6, 14, 16, 18, 10,
+    11, 24, 26, 28, 15,
+    16, 17, 18, 19, 20,
+  };
+  float ans3[] = {
+    3, 4,
+    16, 18,
+  };
+  int i;
+
+  /*
+   * ビューへの書き込みは元の行列に反映される
+   */
+  cmat_new(v, 4, 5, &m);
+
+  cmat_view(m, 1, 1, 2, 3, &w1);
+  cmat_view(m, 0, 0, 2, 3, &w2);
+
+  /* 出力先としての使用 */
+  CU_ASSERT(cmat_mul(w1, 2.0f, NULL) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(w1, 0), ans1, sizeof(ans1)) == 0);
+
+  for (i = 0; i < 4; i++) {
+    CU_ASSERT(memcmp(CMAT_ROW(m, i), ans2 + (i * 5), sizeof(float) * 5) == 0);
+  }
+
+  /* 入力としての使用 */
+  cmat_destroy(w1);
+  cmat_view(m, 0, 2, 2, 2, &w1);
+
+  CU_ASSERT(cmat_product(w2, m, &p) != 0);
+  CU_ASSERT(cmat_clone(w1, &p) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(p, 0), ans3, sizeof(float) * 2) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(p, 1), ans3 + 2, sizeof(float) * 2) == 0);
+  cmat_destroy(p);
+
+  /* 形状が同じ場合はdst==NULLの演算結果も元の行列に反映される */
+  CU_ASSERT(cmat_transpose(w1, NULL) == 0);
+  CU_ASSERT(w1->flags & CMAT_FLAG_VIEW);
+  CU_ASSERT(CMAT_ROW(m, 0)[3] == 16.0f && CMAT_ROW(m, 1)[2] == 4.0f);
+
+  cmat_destroy(w1);
+  cmat_destroy(w2);
+  cmat_destroy(m);
+}
+
+static void
+test_normal_3(void)
+{
+  cmat_t* m;
+  cmat_t* w;
+  float r[] = {100, 200};
+  float ans[] = {
+    12, 13,
+    17, 18,
+    100, 200,
+  };
+  int i;
+
+  /*
+   * 行を追加したビューは元の行列から切り離される
+   */
+  cmat_new(v, 4, 5, &m);
+  cmat_view(m, 2, 1, 2, 2, &w);
+
+  CU_ASSERT(cmat_append(w, r) == 0);
+  CU_ASSERT(w->rows == 3);
+  CU_ASSERT(!(w->flags & CMAT_FLAG_VIEW));
+
+  for (i = 0; i < 3; i++) {
+    CU_ASSERT(memcmp(CMAT_ROW(w, i), ans + (i * 2), sizeof(float) * 2) == 0);
+  }
+
+  CMAT_ROW(w, 0)[0] = 0.0f;
+  CU_ASSERT(CMAT_ROW(m, 2)[1] == 12.0f);
+
+  cmat_destroy(w);
+  cmat_destroy(m);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_t* m;
+  cmat_t* w;
+
+  cmat_new(v, 4, 5, &m);
+
+  CU_ASSERT(cmat_view(NULL, 0, 0, 1, 1, &w) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_view(m, 0, 0, 1, 1, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_view(m, 0, 0, 0, 1, &w) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_view(m, -1, 0, 1, 1, &w) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_view(m, 3, 0, 2, 1, &w) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_view(m, 0, 3, 1, 3, &w) == CMAT_ERR_BSIZE);
+
+  cmat_destroy(m);
+}
+
+void
+init_test_view()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("view", NULL, NULL);
+  CU_add_test(suite, "view#1", test_normal_1);
+  CU_add_test(suite, "view#2", test_normal_2);
+  CU_add_test(suite, "view#3", test_normal_3);
+  CU_add_test(suite, "view#E1", test_error_1);
+}
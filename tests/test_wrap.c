@@ -0,0 +1,101 @@
+#include <CUnit/CUnit.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmat.h"
+
+static void
+test_normal_1(void)
+{
+  cmat_t* m;
+  cmat_t* t;
+  float buf[] = {
+    1, 2, 3, -1,
+    4, 5, 6, -1,
+  };
+
+  float ans[] = {
+    2, 4, 6, -1,
+    8, 10, 12, -1,
+  };
+
+  /*
+   * 外部バッファの参照と書き込み
+   */
+  CU_ASSERT(cmat_wrap(buf, 2, 3, 4, &m) == 0);
+  CU_ASSERT(m->rows == 2 && m->cols == 3);
+  CU_ASSERT(m->flags & CMAT_FLAG_VIEW);
+  CU_ASSERT(CMAT_ROW(m, 1) == buf + 4);
+
+  CU_ASSERT(cmat_transpose(m, &t) == 0);
+  CU_ASSERT(CMAT_ROW(t, 2)[1] == 6.0f);
+
+  /* パディング部分には書き込まない */
+  CU_ASSERT(cmat_add(m, m, NULL) == 0);
+  CU_ASSERT(memcmp(buf, ans, sizeof(ans)) == 0);
+
+  /* 削除してもバッファは解放されない */
+  CU_ASSERT(cmat_destroy(m) == 0);
+  CU_ASSERT(buf[4] == 8.0f);
+
+  cmat_destroy(t);
+}
+
+static void
+test_normal_2(void)
+{
+  cmat_t* m;
+  cmat_t* p;
+  float buf[] = {
+    1, 2,
+    3, 4,
+    5, 6,
+  };
+
+  float ans[] = {
+    7, 10,
+    15, 22,
+  };
+
+  /*
+   * 詰めて格納されたバッファ(stride == cols)
+   */
+  cmat_wrap(buf, 2, 2, 2, &m);
+
+  CU_ASSERT(cmat_product(m, m, &p) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(p, 0), ans, sizeof(float) * 2) == 0);
+  CU_ASSERT(memcmp(CMAT_ROW(p, 1), ans + 2, sizeof(float) * 2) == 0);
+
+  /* 形状が同じ結果はバッファに書き戻される */
+  CU_ASSERT(cmat_product(m, m, NULL) == 0);
+  CU_ASSERT(memcmp(buf, ans, sizeof(ans)) == 0);
+  CU_ASSERT(buf[4] == 5.0f && buf[5] == 6.0f);
+
+  cmat_destroy(m);
+  cmat_destroy(p);
+}
+
+static void
+test_error_1(void)
+{
+  cmat_t* m;
+  float buf[4];
+
+  CU_ASSERT(cmat_wrap(NULL, 2, 2, 2, &m) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_wrap(buf, 2, 2, 2, NULL) == CMAT_ERR_BADDR);
+  CU_ASSERT(cmat_wrap(buf, 0, 2, 2, &m) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_wrap(buf, 2, 0, 2, &m) == CMAT_ERR_BSIZE);
+  CU_ASSERT(cmat_wrap(buf, 2, 2, 1, &m) == CMAT_ERR_BSIZE);
+}
+
+void
+init_test_wrap()
+{
+  CU_pSuite suite;
+
+  suite = CU_add_suite("wrap", NULL, NULL);
+  CU_add_test(suite, "wrap#1", test_normal_1);
+  CU_add_test(suite, "wrap#2", test_normal_2);
+  CU_add_test(suite, "wrap#E1", test_error_1);
+}